@@ -1,4 +1,6 @@
 #include <ac/ac.h>
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
 #include "compiled/main.h"
 
 #define RIF(x)                                                                 \
@@ -21,7 +23,9 @@ private:
   };
 
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -100,6 +104,8 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -198,15 +204,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_result res;
@@ -217,7 +225,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -225,10 +233,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -240,10 +250,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -258,9 +270,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -292,8 +309,8 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
   swapchain_info.bits = ac_swapchain_wants_hdr_bit;
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
@@ -2,6 +2,9 @@
 #include <ac/ac.h>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include "upload_ring.hpp"
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
 #include "compiled/main.h"
 
 // clang-format off
@@ -95,10 +98,13 @@ static const float g_uv_buffer_data[] = {
 
 // clang-format on
 
-struct ShaderData {
+struct FrameData {
   glm::mat4 mvp;
-  float     position[12 * 3][4];
-  float     attr[12 * 3][4];
+};
+
+struct CubeData {
+  float position[12 * 3][4];
+  float attr[12 * 3][4];
 };
 
 #define RIF(x)                                                                 \
@@ -120,8 +126,12 @@ private:
     ColorImage = 0,
   };
 
+  static constexpr uint64_t UPLOAD_RING_SIZE = 64 * 1024;
+
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -140,7 +150,11 @@ private:
   ac_shader            m_vertex_shader = {};
   ac_shader            m_fragment_shader = {};
 
-  ac_buffer m_cbv_buffer[AC_MAX_FRAME_IN_FLIGHT] = {};
+  // the cube is written once into its own buffer, only the matrix goes
+  // through transient memory every frame
+  ac_buffer        m_cube_buffer = {};
+  UploadRing       m_upload;
+  UploadAllocation m_constants = {};
 
   struct {
     glm::mat4 projection;
@@ -210,6 +224,8 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -265,21 +281,29 @@ App::App()
     ac_descriptor_buffer_info info = {};
     info.dsl = m_dsl;
     info.max_sets[0] = AC_MAX_FRAME_IN_FLIGHT;
+    info.max_sets[1] = 1;
     info.name = AC_DEBUG_NAME(App::APP_NAME);
     RIF(ac_create_descriptor_buffer(m_device, &info, &m_db));
   }
 
-  for (uint32_t f = 0; f < AC_MAX_FRAME_IN_FLIGHT; ++f)
+  RIF(m_upload.init(
+    m_device,
+    UPLOAD_RING_SIZE,
+    ac_buffer_usage_cbv_bit,
+    AC_DEBUG_NAME("upload ring")));
+
   {
-    ac_buffer_info buffer_info = {};
-    buffer_info.memory_usage = ac_memory_usage_cpu_to_gpu;
-    buffer_info.usage = ac_buffer_usage_cbv_bit;
-    buffer_info.size = sizeof(ShaderData);
-    RIF(ac_create_buffer(m_device, &buffer_info, &m_cbv_buffer[f]));
+    ac_buffer_info info = {};
+    info.size = sizeof(CubeData);
+    info.usage = ac_buffer_usage_cbv_bit;
+    info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    info.name = AC_DEBUG_NAME("cube");
 
-    RIF(ac_buffer_map_memory(m_cbv_buffer[f]));
+    RIF(ac_create_buffer(m_device, &info, &m_cube_buffer));
+    RIF(ac_buffer_map_memory(m_cube_buffer));
 
-    ShaderData* mem = (ShaderData*)ac_buffer_get_mapped_memory(m_cbv_buffer[f]);
+    CubeData* mem =
+      static_cast<CubeData*>(ac_buffer_get_mapped_memory(m_cube_buffer));
 
     for (uint32_t i = 0; i < 12 * 3; i++)
     {
@@ -293,13 +317,16 @@ App::App()
       mem->attr[i][3] = 0;
     }
 
+    ac_buffer_unmap_memory(m_cube_buffer);
+
     ac_descriptor descriptor = {};
-    descriptor.buffer = m_cbv_buffer[f];
+    descriptor.buffer = m_cube_buffer;
+
     ac_descriptor_write write = {};
     write.count = 1;
     write.type = ac_descriptor_type_cbv_buffer;
     write.descriptors = &descriptor;
-    ac_update_set(m_db, ac_space0, f, 1, &write);
+    ac_update_set(m_db, ac_space1, 0, 1, &write);
   }
 
   glm::vec3 eye = {0.0, 3.0f, 5.0f};
@@ -329,9 +356,11 @@ App::~App()
     RIF(ac_queue_wait_idle(
       ac_device_get_queue(m_device, ac_queue_type_graphics)));
 
+    m_upload.shutdown();
+    ac_destroy_buffer(m_cube_buffer);
+
     for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
     {
-      ac_destroy_buffer(m_cbv_buffer[i]);
       ac_destroy_fence(m_render_finished_fences[i]);
       ac_destroy_fence(m_acquire_finished_fences[i]);
     }
@@ -366,15 +395,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_result res;
@@ -385,7 +416,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -393,10 +424,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -408,10 +441,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -426,9 +461,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -460,8 +500,8 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
@@ -502,10 +542,30 @@ App::stage_prepare(ac_rg_stage* stage, void* ud)
   p->m_matrices.model = glm::rotate(model, 0.01f, glm::vec3(0.0, 1.0, 0.0));
   mvp = vp * p->m_matrices.model;
 
-  memcpy(
-    ac_buffer_get_mapped_memory(p->m_cbv_buffer[stage->frame]),
-    &mvp,
-    sizeof(mvp));
+  p->m_upload.begin_frame(stage->frame);
+  p->m_constants = p->m_upload.allocate(sizeof(FrameData));
+
+  // out of transient memory, the cube is skipped this frame
+  if (!p->m_constants.data)
+  {
+    return ac_result_success;
+  }
+
+  FrameData* frame_data = static_cast<FrameData*>(p->m_constants.data);
+  frame_data->mvp = mvp;
+
+  // the set of this frame in flight is not in use anymore, so it can point
+  // at the new allocation
+  ac_descriptor descriptor = {};
+  descriptor.buffer = p->m_constants.buffer;
+  descriptor.offset = p->m_constants.offset;
+  descriptor.range = sizeof(FrameData);
+
+  ac_descriptor_write write = {};
+  write.count = 1;
+  write.type = ac_descriptor_type_cbv_buffer;
+  write.descriptors = &descriptor;
+  ac_update_set(p->m_db, ac_space0, stage->frame, 1, &write);
 
   return ac_result_success;
 }
@@ -524,8 +584,14 @@ App::stage_cmd(ac_rg_stage* stage, void* ud)
   ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
   ac_cmd_set_scissor(cmd, 0, 0, width, height);
 
+  if (!p->m_constants.data)
+  {
+    return ac_result_success;
+  }
+
   ac_cmd_bind_pipeline(cmd, p->m_pipeline);
   ac_cmd_bind_set(cmd, p->m_db, ac_space0, stage->frame);
+  ac_cmd_bind_set(cmd, p->m_db, ac_space1, 0);
   ac_cmd_draw(cmd, 36, 1, 0, 0);
 
   return ac_result_success;
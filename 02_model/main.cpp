@@ -6,6 +6,10 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include <ac/ac.h>
+#include "upload_ring.hpp"
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
+#include "pipeline_cache.hpp"
 #include "compiled/main.h"
 
 struct ShaderData {
@@ -96,8 +100,12 @@ private:
     DepthImage = 1,
   };
 
+  static constexpr uint64_t UPLOAD_RING_SIZE = 64 * 1024;
+
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -110,13 +118,19 @@ private:
   ac_rg       m_rg = {};
   ac_rg_graph m_graph = {};
 
+  // pipelines survive resizes, only a new color format compiles again
+  PipelineCache m_pipeline_cache;
+
   ac_dsl               m_dsl = {};
   ac_descriptor_buffer m_db = {};
   ac_pipeline          m_pipeline = {};
   ac_shader            m_vertex_shader = {};
   ac_shader            m_fragment_shader = {};
 
-  ac_buffer  m_cbv_buffer[AC_MAX_FRAME_IN_FLIGHT] = {};
+  // per frame constants are carved out of one transient ring
+  UploadRing       m_upload;
+  UploadAllocation m_constants = {};
+
   ac_buffer  m_vertex_buffer = {};
   ac_buffer  m_index_buffer = {};
   ac_sampler m_sampler = {};
@@ -199,6 +213,10 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
+  m_pipeline_cache.init(m_device);
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -259,24 +277,11 @@ App::App()
     RIF(ac_create_descriptor_buffer(m_device, &info, &m_db));
   }
 
-  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
-  {
-    ac_buffer_info info = {};
-    info.memory_usage = ac_memory_usage_cpu_to_gpu;
-    info.usage = ac_buffer_usage_cbv_bit;
-    info.size = sizeof(ShaderData);
-    RIF(ac_create_buffer(m_device, &info, &m_cbv_buffer[i]));
-
-    RIF(ac_buffer_map_memory(m_cbv_buffer[i]));
-
-    ac_descriptor descriptor = {};
-    descriptor.buffer = m_cbv_buffer[i];
-    ac_descriptor_write write = {};
-    write.count = 1;
-    write.type = ac_descriptor_type_cbv_buffer;
-    write.descriptors = &descriptor;
-    ac_update_set(m_db, ac_space0, i, 1, &write);
-  }
+  RIF(m_upload.init(
+    m_device,
+    UPLOAD_RING_SIZE,
+    ac_buffer_usage_cbv_bit,
+    AC_DEBUG_NAME("upload ring")));
 
   std::vector<Vertex>   vertices;
   std::vector<uint32_t> indices;
@@ -378,14 +383,15 @@ App::~App()
     ac_destroy_buffer(m_vertex_buffer);
     ac_destroy_buffer(m_index_buffer);
 
+    m_upload.shutdown();
+
     for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
     {
-      ac_destroy_buffer(m_cbv_buffer[i]);
       ac_destroy_fence(m_render_finished_fences[i]);
       ac_destroy_fence(m_acquire_finished_fences[i]);
     }
 
-    ac_destroy_pipeline(m_pipeline);
+    m_pipeline_cache.shutdown();
     ac_destroy_descriptor_buffer(m_db);
     ac_destroy_dsl(m_dsl);
     ac_destroy_shader(m_vertex_shader);
@@ -415,15 +421,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_result res;
@@ -434,7 +442,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -442,10 +450,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -457,10 +467,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -475,9 +487,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -509,55 +526,60 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
   AC_RIF(ac_create_swapchain(m_device, &swapchain_info, &m_swapchain));
 
   {
-    ac_destroy_pipeline(m_pipeline);
-
-    ac_vertex_layout vl = {};
-    vl.binding_count = 1;
-    vl.bindings[0].stride = sizeof(Vertex);
-    vl.attribute_count = 2;
-    vl.attributes[0].format = ac_format_r32g32b32_sfloat;
-    vl.attributes[0].semantic = ac_attribute_semantic_position;
-    vl.attributes[0].offset = AC_OFFSETOF(Vertex, pos);
-    vl.attributes[1].format = ac_format_r32g32_sfloat;
-    vl.attributes[1].semantic = ac_attribute_semantic_texcoord0;
-    vl.attributes[1].offset = AC_OFFSETOF(Vertex, uv);
-
-    ac_depth_state_info depth_state = {};
-    depth_state.depth_test = true;
-    depth_state.depth_write = true;
-    depth_state.compare_op = ac_compare_op_less;
-
-    ac_rasterizer_state_info rasterizer_state = {};
-    rasterizer_state.cull_mode = ac_cull_mode_back;
-    rasterizer_state.front_face = ac_front_face_counter_clockwise;
-    rasterizer_state.polygon_mode = ac_polygon_mode_fill;
-
     ac_image image = ac_swapchain_get_image(m_swapchain);
 
-    ac_pipeline_info info = {};
+    // zeroed as a whole and written in place, the cache hashes the padding
+    ac_pipeline_info info;
+    memset(&info, 0, sizeof(info));
     info.name = AC_DEBUG_NAME(App::APP_NAME);
     info.type = ac_pipeline_type_graphics;
     info.graphics.vertex_shader = m_vertex_shader;
     info.graphics.pixel_shader = m_fragment_shader;
     info.graphics.dsl = m_dsl;
-    info.graphics.vertex_layout = vl;
     info.graphics.topology = ac_primitive_topology_triangle_list;
     info.graphics.samples = 1;
     info.graphics.color_attachment_count = 1;
     info.graphics.color_attachment_formats[0] = ac_image_get_format(image);
     info.graphics.depth_stencil_format = ac_format_d32_sfloat;
-    info.graphics.depth_state_info = depth_state;
-    info.graphics.rasterizer_info = rasterizer_state;
 
-    AC_RIF(ac_create_pipeline(m_device, &info, &m_pipeline));
+    ac_vertex_layout* vl = &info.graphics.vertex_layout;
+    vl->binding_count = 1;
+    vl->bindings[0].stride = sizeof(Vertex);
+    vl->attribute_count = 2;
+    vl->attributes[0].format = ac_format_r32g32b32_sfloat;
+    vl->attributes[0].semantic = ac_attribute_semantic_position;
+    vl->attributes[0].offset = AC_OFFSETOF(Vertex, pos);
+    vl->attributes[1].format = ac_format_r32g32_sfloat;
+    vl->attributes[1].semantic = ac_attribute_semantic_texcoord0;
+    vl->attributes[1].offset = AC_OFFSETOF(Vertex, uv);
+
+    ac_depth_state_info* depth_state = &info.graphics.depth_state_info;
+    depth_state->depth_test = true;
+    depth_state->depth_write = true;
+    depth_state->compare_op = ac_compare_op_less;
+
+    ac_rasterizer_state_info* rasterizer_state =
+      &info.graphics.rasterizer_info;
+    rasterizer_state->cull_mode = ac_cull_mode_back;
+    rasterizer_state->front_face = ac_front_face_counter_clockwise;
+    rasterizer_state->polygon_mode = ac_polygon_mode_fill;
+
+    AC_RIF(m_pipeline_cache.get(info, &m_pipeline));
+
+    const PipelineCacheStats& stats = m_pipeline_cache.get_stats();
+    AC_INFO(
+      "pipelines created: %u reused: %u compile time: %.3f ms",
+      stats.misses,
+      stats.hits,
+      stats.create_ms);
   }
 
   return ac_result_success;
@@ -575,10 +597,29 @@ App::stage_prepare(ac_rg_stage* stage, void* ud)
   p->m_matrices.model = glm::rotate(model, 0.01f, glm::vec3(0.0, 0.0, 1.0));
   mvp = vp * p->m_matrices.model;
 
-  memcpy(
-    ac_buffer_get_mapped_memory(p->m_cbv_buffer[stage->frame]),
-    &mvp,
-    sizeof(mvp));
+  p->m_upload.begin_frame(stage->frame);
+  p->m_constants = p->m_upload.allocate(sizeof(ShaderData));
+
+  // out of transient memory, the model is skipped this frame
+  if (!p->m_constants.data)
+  {
+    return ac_result_success;
+  }
+
+  memcpy(p->m_constants.data, &mvp, sizeof(mvp));
+
+  // the set of this frame in flight is not in use anymore, so it can point
+  // at the new allocation
+  ac_descriptor descriptor = {};
+  descriptor.buffer = p->m_constants.buffer;
+  descriptor.offset = p->m_constants.offset;
+  descriptor.range = sizeof(ShaderData);
+
+  ac_descriptor_write write = {};
+  write.count = 1;
+  write.type = ac_descriptor_type_cbv_buffer;
+  write.descriptors = &descriptor;
+  ac_update_set(p->m_db, ac_space0, stage->frame, 1, &write);
 
   return ac_result_success;
 }
@@ -596,6 +637,11 @@ App::stage_cmd(ac_rg_stage* stage, void* ud)
   ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
   ac_cmd_set_scissor(cmd, 0, 0, width, height);
 
+  if (!p->m_constants.data)
+  {
+    return ac_result_success;
+  }
+
   ac_cmd_bind_pipeline(cmd, p->m_pipeline);
   ac_cmd_bind_set(cmd, p->m_db, ac_space0, stage->frame);
   ac_cmd_bind_set(cmd, p->m_db, ac_space1, 0);
@@ -1,5 +1,8 @@
 #include <ac/ac.h>
 #include <glm/glm.hpp>
+#include "upload_ring.hpp"
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
 #include "compiled/main.h"
 
 struct Vertex {
@@ -26,8 +29,12 @@ private:
     ColorImage = 0,
   };
 
+  static constexpr uint64_t UPLOAD_RING_SIZE = 64 * 1024;
+
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -45,7 +52,9 @@ private:
   ac_shader   m_vertex_shader = {};
   ac_shader   m_fragment_shader = {};
 
-  ac_buffer m_vertex_buffers[AC_MAX_FRAME_IN_FLIGHT] = {};
+  // vertices are rewritten every frame, so they live in transient memory
+  UploadRing       m_upload;
+  UploadAllocation m_vertices = {};
 
   static void
   window_callback(const ac_window_event* event, void* ud);
@@ -109,6 +118,8 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -160,26 +171,12 @@ App::App()
     RIF(ac_create_dsl(m_device, &info, &m_dsl));
   }
 
-  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
-  {
-    ac_buffer_info info = {};
-    info.size = sizeof(Vertex) * 3;
-    info.usage = ac_buffer_usage_vertex_bit;
-    info.memory_usage = ac_memory_usage_cpu_to_gpu;
-    info.name = AC_DEBUG_NAME("vb");
-
-    RIF(ac_create_buffer(m_device, &info, &m_vertex_buffers[i]));
-    RIF(ac_buffer_map_memory(m_vertex_buffers[i]));
-
-    Vertex* v = (Vertex*)ac_buffer_get_mapped_memory(m_vertex_buffers[i]);
-
-    v[0].position = {-0.5f, -0.5f};
-    v[0].color = {0.0f, 0.0f, 1.0f};
-    v[1].position = {0.5f, -0.5f};
-    v[1].color = {0.0f, 1.0f, 0.0f};
-    v[2].position = {0.0f, 0.5f};
-    v[2].color = {1.0f, 0.0f, 0.0f};
-  }
+  RIF(m_upload.init(
+    m_device,
+    UPLOAD_RING_SIZE,
+    ac_buffer_usage_vertex_bit | ac_buffer_usage_index_bit |
+      ac_buffer_usage_cbv_bit,
+    AC_DEBUG_NAME("upload ring")));
 
   RIF(create_window_dependents());
 
@@ -193,9 +190,10 @@ App::~App()
     RIF(ac_queue_wait_idle(
       ac_device_get_queue(m_device, ac_queue_type_graphics)));
 
+    m_upload.shutdown();
+
     for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
     {
-      ac_destroy_buffer(m_vertex_buffers[i]);
       ac_destroy_fence(m_render_finished_fences[i]);
       ac_destroy_fence(m_acquire_finished_fences[i]);
     }
@@ -229,15 +227,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_result res;
@@ -248,7 +248,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -256,10 +256,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -271,10 +273,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -289,9 +293,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -323,8 +332,8 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
@@ -374,8 +383,20 @@ App::stage_prepare(ac_rg_stage* stage, void* ud)
 {
   App* p = static_cast<App*>(ud);
 
-  Vertex* v =
-    (Vertex*)ac_buffer_get_mapped_memory(p->m_vertex_buffers[stage->frame]);
+  p->m_upload.begin_frame(stage->frame);
+  p->m_vertices = p->m_upload.allocate(sizeof(Vertex) * 3, sizeof(Vertex));
+
+  // out of transient memory, the triangle is skipped this frame
+  if (!p->m_vertices.data)
+  {
+    return ac_result_success;
+  }
+
+  Vertex* v = static_cast<Vertex*>(p->m_vertices.data);
+
+  v[0].position = {-0.5f, -0.5f};
+  v[1].position = {0.5f, -0.5f};
+  v[2].position = {0.0f, 0.5f};
 
   float t = (float)ac_get_time(ac_time_unit_milliseconds) / 1000.0f;
 
@@ -405,8 +426,17 @@ App::stage_cmd(ac_rg_stage* stage, void* ud)
   ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
   ac_cmd_set_scissor(cmd, 0, 0, width, height);
 
+  if (!p->m_vertices.data)
+  {
+    return ac_result_success;
+  }
+
   ac_cmd_bind_pipeline(cmd, p->m_pipeline);
-  ac_cmd_bind_vertex_buffer(cmd, 0, p->m_vertex_buffers[stage->frame], 0);
+  ac_cmd_bind_vertex_buffer(
+    cmd,
+    0,
+    p->m_vertices.buffer,
+    p->m_vertices.offset);
   ac_cmd_draw(cmd, 3, 1, 0, 0);
 
   return ac_result_success;
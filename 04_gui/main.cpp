@@ -2,6 +2,8 @@
 #include <imgui.h>
 #include <imgui_impl_ac_renderer.hpp>
 #include <imgui_impl_ac_window.hpp>
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
 
 #define RIF(x)                                                                 \
   do                                                                           \
@@ -23,7 +25,9 @@ private:
   };
 
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -96,6 +100,8 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -180,15 +186,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_imgui_window_new_frame();
@@ -202,7 +210,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -210,10 +218,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -225,10 +235,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -245,9 +257,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -279,8 +296,8 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
@@ -0,0 +1,461 @@
+#include <algorithm>
+#include "animation.hpp"
+
+// a[i] = nlerp(a[i], b[i], weights[i]) along the shortest arc
+static void
+nlerp_batch(
+  glm::quat*       a,
+  const glm::quat* b,
+  const float*     weights,
+  size_t           count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    float w = weights[i];
+    if (w == 0.0f)
+    {
+      continue;
+    }
+
+    float s = glm::dot(a[i], b[i]) < 0.0f ? -w : w;
+    a[i] = glm::normalize(a[i] * (1.0f - w) + b[i] * s);
+  }
+}
+
+// glTF cubic spline between keys dt apart, v0 with its out tangent b0 and
+// v1 with its in tangent a1
+template <typename T>
+static T
+hermite(const T& v0, const T& b0, const T& v1, const T& a1, float dt, float u)
+{
+  float u2 = u * u;
+  float u3 = u2 * u;
+
+  return v0 * (2.0f * u3 - 3.0f * u2 + 1.0f) +
+         b0 * ((u3 - 2.0f * u2 + u) * dt) + v1 * (-2.0f * u3 + 3.0f * u2) +
+         a1 * ((u3 - u2) * dt);
+}
+
+void
+Pose::resize(size_t node_count, size_t weight_count)
+{
+  translations.resize(node_count);
+  rotations.resize(node_count);
+  scales.resize(node_count);
+  morph_weights.resize(weight_count);
+}
+
+void
+AnimationBlender::add_slots(Node* node)
+{
+  slots.push_back(node);
+
+  for (Node* child : node->children)
+  {
+    add_slots(child);
+  }
+}
+
+void
+AnimationBlender::init(Model* model)
+{
+  this->model = model;
+
+  slots.clear();
+  masks.clear();
+  channel_slots.clear();
+
+  // parent first, the same order the hierarchy update walks
+  for (Node* node : model->nodes)
+  {
+    add_slots(node);
+  }
+
+  uint32_t max_index = 0;
+  for (Node* node : slots)
+  {
+    max_index = std::max(max_index, node->index);
+  }
+
+  std::vector<int32_t> slot_of_index(max_index + 1, -1);
+
+  size_t weight_count = 0;
+  weight_offsets.assign(slots.size(), -1);
+
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    Node* node = slots[i];
+    slot_of_index[node->index] = static_cast<int32_t>(i);
+
+    if (node->mesh && !node->mesh->morph_weights.empty())
+    {
+      weight_offsets[i] = static_cast<int32_t>(weight_count);
+      weight_count += node->mesh->morph_weights.size();
+    }
+  }
+
+  rest_pose.resize(slots.size(), weight_count);
+
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    Node* node = slots[i];
+    rest_pose.translations[i] = node->translation;
+    rest_pose.rotations[i] = node->rotation;
+    rest_pose.scales[i] = node->scale;
+
+    if (weight_offsets[i] >= 0)
+    {
+      std::copy(
+        node->mesh->morph_weights.begin(),
+        node->mesh->morph_weights.end(),
+        rest_pose.morph_weights.begin() + weight_offsets[i]);
+    }
+  }
+
+  result = rest_pose;
+  slot_weights.resize(slots.size());
+
+  channel_slots.resize(model->animations.size());
+  for (size_t a = 0; a < model->animations.size(); ++a)
+  {
+    for (const AnimationChannel& channel : model->animations[a].channels)
+    {
+      channel_slots[a].push_back(slot_of_index[channel.node->index]);
+    }
+  }
+}
+
+int32_t
+AnimationBlender::create_mask(Node* root)
+{
+  std::vector<float> mask(slots.size(), 0.0f);
+
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    for (Node* node = slots[i]; node; node = node->parent)
+    {
+      if (node == root)
+      {
+        mask[i] = 1.0f;
+        break;
+      }
+    }
+  }
+
+  masks.push_back(mask);
+  return static_cast<int32_t>(masks.size() - 1);
+}
+
+void
+AnimationBlender::sample(uint32_t clip, float time, Pose& pose) const
+{
+  // nodes the clip does not animate keep their rest transform
+  pose.translations = rest_pose.translations;
+  pose.rotations = rest_pose.rotations;
+  pose.scales = rest_pose.scales;
+  pose.morph_weights = rest_pose.morph_weights;
+
+  const Animation& animation = model->animations[clip];
+
+  for (size_t c = 0; c < animation.channels.size(); ++c)
+  {
+    const AnimationChannel& channel = animation.channels[c];
+    const AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
+    int32_t                 slot = channel_slots[clip][c];
+
+    if (slot < 0 || sampler.inputs.empty())
+    {
+      continue;
+    }
+
+    const std::vector<float>& inputs = sampler.inputs;
+
+    float  t = glm::clamp(time, inputs.front(), inputs.back());
+    size_t next = std::upper_bound(inputs.begin(), inputs.end(), t) -
+                  inputs.begin();
+    size_t i0 = next > 0 ? next - 1 : 0;
+    size_t i1 = std::min(i0 + 1, inputs.size() - 1);
+
+    float u = 0.0f;
+    if (i1 != i0 && sampler.interpolation != AnimationSampler::STEP)
+    {
+      u = (t - inputs[i0]) / (inputs[i1] - inputs[i0]);
+    }
+
+    // cubic spline keys are stored as in tangent, value, out tangent, so
+    // the out tangent of k0 follows it and the in tangent of k1 precedes it
+    size_t stride = 1;
+    size_t offset = 0;
+    if (sampler.interpolation == AnimationSampler::CUBICSPLINE)
+    {
+      stride = 3;
+      offset = 1;
+    }
+
+    size_t k0 = i0 * stride + offset;
+    size_t k1 = i1 * stride + offset;
+    bool   cubic = stride == 3 && i1 != i0;
+    float  dt = inputs[i1] - inputs[i0];
+
+    const std::vector<glm::vec4>& values = sampler.outputs_vec4;
+
+    auto interpolate = [&]()
+    {
+      if (cubic)
+      {
+        return hermite(
+          values[k0],
+          values[k0 + 1],
+          values[k1],
+          values[k1 - 1],
+          dt,
+          u);
+      }
+      return glm::mix(values[k0], values[k1], u);
+    };
+
+    switch (channel.path)
+    {
+    case AnimationChannel::TRANSLATION:
+    {
+      if (k1 < values.size())
+      {
+        pose.translations[slot] = glm::vec3(interpolate());
+      }
+      break;
+    }
+    case AnimationChannel::SCALE:
+    {
+      if (k1 < values.size())
+      {
+        pose.scales[slot] = glm::vec3(interpolate());
+      }
+      break;
+    }
+    case AnimationChannel::ROTATION:
+    {
+      if (k1 >= values.size())
+      {
+        break;
+      }
+
+      // cubic rotations are interpolated per component and normalized
+      if (cubic)
+      {
+        glm::vec4 v = interpolate();
+        pose.rotations[slot] = glm::normalize(glm::quat(v.w, v.x, v.y, v.z));
+      }
+      else
+      {
+        const glm::vec4& v0 = values[k0];
+        const glm::vec4& v1 = values[k1];
+        glm::quat        q0(v0.w, v0.x, v0.y, v0.z);
+        glm::quat        q1(v1.w, v1.x, v1.y, v1.z);
+        pose.rotations[slot] = glm::normalize(glm::slerp(q0, q1, u));
+      }
+      break;
+    }
+    case AnimationChannel::WEIGHTS:
+    {
+      int32_t weight_offset = weight_offsets[slot];
+      if (weight_offset < 0)
+      {
+        break;
+      }
+
+      size_t count = slots[slot]->mesh->morph_weights.size();
+      if ((k1 + 1) * count > sampler.outputs.size())
+      {
+        break;
+      }
+
+      const float* w0 = sampler.outputs.data() + k0 * count;
+      const float* w1 = sampler.outputs.data() + k1 * count;
+      float*       out = pose.morph_weights.data() + weight_offset;
+
+      if (cubic)
+      {
+        const float* b0 = w0 + count;
+        const float* a1 = w1 - count;
+        for (size_t i = 0; i < count; ++i)
+        {
+          out[i] = hermite(w0[i], b0[i], w1[i], a1[i], dt, u);
+        }
+        break;
+      }
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        out[i] = glm::mix(w0[i], w1[i], u);
+      }
+      break;
+    }
+    }
+  }
+}
+
+void
+AnimationBlender::blend(
+  const Pose&               pose,
+  const std::vector<float>* mask,
+  float                     weight)
+{
+  size_t count = slots.size();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    slot_weights[i] = mask ? (*mask)[i] * weight : weight;
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    result.translations[i] =
+      glm::mix(result.translations[i], pose.translations[i], slot_weights[i]);
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    result.scales[i] =
+      glm::mix(result.scales[i], pose.scales[i], slot_weights[i]);
+  }
+
+  nlerp_batch(
+    result.rotations.data(),
+    pose.rotations.data(),
+    slot_weights.data(),
+    count);
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (weight_offsets[i] < 0 || slot_weights[i] == 0.0f)
+    {
+      continue;
+    }
+
+    size_t first = weight_offsets[i];
+    size_t last = first + slots[i]->mesh->morph_weights.size();
+    for (size_t w = first; w < last; ++w)
+    {
+      result.morph_weights[w] = glm::mix(
+        result.morph_weights[w],
+        pose.morph_weights[w],
+        slot_weights[i]);
+    }
+  }
+}
+
+void
+AnimationBlender::blend_additive(
+  const Pose&               pose,
+  const std::vector<float>* mask,
+  float                     weight)
+{
+  size_t count = slots.size();
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    slot_weights[i] = mask ? (*mask)[i] * weight : weight;
+  }
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    float w = slot_weights[i];
+    if (w == 0.0f)
+    {
+      continue;
+    }
+
+    result.translations[i] +=
+      (pose.translations[i] - rest_pose.translations[i]) * w;
+    result.scales[i] *=
+      glm::mix(glm::vec3(1.0f), pose.scales[i] / rest_pose.scales[i], w);
+
+    glm::quat delta =
+      glm::inverse(rest_pose.rotations[i]) * pose.rotations[i];
+    glm::quat identity = glm::identity<glm::quat>();
+    nlerp_batch(&identity, &delta, &w, 1);
+    result.rotations[i] = glm::normalize(result.rotations[i] * identity);
+
+    if (weight_offsets[i] >= 0)
+    {
+      size_t first = weight_offsets[i];
+      size_t last = first + slots[i]->mesh->morph_weights.size();
+      for (size_t j = first; j < last; ++j)
+      {
+        result.morph_weights[j] +=
+          (pose.morph_weights[j] - rest_pose.morph_weights[j]) * w;
+      }
+    }
+  }
+}
+
+void
+AnimationBlender::apply()
+{
+  for (size_t i = 0; i < slots.size(); ++i)
+  {
+    Node* node = slots[i];
+    node->translation = result.translations[i];
+    node->rotation = result.rotations[i];
+    node->scale = result.scales[i];
+
+    if (weight_offsets[i] >= 0)
+    {
+      std::vector<float>& weights = node->mesh->morph_weights;
+      std::copy(
+        result.morph_weights.begin() + weight_offsets[i],
+        result.morph_weights.begin() + weight_offsets[i] + weights.size(),
+        weights.begin());
+    }
+  }
+
+  for (Node* node : model->nodes)
+  {
+    node->update();
+  }
+}
+
+void
+AnimationBlender::evaluate(const AnimationLayer* layers, uint32_t layer_count)
+{
+  if (layer_poses.size() < layer_count)
+  {
+    layer_poses.resize(layer_count);
+  }
+
+  for (uint32_t i = 0; i < layer_count; ++i)
+  {
+    if (layers[i].weight > 0.0f && layers[i].clip < model->animations.size())
+    {
+      sample(layers[i].clip, layers[i].time, layer_poses[i]);
+    }
+  }
+
+  result.translations = rest_pose.translations;
+  result.rotations = rest_pose.rotations;
+  result.scales = rest_pose.scales;
+  result.morph_weights = rest_pose.morph_weights;
+
+  for (uint32_t i = 0; i < layer_count; ++i)
+  {
+    const AnimationLayer& layer = layers[i];
+    if (layer.weight <= 0.0f || layer.clip >= model->animations.size())
+    {
+      continue;
+    }
+
+    const std::vector<float>* mask =
+      layer.mask >= 0 ? &masks[layer.mask] : nullptr;
+
+    if (layer.additive)
+    {
+      blend_additive(layer_poses[i], mask, layer.weight);
+    }
+    else
+    {
+      blend(layer_poses[i], mask, layer.weight);
+    }
+  }
+
+  apply();
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include "model.hpp"
+
+// local transforms of every node in the blender's slot order, stored as
+// separate arrays so blending walks contiguous memory
+struct Pose {
+  std::vector<glm::vec3> translations;
+  std::vector<glm::quat> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<float>     morph_weights;
+
+  void
+  resize(size_t node_count, size_t weight_count);
+};
+
+struct AnimationLayer {
+  uint32_t clip = 0;
+  float    time = 0.0f;
+  float    weight = 1.0f;
+  // additive layers are applied relative to the rest pose on top of the
+  // layers before them
+  bool    additive = false;
+  // index returned by AnimationBlender::create_mask, -1 affects every node
+  int32_t mask = -1;
+};
+
+struct AnimationBlender {
+  Model*                          model = nullptr;
+  std::vector<Node*>              slots;
+  std::vector<int32_t>            weight_offsets;
+  Pose                            rest_pose;
+  Pose                            result;
+  std::vector<Pose>               layer_poses;
+  std::vector<std::vector<float>> masks;
+  std::vector<float>              slot_weights;
+
+  // channel targets resolved to slots once, indexed [clip][channel]
+  std::vector<std::vector<int32_t>> channel_slots;
+
+  void
+  init(Model* model);
+
+  // returns a mask that weights the subtree under root with 1 and every
+  // other node with 0
+  int32_t
+  create_mask(Node* root);
+
+  void
+  sample(uint32_t clip, float time, Pose& pose) const;
+
+  // samples every layer into its own pose, blends them in order and writes
+  // the final pose to the nodes with a single hierarchy update
+  void
+  evaluate(const AnimationLayer* layers, uint32_t layer_count);
+
+private:
+  void
+  add_slots(Node* node);
+
+  void
+  blend(const Pose& pose, const std::vector<float>* mask, float weight);
+
+  void
+  blend_additive(
+    const Pose&               pose,
+    const std::vector<float>* mask,
+    float                     weight);
+
+  void
+  apply();
+};
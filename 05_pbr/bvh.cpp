@@ -0,0 +1,702 @@
+#include <algorithm>
+#include <atomic>
+#include "bvh.hpp"
+
+#define BVH_BIN_COUNT 16
+// leaves are never larger than this, smaller ones stop when sah says so
+#define BVH_MAX_LEAF_SIZE 8
+// deeper nodes become leaves so traversal fits its fixed stack
+#define BVH_MAX_DEPTH 60
+#define BVH_STACK_SIZE 64
+// subtrees with more items than this are handed to the job system
+#define BVH_PARALLEL_THRESHOLD 16384
+
+struct Bvh::BuildContext {
+  const std::vector<BoundingBox>* bounds;
+  std::vector<glm::vec3>          centroids;
+  std::atomic<uint32_t>           node_count {0};
+  JobSystem*                      jobs;
+  JobCounter                      counter;
+};
+
+static float
+half_area(glm::vec3 min, glm::vec3 max)
+{
+  glm::vec3 e = max - min;
+  return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+static float
+intersect_box(
+  const BvhNode&   node,
+  const glm::vec3& origin,
+  const glm::vec3& inv_direction,
+  float            t_max)
+{
+  glm::vec3 t0 = (node.min - origin) * inv_direction;
+  glm::vec3 t1 = (node.max - origin) * inv_direction;
+  glm::vec3 lo = glm::min(t0, t1);
+  glm::vec3 hi = glm::max(t0, t1);
+
+  float enter = std::max(std::max(lo.x, lo.y), std::max(lo.z, 0.0f));
+  float exit = std::min(std::min(hi.x, hi.y), std::min(hi.z, t_max));
+
+  return enter <= exit ? enter : FLT_MAX;
+}
+
+static bool
+overlaps(const BvhNode& node, const BoundingBox& box)
+{
+  return node.min.x <= box.max.x && node.max.x >= box.min.x &&
+         node.min.y <= box.max.y && node.max.y >= box.min.y &&
+         node.min.z <= box.max.z && node.max.z >= box.min.z;
+}
+
+// 0 outside, 1 intersecting, 2 fully inside
+static uint32_t
+classify(const Frustum& frustum, glm::vec3 min, glm::vec3 max)
+{
+  uint32_t result = 2;
+
+  for (const glm::vec4& plane : frustum.planes)
+  {
+    glm::vec3 p = glm::vec3(
+      plane.x > 0.0f ? max.x : min.x,
+      plane.y > 0.0f ? max.y : min.y,
+      plane.z > 0.0f ? max.z : min.z);
+    glm::vec3 n = glm::vec3(
+      plane.x > 0.0f ? min.x : max.x,
+      plane.y > 0.0f ? min.y : max.y,
+      plane.z > 0.0f ? min.z : max.z);
+
+    if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+    {
+      return 0;
+    }
+
+    if (glm::dot(glm::vec3(plane), n) + plane.w < 0.0f)
+    {
+      result = 1;
+    }
+  }
+
+  return result;
+}
+
+void
+Bvh::build(const std::vector<BoundingBox>& bounds, JobSystem* jobs)
+{
+  uint32_t count = static_cast<uint32_t>(bounds.size());
+
+  nodes.clear();
+  items.resize(count);
+
+  if (count == 0)
+  {
+    return;
+  }
+
+  BuildContext ctx;
+  ctx.bounds = &bounds;
+  ctx.jobs = jobs;
+  ctx.centroids.resize(count);
+
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    items[i] = i;
+    ctx.centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+  }
+
+  // a binary tree with count leaves never needs more than 2 * count - 1
+  nodes.resize(2 * count);
+  ctx.node_count = 1;
+
+  build_node(ctx, 0, 0, count, 0);
+
+  if (jobs)
+  {
+    jobs->wait(ctx.counter);
+  }
+
+  nodes.resize(ctx.node_count.load());
+}
+
+void
+Bvh::build_node(
+  BuildContext& ctx,
+  uint32_t      node_index,
+  uint32_t      first,
+  uint32_t      count,
+  uint32_t      depth)
+{
+  const std::vector<BoundingBox>& bounds = *ctx.bounds;
+
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+  glm::vec3 centroid_min = glm::vec3(FLT_MAX);
+  glm::vec3 centroid_max = glm::vec3(-FLT_MAX);
+
+  for (uint32_t i = first; i < first + count; ++i)
+  {
+    const BoundingBox& box = bounds[items[i]];
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+    centroid_min = glm::min(centroid_min, ctx.centroids[items[i]]);
+    centroid_max = glm::max(centroid_max, ctx.centroids[items[i]]);
+  }
+
+  BvhNode& node = nodes[node_index];
+  node.min = min;
+  node.max = max;
+  node.first = first;
+  node.count = count;
+
+  glm::vec3 extent = centroid_max - centroid_min;
+  uint32_t  axis = 0;
+  if (extent.y > extent[axis])
+  {
+    axis = 1;
+  }
+  if (extent.z > extent[axis])
+  {
+    axis = 2;
+  }
+
+  // identical centroids cannot be separated by binning
+  if (count <= 2 || depth >= BVH_MAX_DEPTH || !(extent[axis] > 0.0f))
+  {
+    return;
+  }
+
+  struct Bin {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+    uint32_t  count = 0;
+  } bins[BVH_BIN_COUNT];
+
+  float bin_scale = BVH_BIN_COUNT / extent[axis];
+  float bin_base = centroid_min[axis];
+
+  auto bin_of = [&](uint32_t item)
+  {
+    float   offset = ctx.centroids[item][axis] - bin_base;
+    int32_t bin = static_cast<int32_t>(offset * bin_scale);
+    return std::min(std::max(bin, 0), BVH_BIN_COUNT - 1);
+  };
+
+  for (uint32_t i = first; i < first + count; ++i)
+  {
+    Bin& bin = bins[bin_of(items[i])];
+    bin.min = glm::min(bin.min, bounds[items[i]].min);
+    bin.max = glm::max(bin.max, bounds[items[i]].max);
+    bin.count++;
+  }
+
+  // sweep from the right to get the cost of everything past each plane
+  float     right_area[BVH_BIN_COUNT];
+  uint32_t  right_count[BVH_BIN_COUNT];
+  glm::vec3 sweep_min = glm::vec3(FLT_MAX);
+  glm::vec3 sweep_max = glm::vec3(-FLT_MAX);
+  uint32_t  sweep_count = 0;
+
+  for (int32_t b = BVH_BIN_COUNT - 1; b > 0; --b)
+  {
+    sweep_min = glm::min(sweep_min, bins[b].min);
+    sweep_max = glm::max(sweep_max, bins[b].max);
+    sweep_count += bins[b].count;
+    right_area[b] = half_area(sweep_min, sweep_max);
+    right_count[b] = sweep_count;
+  }
+
+  float   best_cost = FLT_MAX;
+  int32_t best_split = 0;
+
+  sweep_min = glm::vec3(FLT_MAX);
+  sweep_max = glm::vec3(-FLT_MAX);
+  sweep_count = 0;
+
+  for (int32_t b = 0; b < BVH_BIN_COUNT - 1; ++b)
+  {
+    sweep_min = glm::min(sweep_min, bins[b].min);
+    sweep_max = glm::max(sweep_max, bins[b].max);
+    sweep_count += bins[b].count;
+
+    if (sweep_count == 0 || right_count[b + 1] == 0)
+    {
+      continue;
+    }
+
+    float cost = sweep_count * half_area(sweep_min, sweep_max) +
+                 right_count[b + 1] * right_area[b + 1];
+    if (cost < best_cost)
+    {
+      best_cost = cost;
+      best_split = b;
+    }
+  }
+
+  float leaf_cost = count * half_area(min, max);
+  if (
+    best_cost == FLT_MAX ||
+    (count <= BVH_MAX_LEAF_SIZE && best_cost >= leaf_cost))
+  {
+    return;
+  }
+
+  uint32_t* begin = items.data() + first;
+  uint32_t* middle = std::partition(
+    begin,
+    begin + count,
+    [&](uint32_t item) { return bin_of(item) <= best_split; });
+  uint32_t left_count = static_cast<uint32_t>(middle - begin);
+
+  uint32_t left = ctx.node_count.fetch_add(2);
+
+  // nodes is sized up front, so node stays valid while children are built
+  node.first = left;
+  node.count = 0;
+
+  if (ctx.jobs && count > BVH_PARALLEL_THRESHOLD)
+  {
+    ctx.jobs->submit(
+      ctx.counter,
+      [this, &ctx, left, first, left_count, depth](uint32_t)
+      { build_node(ctx, left, first, left_count, depth + 1); });
+  }
+  else
+  {
+    build_node(ctx, left, first, left_count, depth + 1);
+  }
+
+  build_node(
+    ctx,
+    left + 1,
+    first + left_count,
+    count - left_count,
+    depth + 1);
+}
+
+void
+Bvh::refit(const std::vector<BoundingBox>& bounds)
+{
+  // children are always allocated after their parent, so walking backwards
+  // visits every node after both of its children
+  for (size_t i = nodes.size(); i-- > 0;)
+  {
+    BvhNode& node = nodes[i];
+
+    if (node.count > 0)
+    {
+      node.min = glm::vec3(FLT_MAX);
+      node.max = glm::vec3(-FLT_MAX);
+
+      for (uint32_t j = node.first; j < node.first + node.count; ++j)
+      {
+        node.min = glm::min(node.min, bounds[items[j]].min);
+        node.max = glm::max(node.max, bounds[items[j]].max);
+      }
+    }
+    else
+    {
+      const BvhNode& left = nodes[node.first];
+      const BvhNode& right = nodes[node.first + 1];
+      node.min = glm::min(left.min, right.min);
+      node.max = glm::max(left.max, right.max);
+    }
+  }
+}
+
+void
+Bvh::add_subtree(uint32_t node_index, std::vector<uint32_t>& out) const
+{
+  uint32_t stack[BVH_STACK_SIZE];
+  uint32_t top = 0;
+  stack[top++] = node_index;
+
+  while (top > 0)
+  {
+    const BvhNode& node = nodes[stack[--top]];
+
+    if (node.count > 0)
+    {
+      out.insert(
+        out.end(),
+        items.begin() + node.first,
+        items.begin() + node.first + node.count);
+      continue;
+    }
+
+    stack[top++] = node.first;
+    stack[top++] = node.first + 1;
+  }
+}
+
+void
+Bvh::query_aabb(const BoundingBox& box, std::vector<uint32_t>& out) const
+{
+  if (nodes.empty())
+  {
+    return;
+  }
+
+  uint32_t stack[BVH_STACK_SIZE];
+  uint32_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    const BvhNode& node = nodes[stack[--top]];
+
+    if (!overlaps(node, box))
+    {
+      continue;
+    }
+
+    if (node.count > 0)
+    {
+      out.insert(
+        out.end(),
+        items.begin() + node.first,
+        items.begin() + node.first + node.count);
+      continue;
+    }
+
+    stack[top++] = node.first;
+    stack[top++] = node.first + 1;
+  }
+}
+
+void
+Bvh::query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const
+{
+  if (nodes.empty())
+  {
+    return;
+  }
+
+  uint32_t stack[BVH_STACK_SIZE];
+  uint32_t top = 0;
+  stack[top++] = 0;
+
+  while (top > 0)
+  {
+    uint32_t       index = stack[--top];
+    const BvhNode& node = nodes[index];
+
+    uint32_t result = classify(frustum, node.min, node.max);
+    if (result == 0)
+    {
+      continue;
+    }
+
+    // fully contained subtrees skip all further plane tests
+    if (result == 2 || node.count > 0)
+    {
+      add_subtree(index, out);
+      continue;
+    }
+
+    stack[top++] = node.first;
+    stack[top++] = node.first + 1;
+  }
+}
+
+void
+Bvh::traverse_ray(
+  const BvhRay&                                 ray,
+  const std::function<float(uint32_t, float)>& fn) const
+{
+  if (nodes.empty())
+  {
+    return;
+  }
+
+  glm::vec3 inv_direction = 1.0f / ray.direction;
+  float     t_max = ray.t_max;
+
+  struct Entry {
+    uint32_t node;
+    float    t;
+  };
+
+  Entry    stack[BVH_STACK_SIZE];
+  uint32_t top = 0;
+
+  float t_root = intersect_box(nodes[0], ray.origin, inv_direction, t_max);
+  if (t_root == FLT_MAX)
+  {
+    return;
+  }
+  stack[top++] = {0, t_root};
+
+  while (top > 0)
+  {
+    Entry entry = stack[--top];
+
+    // a closer hit was found after this node was pushed
+    if (entry.t > t_max)
+    {
+      continue;
+    }
+
+    const BvhNode& node = nodes[entry.node];
+
+    if (node.count > 0)
+    {
+      for (uint32_t i = node.first; i < node.first + node.count; ++i)
+      {
+        t_max = fn(items[i], t_max);
+      }
+      continue;
+    }
+
+    Entry closer = {node.first, 0.0f};
+    Entry further = {node.first + 1, 0.0f};
+    closer.t =
+      intersect_box(nodes[closer.node], ray.origin, inv_direction, t_max);
+    further.t =
+      intersect_box(nodes[further.node], ray.origin, inv_direction, t_max);
+
+    if (further.t < closer.t)
+    {
+      std::swap(closer, further);
+    }
+
+    // the closer child is pushed last so it is visited first
+    if (further.t != FLT_MAX)
+    {
+      stack[top++] = further;
+    }
+    if (closer.t != FLT_MAX)
+    {
+      stack[top++] = closer;
+    }
+  }
+}
+
+void
+SceneBvh::build(Model& model, JobSystem* jobs)
+{
+  m_model = &model;
+  m_nodes.clear();
+
+  for (Node* node : model.linear_nodes)
+  {
+    if (node->mesh)
+    {
+      m_nodes.push_back(node);
+    }
+  }
+
+  m_meshes.clear();
+  m_meshes.resize(m_nodes.size());
+
+  std::vector<BoundingBox> triangle_bounds;
+
+  for (size_t i = 0; i < m_nodes.size(); ++i)
+  {
+    MeshBvh& mesh_bvh = m_meshes[i];
+    triangle_bounds.clear();
+
+    // non indexed primitives are skipped, the loader never produces them for
+    // triangle meshes
+    for (Primitive* primitive : m_nodes[i]->mesh->primitives)
+    {
+      if (!primitive->has_indices)
+      {
+        continue;
+      }
+
+      uint32_t last = primitive->first_index + primitive->index_count;
+      for (uint32_t t = primitive->first_index; t + 2 < last; t += 3)
+      {
+        glm::vec3 a = model.positions[model.index_data[t]];
+        glm::vec3 b = model.positions[model.index_data[t + 1]];
+        glm::vec3 c = model.positions[model.index_data[t + 2]];
+
+        mesh_bvh.triangles.push_back(t);
+        triangle_bounds.push_back(BoundingBox(
+          glm::min(glm::min(a, b), c),
+          glm::max(glm::max(a, b), c)));
+      }
+    }
+
+    mesh_bvh.bvh.build(triangle_bounds, jobs);
+  }
+
+  m_top.nodes.clear();
+  refit();
+}
+
+void
+SceneBvh::refit()
+{
+  m_bounds.resize(m_nodes.size());
+
+  for (size_t i = 0; i < m_nodes.size(); ++i)
+  {
+    Node* node = m_nodes[i];
+    Mesh* mesh = node->mesh;
+
+    if (mesh->aabb.valid)
+    {
+      m_bounds[i] = mesh->aabb;
+    }
+    else if (mesh->bb.valid)
+    {
+      m_bounds[i] = mesh->bb.get_aabb(node->get_matrix());
+    }
+    else
+    {
+      glm::vec3 position = glm::vec3(node->get_matrix()[3]);
+      m_bounds[i] = BoundingBox(position, position);
+    }
+  }
+
+  if (m_top.nodes.empty())
+  {
+    m_top.build(m_bounds);
+  }
+  else
+  {
+    m_top.refit(m_bounds);
+  }
+}
+
+bool
+SceneBvh::pick(const BvhRay& ray, PickResult& result) const
+{
+  result = {};
+  result.t = ray.t_max;
+
+  m_top.traverse_ray(
+    ray,
+    [&](uint32_t item, float t_max)
+    {
+      Node*          node = m_nodes[item];
+      const MeshBvh& mesh_bvh = m_meshes[item];
+
+      // the ray parameter is unchanged by an affine transform, so hits in
+      // mesh space compare directly against world space t
+      glm::mat4 inverse = glm::inverse(node->get_matrix());
+
+      BvhRay local = {};
+      local.origin = glm::vec3(inverse * glm::vec4(ray.origin, 1.0f));
+      local.direction = glm::vec3(inverse * glm::vec4(ray.direction, 0.0f));
+      local.t_max = t_max;
+
+      mesh_bvh.bvh.traverse_ray(
+        local,
+        [&](uint32_t triangle, float t_closest)
+        {
+          uint32_t  first = mesh_bvh.triangles[triangle];
+          glm::vec3 a = m_model->positions[m_model->index_data[first]];
+          glm::vec3 b = m_model->positions[m_model->index_data[first + 1]];
+          glm::vec3 c = m_model->positions[m_model->index_data[first + 2]];
+
+          // moller trumbore, both faces count as hits
+          glm::vec3 e1 = b - a;
+          glm::vec3 e2 = c - a;
+          glm::vec3 p = glm::cross(local.direction, e2);
+          float     det = glm::dot(e1, p);
+
+          if (std::abs(det) < 1e-12f)
+          {
+            return t_closest;
+          }
+
+          float     inv_det = 1.0f / det;
+          glm::vec3 s = local.origin - a;
+          float     u = glm::dot(s, p) * inv_det;
+          if (u < 0.0f || u > 1.0f)
+          {
+            return t_closest;
+          }
+
+          glm::vec3 q = glm::cross(s, e1);
+          float     v = glm::dot(local.direction, q) * inv_det;
+          if (v < 0.0f || u + v > 1.0f)
+          {
+            return t_closest;
+          }
+
+          float t = glm::dot(e2, q) * inv_det;
+          if (t < 0.0f || t >= t_closest)
+          {
+            return t_closest;
+          }
+
+          result.node = node;
+          result.triangle = first;
+          result.t = t;
+          result.barycentrics = glm::vec2(u, v);
+          return t;
+        });
+
+      return result.t;
+    });
+
+  if (!result.node)
+  {
+    return false;
+  }
+
+  for (Primitive* primitive : result.node->mesh->primitives)
+  {
+    if (
+      result.triangle >= primitive->first_index &&
+      result.triangle < primitive->first_index + primitive->index_count)
+    {
+      result.primitive = primitive;
+      break;
+    }
+  }
+
+  return true;
+}
+
+void
+SceneBvh::query_aabb(const BoundingBox& box, std::vector<Node*>& out) const
+{
+  m_scratch.clear();
+  m_top.query_aabb(box, m_scratch);
+
+  for (uint32_t item : m_scratch)
+  {
+    const BoundingBox& bounds = m_bounds[item];
+    if (
+      bounds.min.x <= box.max.x && bounds.max.x >= box.min.x &&
+      bounds.min.y <= box.max.y && bounds.max.y >= box.min.y &&
+      bounds.min.z <= box.max.z && bounds.max.z >= box.min.z)
+    {
+      out.push_back(m_nodes[item]);
+    }
+  }
+}
+
+void
+SceneBvh::query_frustum(const Frustum& frustum, std::vector<Node*>& out) const
+{
+  m_scratch.clear();
+  m_top.query_frustum(frustum, m_scratch);
+
+  for (uint32_t item : m_scratch)
+  {
+    const BoundingBox& bounds = m_bounds[item];
+    if (classify(frustum, bounds.min, bounds.max) != 0)
+    {
+      out.push_back(m_nodes[item]);
+    }
+  }
+}
+
+uint32_t
+SceneBvh::get_triangle_count() const
+{
+  size_t count = 0;
+  for (const MeshBvh& mesh_bvh : m_meshes)
+  {
+    count += mesh_bvh.triangles.size();
+  }
+  return static_cast<uint32_t>(count);
+}
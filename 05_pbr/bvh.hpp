@@ -0,0 +1,117 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "model.hpp"
+#include "culling.hpp"
+#include "job_system.hpp"
+
+// 32 byte node. internal nodes store their two children next to each other
+// starting at first and have count 0, leaves store count items starting at
+// first in Bvh::items
+struct BvhNode {
+  glm::vec3 min;
+  uint32_t  first;
+  glm::vec3 max;
+  uint32_t  count;
+};
+
+struct BvhRay {
+  glm::vec3 origin;
+  glm::vec3 direction;
+  float     t_max = FLT_MAX;
+};
+
+// binned sah hierarchy over a set of item bounds. it only knows about boxes,
+// callers map items back to primitives, triangles or nodes
+class Bvh {
+public:
+  std::vector<BvhNode>  nodes;
+  std::vector<uint32_t> items;
+
+  // builds from scratch, subtrees above a size threshold are built on the
+  // job system when one is given
+  void
+  build(const std::vector<BoundingBox>& bounds, JobSystem* jobs = nullptr);
+
+  // recomputes node bounds bottom up for moved items, topology is kept so
+  // quality degrades when items move far from where they were built
+  void
+  refit(const std::vector<BoundingBox>& bounds);
+
+  void
+  query_aabb(const BoundingBox& box, std::vector<uint32_t>& out) const;
+
+  void
+  query_frustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+
+  // visits leaf items whose node the ray enters, nearer nodes first. the
+  // callback returns the new t_max so closest hit searches can shrink it
+  void
+  traverse_ray(
+    const BvhRay&                                 ray,
+    const std::function<float(uint32_t, float)>& fn) const;
+
+private:
+  struct BuildContext;
+
+  void
+  build_node(
+    BuildContext& ctx,
+    uint32_t      node_index,
+    uint32_t      first,
+    uint32_t      count,
+    uint32_t      depth);
+
+  void
+  add_subtree(uint32_t node_index, std::vector<uint32_t>& out) const;
+};
+
+struct PickResult {
+  Node*      node;
+  Primitive* primitive;
+  // first index of the hit triangle in Model::index_data
+  uint32_t   triangle;
+  float      t;
+  // weights of the second and third vertex, the first is 1 - u - v
+  glm::vec2  barycentrics;
+};
+
+// two levels: a triangle hierarchy per mesh in mesh space built once, and a
+// hierarchy over the world bounds of mesh nodes that is refit as they move.
+// skinned and morphed meshes are picked against their rest pose
+class SceneBvh {
+public:
+  void
+  build(Model& model, JobSystem* jobs = nullptr);
+
+  void
+  refit();
+
+  bool
+  pick(const BvhRay& ray, PickResult& result) const;
+
+  void
+  query_aabb(const BoundingBox& box, std::vector<Node*>& out) const;
+
+  void
+  query_frustum(const Frustum& frustum, std::vector<Node*>& out) const;
+
+  uint32_t
+  get_triangle_count() const;
+
+private:
+  struct MeshBvh {
+    Bvh                   bvh;
+    // first index of every triangle in Model::index_data
+    std::vector<uint32_t> triangles;
+  };
+
+  Model*                   m_model = nullptr;
+  Bvh                      m_top;
+  std::vector<Node*>       m_nodes;
+  std::vector<BoundingBox> m_bounds;
+  std::vector<MeshBvh>     m_meshes;
+  // candidates of the top level queries before the exact bounds test
+  mutable std::vector<uint32_t> m_scratch;
+};
@@ -0,0 +1,387 @@
+#include <algorithm>
+#include "culling.hpp"
+
+#if defined(__AVX__)
+#define CULLING_USE_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define CULLING_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// chunk size for the parallel path, a multiple of the widest simd batch
+#define CULL_CHUNK_SIZE 1024
+// boxes without valid bounds are never culled
+#define CULL_UNBOUNDED 1e30f
+
+static uint32_t
+count_bits(uint32_t mask)
+{
+  uint32_t count = 0;
+  while (mask)
+  {
+    mask &= mask - 1;
+    count++;
+  }
+  return count;
+}
+
+static void
+emit_mask(
+  uint32_t               base,
+  uint32_t               lanes,
+  uint32_t               frustum_mask,
+  uint32_t               keep_mask,
+  std::vector<uint32_t>& out,
+  CullStats&             stats)
+{
+  uint32_t lane_mask = (1u << lanes) - 1;
+  uint32_t visible = lane_mask & frustum_mask & keep_mask;
+
+  stats.tested += lanes;
+  stats.frustum_culled += count_bits(lane_mask & ~frustum_mask);
+  stats.contribution_culled +=
+    count_bits(lane_mask & frustum_mask & ~keep_mask);
+  stats.visible += count_bits(visible);
+
+  while (visible)
+  {
+    uint32_t bit = 0;
+    while (!(visible & (1u << bit)))
+    {
+      bit++;
+    }
+    out.push_back(base + bit);
+    visible &= visible - 1;
+  }
+}
+
+Frustum
+Frustum::from_matrix(const glm::mat4& m)
+{
+  glm::vec4 row0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+  glm::vec4 row1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+  glm::vec4 row2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+  glm::vec4 row3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+  Frustum frustum = {};
+  frustum.planes[0] = row3 + row0;
+  frustum.planes[1] = row3 - row0;
+  frustum.planes[2] = row3 + row1;
+  frustum.planes[3] = row3 - row1;
+  // depth range is zero to one
+  frustum.planes[4] = row2;
+  frustum.planes[5] = row3 - row2;
+
+  for (glm::vec4& plane : frustum.planes)
+  {
+    float length = glm::length(glm::vec3(plane));
+    if (length > 0.0f)
+    {
+      plane /= length;
+    }
+  }
+
+  return frustum;
+}
+
+void
+Culler::resize(uint32_t box_count)
+{
+  count = box_count;
+
+  uint32_t padded = (box_count + 7) & ~7u;
+  min_x.resize(padded, 0.0f);
+  min_y.resize(padded, 0.0f);
+  min_z.resize(padded, 0.0f);
+  max_x.resize(padded, 0.0f);
+  max_y.resize(padded, 0.0f);
+  max_z.resize(padded, 0.0f);
+}
+
+void
+Culler::set(uint32_t index, const BoundingBox& box)
+{
+  glm::vec3 min = glm::vec3(-CULL_UNBOUNDED);
+  glm::vec3 max = glm::vec3(CULL_UNBOUNDED);
+
+  if (box.valid)
+  {
+    min = box.min;
+    max = box.max;
+  }
+
+  min_x[index] = min.x;
+  min_y[index] = min.y;
+  min_z[index] = min.z;
+  max_x[index] = max.x;
+  max_y[index] = max.y;
+  max_z[index] = max.z;
+}
+
+void
+Culler::cull_range(
+  const Frustum&         frustum,
+  const glm::mat4&       view,
+  float                  projection_scale,
+  uint32_t               first,
+  uint32_t               last,
+  std::vector<uint32_t>& out,
+  CullStats&             out_stats) const
+{
+  // a box contributes when radius / depth * projection_scale covers at
+  // least min_screen_size, compared without the division
+  bool  test_size = min_screen_size > 0.0f;
+  float size_scale = projection_scale;
+  float threshold = min_screen_size;
+
+  // view space depth grows along -z
+  float vz_x = -view[0][2];
+  float vz_y = -view[1][2];
+  float vz_z = -view[2][2];
+  float vz_w = -view[3][2];
+
+#if defined(CULLING_USE_AVX)
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 half = _mm256_set1_ps(0.5f);
+
+  for (uint32_t i = first; i < last; i += 8)
+  {
+    __m256 mnx = _mm256_loadu_ps(&min_x[i]);
+    __m256 mny = _mm256_loadu_ps(&min_y[i]);
+    __m256 mnz = _mm256_loadu_ps(&min_z[i]);
+    __m256 mxx = _mm256_loadu_ps(&max_x[i]);
+    __m256 mxy = _mm256_loadu_ps(&max_y[i]);
+    __m256 mxz = _mm256_loadu_ps(&max_z[i]);
+
+    __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+
+    for (const glm::vec4& plane : frustum.planes)
+    {
+      // the corner furthest along the plane normal decides
+      __m256 px = plane.x > 0.0f ? mxx : mnx;
+      __m256 py = plane.y > 0.0f ? mxy : mny;
+      __m256 pz = plane.z > 0.0f ? mxz : mnz;
+
+      __m256 d = _mm256_add_ps(
+        _mm256_add_ps(
+          _mm256_mul_ps(px, _mm256_set1_ps(plane.x)),
+          _mm256_mul_ps(py, _mm256_set1_ps(plane.y))),
+        _mm256_add_ps(
+          _mm256_mul_ps(pz, _mm256_set1_ps(plane.z)),
+          _mm256_set1_ps(plane.w)));
+
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+    }
+
+    uint32_t frustum_mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+    uint32_t keep_mask = 0xff;
+
+    if (test_size && frustum_mask)
+    {
+      __m256 cx = _mm256_mul_ps(_mm256_add_ps(mnx, mxx), half);
+      __m256 cy = _mm256_mul_ps(_mm256_add_ps(mny, mxy), half);
+      __m256 cz = _mm256_mul_ps(_mm256_add_ps(mnz, mxz), half);
+      __m256 ex = _mm256_mul_ps(_mm256_sub_ps(mxx, mnx), half);
+      __m256 ey = _mm256_mul_ps(_mm256_sub_ps(mxy, mny), half);
+      __m256 ez = _mm256_mul_ps(_mm256_sub_ps(mxz, mnz), half);
+
+      __m256 radius = _mm256_sqrt_ps(_mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(ex, ex), _mm256_mul_ps(ey, ey)),
+        _mm256_mul_ps(ez, ez)));
+
+      __m256 depth = _mm256_add_ps(
+        _mm256_add_ps(
+          _mm256_mul_ps(cx, _mm256_set1_ps(vz_x)),
+          _mm256_mul_ps(cy, _mm256_set1_ps(vz_y))),
+        _mm256_add_ps(
+          _mm256_mul_ps(cz, _mm256_set1_ps(vz_z)),
+          _mm256_set1_ps(vz_w)));
+
+      __m256 covered = _mm256_cmp_ps(
+        _mm256_mul_ps(radius, _mm256_set1_ps(size_scale)),
+        _mm256_mul_ps(depth, _mm256_set1_ps(threshold)),
+        _CMP_GE_OQ);
+      // boxes around the camera always stay
+      __m256 around = _mm256_cmp_ps(depth, radius, _CMP_LE_OQ);
+
+      keep_mask = static_cast<uint32_t>(
+        _mm256_movemask_ps(_mm256_or_ps(covered, around)));
+    }
+
+    emit_mask(
+      i,
+      std::min(last - i, 8u),
+      frustum_mask,
+      keep_mask,
+      out,
+      out_stats);
+  }
+#elif defined(CULLING_USE_SSE)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  for (uint32_t i = first; i < last; i += 4)
+  {
+    __m128 mnx = _mm_loadu_ps(&min_x[i]);
+    __m128 mny = _mm_loadu_ps(&min_y[i]);
+    __m128 mnz = _mm_loadu_ps(&min_z[i]);
+    __m128 mxx = _mm_loadu_ps(&max_x[i]);
+    __m128 mxy = _mm_loadu_ps(&max_y[i]);
+    __m128 mxz = _mm_loadu_ps(&max_z[i]);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+
+    for (const glm::vec4& plane : frustum.planes)
+    {
+      // the corner furthest along the plane normal decides
+      __m128 px = plane.x > 0.0f ? mxx : mnx;
+      __m128 py = plane.y > 0.0f ? mxy : mny;
+      __m128 pz = plane.z > 0.0f ? mxz : mnz;
+
+      __m128 d = _mm_add_ps(
+        _mm_add_ps(
+          _mm_mul_ps(px, _mm_set1_ps(plane.x)),
+          _mm_mul_ps(py, _mm_set1_ps(plane.y))),
+        _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+    }
+
+    uint32_t frustum_mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+    uint32_t keep_mask = 0xf;
+
+    if (test_size && frustum_mask)
+    {
+      __m128 cx = _mm_mul_ps(_mm_add_ps(mnx, mxx), half);
+      __m128 cy = _mm_mul_ps(_mm_add_ps(mny, mxy), half);
+      __m128 cz = _mm_mul_ps(_mm_add_ps(mnz, mxz), half);
+      __m128 ex = _mm_mul_ps(_mm_sub_ps(mxx, mnx), half);
+      __m128 ey = _mm_mul_ps(_mm_sub_ps(mxy, mny), half);
+      __m128 ez = _mm_mul_ps(_mm_sub_ps(mxz, mnz), half);
+
+      __m128 radius = _mm_sqrt_ps(_mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(ex, ex), _mm_mul_ps(ey, ey)),
+        _mm_mul_ps(ez, ez)));
+
+      __m128 depth = _mm_add_ps(
+        _mm_add_ps(
+          _mm_mul_ps(cx, _mm_set1_ps(vz_x)),
+          _mm_mul_ps(cy, _mm_set1_ps(vz_y))),
+        _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(vz_z)), _mm_set1_ps(vz_w)));
+
+      __m128 covered = _mm_cmpge_ps(
+        _mm_mul_ps(radius, _mm_set1_ps(size_scale)),
+        _mm_mul_ps(depth, _mm_set1_ps(threshold)));
+      // boxes around the camera always stay
+      __m128 around = _mm_cmple_ps(depth, radius);
+
+      keep_mask =
+        static_cast<uint32_t>(_mm_movemask_ps(_mm_or_ps(covered, around)));
+    }
+
+    emit_mask(
+      i,
+      std::min(last - i, 4u),
+      frustum_mask,
+      keep_mask,
+      out,
+      out_stats);
+  }
+#else
+  for (uint32_t i = first; i < last; ++i)
+  {
+    glm::vec3 min = glm::vec3(min_x[i], min_y[i], min_z[i]);
+    glm::vec3 max = glm::vec3(max_x[i], max_y[i], max_z[i]);
+
+    uint32_t frustum_mask = 1;
+    for (const glm::vec4& plane : frustum.planes)
+    {
+      glm::vec3 p = glm::vec3(
+        plane.x > 0.0f ? max.x : min.x,
+        plane.y > 0.0f ? max.y : min.y,
+        plane.z > 0.0f ? max.z : min.z);
+
+      if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+      {
+        frustum_mask = 0;
+        break;
+      }
+    }
+
+    uint32_t keep_mask = 1;
+
+    if (test_size && frustum_mask)
+    {
+      glm::vec3 center = (min + max) * 0.5f;
+      float     radius = glm::length((max - min) * 0.5f);
+      float     depth = vz_x * center.x + vz_y * center.y + vz_z * center.z +
+                    vz_w;
+
+      keep_mask = radius * size_scale >= depth * threshold || depth <= radius;
+    }
+
+    emit_mask(i, 1, frustum_mask, keep_mask, out, out_stats);
+  }
+#endif
+}
+
+void
+Culler::cull(
+  const glm::mat4& view,
+  const glm::mat4& projection,
+  JobSystem*       jobs)
+{
+  visible.clear();
+  stats = {};
+
+  if (count == 0)
+  {
+    return;
+  }
+
+  Frustum frustum = Frustum::from_matrix(projection * view);
+  // projection[1][1] maps view space height to ndc, ndc spans 2 units
+  float projection_scale = projection[1][1] * 0.5f;
+
+  if (!jobs || count < parallel_threshold)
+  {
+    cull_range(frustum, view, projection_scale, 0, count, visible, stats);
+    return;
+  }
+
+  uint32_t chunk_count = (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE;
+  m_chunk_visible.resize(chunk_count);
+  m_chunk_stats.assign(chunk_count, CullStats {});
+
+  jobs->parallel_for(
+    count,
+    CULL_CHUNK_SIZE,
+    [&](uint32_t first, uint32_t last, uint32_t)
+    {
+      uint32_t chunk = first / CULL_CHUNK_SIZE;
+      m_chunk_visible[chunk].clear();
+      cull_range(
+        frustum,
+        view,
+        projection_scale,
+        first,
+        last,
+        m_chunk_visible[chunk],
+        m_chunk_stats[chunk]);
+    });
+
+  // chunks are concatenated in order so the list stays sorted
+  for (uint32_t i = 0; i < chunk_count; ++i)
+  {
+    visible.insert(
+      visible.end(),
+      m_chunk_visible[i].begin(),
+      m_chunk_visible[i].end());
+
+    stats.tested += m_chunk_stats[i].tested;
+    stats.visible += m_chunk_stats[i].visible;
+    stats.frustum_culled += m_chunk_stats[i].frustum_culled;
+    stats.contribution_culled += m_chunk_stats[i].contribution_culled;
+  }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include "model.hpp"
+#include "job_system.hpp"
+
+struct Frustum {
+  // inward facing planes, xyz normal and w distance
+  glm::vec4 planes[6];
+
+  static Frustum
+  from_matrix(const glm::mat4& view_projection);
+};
+
+struct CullStats {
+  uint32_t tested;
+  uint32_t visible;
+  uint32_t frustum_culled;
+  uint32_t contribution_culled;
+};
+
+// world space boxes kept as separate arrays padded to a multiple of 8 so
+// the tests can run 4 (SSE) or 8 (AVX) boxes per iteration
+struct Culler {
+  std::vector<float>    min_x;
+  std::vector<float>    min_y;
+  std::vector<float>    min_z;
+  std::vector<float>    max_x;
+  std::vector<float>    max_y;
+  std::vector<float>    max_z;
+  uint32_t              count = 0;
+  std::vector<uint32_t> visible;
+  CullStats             stats = {};
+
+  // boxes whose projected radius covers less than this fraction of the
+  // viewport height are dropped, 0 disables the test
+  float min_screen_size = 0.0f;
+  // box count from which the test is split across the job system
+  uint32_t parallel_threshold = 4096;
+
+  void
+  resize(uint32_t box_count);
+
+  void
+  set(uint32_t index, const BoundingBox& box);
+
+  // fills visible with the indices of boxes that pass, in ascending order
+  void
+  cull(
+    const glm::mat4& view,
+    const glm::mat4& projection,
+    JobSystem*       jobs = nullptr);
+
+private:
+  std::vector<std::vector<uint32_t>> m_chunk_visible;
+  std::vector<CullStats>             m_chunk_stats;
+
+  void
+  cull_range(
+    const Frustum&         frustum,
+    const glm::mat4&       view,
+    float                  projection_scale,
+    uint32_t               first,
+    uint32_t               last,
+    std::vector<uint32_t>& out,
+    CullStats&             out_stats) const;
+};
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include "geometry_heap.hpp"
+
+ac_result
+GeometryHeap::init(
+  ac_device device,
+  ac_queue  queue,
+  uint32_t  vertex_stride,
+  uint32_t  vertex_capacity,
+  uint32_t  index_capacity)
+{
+  m_device = device;
+  m_queue = queue;
+  m_vertex_stride = vertex_stride;
+
+  return rebuild(vertex_capacity, index_capacity);
+}
+
+void
+GeometryHeap::shutdown()
+{
+  ac_destroy_buffer(m_indices);
+  ac_destroy_buffer(m_vertices);
+  m_indices = NULL;
+  m_vertices = NULL;
+  m_ranges.clear();
+  m_vertex_allocator.init(0);
+  m_index_allocator.init(0);
+}
+
+ac_result
+GeometryHeap::allocate(
+  uint32_t       vertex_count,
+  uint32_t       index_count,
+  GeometryRange* range)
+{
+  *range = {};
+
+  for (uint32_t attempt = 0;; ++attempt)
+  {
+    uint32_t first_vertex = vertex_count
+                              ? m_vertex_allocator.allocate(vertex_count)
+                              : 0;
+    uint32_t first_index =
+      index_count ? m_index_allocator.allocate(index_count) : 0;
+
+    bool vertex_ok = first_vertex != RangeAllocator::INVALID_OFFSET;
+    bool index_ok = first_index != RangeAllocator::INVALID_OFFSET;
+
+    if (vertex_ok && index_ok)
+    {
+      range->first_vertex = first_vertex;
+      range->vertex_count = vertex_count;
+      range->first_index = first_index;
+      range->index_count = index_count;
+      m_ranges.push_back(range);
+      return ac_result_success;
+    }
+
+    if (vertex_ok && vertex_count)
+    {
+      m_vertex_allocator.free(first_vertex);
+    }
+    if (index_ok && index_count)
+    {
+      m_index_allocator.free(first_index);
+    }
+
+    if (attempt == 2)
+    {
+      return ac_result_unknown_error;
+    }
+
+    RangeAllocatorStats vertices = m_vertex_allocator.get_stats();
+    RangeAllocatorStats indices = m_index_allocator.get_stats();
+
+    bool fits = vertices.capacity - vertices.used >= vertex_count &&
+                indices.capacity - indices.used >= index_count;
+
+    // enough space in total means it is only scattered, packing is enough.
+    // otherwise grow geometrically so loading many models stays linear
+    if (attempt == 0 && fits)
+    {
+      AC_RIF(defragment());
+    }
+    else
+    {
+      AC_RIF(rebuild(
+        std::max(vertices.capacity * 2, vertices.used + vertex_count),
+        std::max(indices.capacity * 2, indices.used + index_count)));
+    }
+  }
+}
+
+void
+GeometryHeap::free(GeometryRange* range)
+{
+  auto it = std::find(m_ranges.begin(), m_ranges.end(), range);
+  if (it == m_ranges.end())
+  {
+    return;
+  }
+  m_ranges.erase(it);
+
+  if (range->vertex_count)
+  {
+    m_vertex_allocator.free(range->first_vertex);
+  }
+  if (range->index_count)
+  {
+    m_index_allocator.free(range->first_index);
+  }
+
+  *range = {};
+}
+
+ac_result
+GeometryHeap::defragment()
+{
+  return rebuild(
+    m_vertex_allocator.get_capacity(),
+    m_index_allocator.get_capacity());
+}
+
+ac_buffer
+GeometryHeap::get_vertex_buffer() const
+{
+  return m_vertices;
+}
+
+ac_buffer
+GeometryHeap::get_index_buffer() const
+{
+  return m_indices;
+}
+
+uint32_t
+GeometryHeap::get_generation() const
+{
+  return m_generation;
+}
+
+GeometryHeapStats
+GeometryHeap::get_stats() const
+{
+  GeometryHeapStats stats = {};
+  stats.vertices = m_vertex_allocator.get_stats();
+  stats.indices = m_index_allocator.get_stats();
+
+  uint32_t free_vertices = stats.vertices.capacity - stats.vertices.used;
+  uint32_t free_indices = stats.indices.capacity - stats.indices.used;
+
+  if (free_vertices)
+  {
+    stats.vertex_fragmentation =
+      1.0f - static_cast<float>(stats.vertices.largest_free) / free_vertices;
+  }
+  if (free_indices)
+  {
+    stats.index_fragmentation =
+      1.0f - static_cast<float>(stats.indices.largest_free) / free_indices;
+  }
+
+  return stats;
+}
+
+ac_result
+GeometryHeap::create_buffers(
+  uint32_t   vertex_capacity,
+  uint32_t   index_capacity,
+  ac_buffer* vertices,
+  ac_buffer* indices)
+{
+  {
+    ac_buffer_info info = {};
+    info.memory_usage = ac_memory_usage_gpu_only;
+    info.usage = ac_buffer_usage_vertex_bit | ac_buffer_usage_srv_bit |
+                 ac_buffer_usage_transfer_src_bit |
+                 ac_buffer_usage_transfer_dst_bit;
+    info.size = static_cast<uint64_t>(vertex_capacity) * m_vertex_stride;
+    info.name = AC_DEBUG_NAME("geometry heap vertices");
+    AC_RIF(ac_create_buffer(m_device, &info, vertices));
+  }
+
+  {
+    ac_buffer_info info = {};
+    info.memory_usage = ac_memory_usage_gpu_only;
+    // read as a shader resource by vertex pulling draws
+    info.usage = ac_buffer_usage_index_bit | ac_buffer_usage_srv_bit |
+                 ac_buffer_usage_transfer_src_bit |
+                 ac_buffer_usage_transfer_dst_bit;
+    info.size = static_cast<uint64_t>(index_capacity) * sizeof(uint32_t);
+    info.name = AC_DEBUG_NAME("geometry heap indices");
+    AC_RIF(ac_create_buffer(m_device, &info, indices));
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+GeometryHeap::copy_ranges(
+  ac_buffer                         vertices,
+  ac_buffer                         indices,
+  const std::vector<GeometryRange>& moved)
+{
+  // the old buffers may still be read by frames in flight
+  AC_RIF(ac_queue_wait_idle(m_queue));
+
+  ac_cmd_pool_info pool_info = {};
+  pool_info.queue = m_queue;
+  ac_cmd_pool pool = NULL;
+  AC_RIF(ac_create_cmd_pool(m_device, &pool_info, &pool));
+
+  ac_cmd    cmd = NULL;
+  ac_result res = ac_create_cmd(pool, &cmd);
+
+  if (res == ac_result_success)
+  {
+    ac_begin_cmd(cmd);
+
+    for (size_t i = 0; i < m_ranges.size(); ++i)
+    {
+      const GeometryRange& range = *m_ranges[i];
+
+      if (range.vertex_count)
+      {
+        ac_cmd_copy_buffer(
+          cmd,
+          m_vertices,
+          static_cast<uint64_t>(range.first_vertex) * m_vertex_stride,
+          vertices,
+          static_cast<uint64_t>(moved[i].first_vertex) * m_vertex_stride,
+          static_cast<uint64_t>(range.vertex_count) * m_vertex_stride);
+      }
+
+      if (range.index_count)
+      {
+        ac_cmd_copy_buffer(
+          cmd,
+          m_indices,
+          range.first_index * sizeof(uint32_t),
+          indices,
+          moved[i].first_index * sizeof(uint32_t),
+          range.index_count * sizeof(uint32_t));
+      }
+    }
+
+    ac_end_cmd(cmd);
+
+    ac_queue_submit_info submit_info = {};
+    submit_info.cmd_count = 1;
+    submit_info.cmds = &cmd;
+    res = ac_queue_submit(m_queue, &submit_info);
+
+    if (res == ac_result_success)
+    {
+      res = ac_queue_wait_idle(m_queue);
+    }
+
+    ac_destroy_cmd(cmd);
+  }
+
+  ac_destroy_cmd_pool(pool);
+
+  return res;
+}
+
+ac_result
+GeometryHeap::rebuild(uint32_t vertex_capacity, uint32_t index_capacity)
+{
+  // ranges are packed by fresh allocators. the heap keeps its buffers,
+  // allocators and ranges until the new buffers hold every range, so a
+  // failure leaves it as it was
+  RangeAllocator             vertex_allocator;
+  RangeAllocator             index_allocator;
+  std::vector<GeometryRange> moved(m_ranges.size());
+
+  vertex_allocator.init(vertex_capacity);
+  index_allocator.init(index_capacity);
+
+  // a fresh allocator hands out ranges back to back, so allocating in
+  // any order packs them
+  for (size_t i = 0; i < m_ranges.size(); ++i)
+  {
+    moved[i] = *m_ranges[i];
+
+    if (moved[i].vertex_count)
+    {
+      moved[i].first_vertex = vertex_allocator.allocate(moved[i].vertex_count);
+    }
+    if (moved[i].index_count)
+    {
+      moved[i].first_index = index_allocator.allocate(moved[i].index_count);
+    }
+  }
+
+  ac_buffer vertices = NULL;
+  ac_buffer indices = NULL;
+
+  ac_result res =
+    create_buffers(vertex_capacity, index_capacity, &vertices, &indices);
+
+  if (res == ac_result_success && !m_ranges.empty())
+  {
+    res = copy_ranges(vertices, indices, moved);
+  }
+
+  if (res != ac_result_success)
+  {
+    ac_destroy_buffer(vertices);
+    ac_destroy_buffer(indices);
+    return res;
+  }
+
+  for (size_t i = 0; i < m_ranges.size(); ++i)
+  {
+    *m_ranges[i] = moved[i];
+  }
+
+  m_vertex_allocator = std::move(vertex_allocator);
+  m_index_allocator = std::move(index_allocator);
+
+  ac_destroy_buffer(m_vertices);
+  ac_destroy_buffer(m_indices);
+  m_vertices = vertices;
+  m_indices = indices;
+  m_generation++;
+
+  return ac_result_success;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+#include <ac/ac.h>
+#include "range_allocator.hpp"
+
+// where a model lives in the shared buffers. offsets are in vertices and
+// indices, draws add them as vertex offset and first index
+struct GeometryRange {
+  uint32_t first_vertex = 0;
+  uint32_t vertex_count = 0;
+  uint32_t first_index = 0;
+  uint32_t index_count = 0;
+};
+
+struct GeometryHeapStats {
+  RangeAllocatorStats vertices;
+  RangeAllocatorStats indices;
+  // 0 when all free space is one block, close to 1 when it is scattered
+  float               vertex_fragmentation;
+  float               index_fragmentation;
+};
+
+// one vertex and one index buffer shared by every model, so draws of
+// different models need no rebinding. ranges are suballocated and tracked
+// by address, growing or defragmenting moves them and bumps the generation
+// so owners know that recorded draws and descriptors are stale. moving
+// waits for the queue, so it belongs in loading code, not in a frame
+class GeometryHeap {
+public:
+  ac_result
+  init(
+    ac_device device,
+    ac_queue  queue,
+    uint32_t  vertex_stride,
+    uint32_t  vertex_capacity,
+    uint32_t  index_capacity);
+
+  void
+  shutdown();
+
+  // range must stay at the same address until it is freed
+  ac_result
+  allocate(uint32_t vertex_count, uint32_t index_count, GeometryRange* range);
+
+  void
+  free(GeometryRange* range);
+
+  // packs every live range to the start of new buffers
+  ac_result
+  defragment();
+
+  ac_buffer
+  get_vertex_buffer() const;
+
+  ac_buffer
+  get_index_buffer() const;
+
+  uint32_t
+  get_generation() const;
+
+  GeometryHeapStats
+  get_stats() const;
+
+private:
+  ac_device                   m_device = NULL;
+  ac_queue                    m_queue = NULL;
+  uint32_t                    m_vertex_stride = 0;
+  ac_buffer                   m_vertices = NULL;
+  ac_buffer                   m_indices = NULL;
+  RangeAllocator              m_vertex_allocator;
+  RangeAllocator              m_index_allocator;
+  std::vector<GeometryRange*> m_ranges;
+  uint32_t                    m_generation = 0;
+
+  ac_result
+  create_buffers(
+    uint32_t   vertex_capacity,
+    uint32_t   index_capacity,
+    ac_buffer* vertices,
+    ac_buffer* indices);
+
+  // copies every live range to its moved place in the new buffers
+  ac_result
+  copy_ranges(
+    ac_buffer                         vertices,
+    ac_buffer                         indices,
+    const std::vector<GeometryRange>& moved);
+
+  ac_result
+  rebuild(uint32_t vertex_capacity, uint32_t index_capacity);
+};
@@ -1,13 +1,43 @@
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <string.h>
 #include <tinygltf/stb_image.h>
 #include <ac/ac.h>
 #include "model.hpp"
+#include "geometry_heap.hpp"
+#include "occlusion.hpp"
+#include "animation.hpp"
+#include "bvh.hpp"
+#include "culling.hpp"
 #include "pbr_maps.hpp"
+#include "render_queue.hpp"
+#include "texture_registry.hpp"
+#include "job_system.hpp"
+#include "graph_description.hpp"
+#include "task_graph.hpp"
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
+#include "pipeline_cache.hpp"
+#include "resolution_controller.hpp"
+#include "upscaler.hpp"
+#include "simulation_thread.hpp"
 
 #include "compiled/main.h"
-
-#define MAX_IMAGES 500
+#include "compiled/skinning.h"
+#include "compiled/cull.h"
+
+// size of g_textures in main.acsl, the registry may use fewer slots
+#define MAX_TEXTURES 4096
+#define DRAW_CHUNK_SIZE 256
+#define MAX_OCCLUDERS 16
+// seconds a clip change cross fades
+#define ANIMATION_FADE_TIME 0.3f
+// initial geometry heap size, it grows when a model does not fit
+#define GEOMETRY_VERTEX_CAPACITY (64 * 1024)
+#define GEOMETRY_INDEX_CAPACITY (256 * 1024)
+// index count, instance count, first index, vertex offset, first instance
+#define INDIRECT_ARGS_SIZE (5 * sizeof(uint32_t))
 #define PBR_WORKFLOW_METALLIC_ROUGHNESS 0
 #define PBR_WORKFLOW_SPECULAR_GLOSINESS 1
 
@@ -29,6 +59,10 @@ private:
   enum Token : uint64_t {
     ColorImage = 0,
     DepthImage = 1,
+    OutputImage = 2,
+    SkinnedVertices = 3,
+    IndirectArgs = 4,
+    DrawList = 5,
   };
 
   struct ShaderMaterial {
@@ -51,7 +85,9 @@ private:
   };
 
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -64,25 +100,142 @@ private:
   ac_rg       m_rg = {};
   ac_rg_graph m_graph = {};
 
+  // everything describe_frame reads apart from the swapchain, which
+  // invalidates the description itself when it is recreated. a description
+  // is replayed only while these match
+  struct GraphInputs {
+    float    render_scale;
+    bool     skinning;
+    bool     gpu_culling;
+    uint32_t vertex_count;
+    uint32_t gpu_draw_count;
+
+    bool
+    operator==(const GraphInputs& other) const
+    {
+      return render_scale == other.render_scale &&
+             skinning == other.skinning &&
+             gpu_culling == other.gpu_culling &&
+             vertex_count == other.vertex_count &&
+             gpu_draw_count == other.gpu_draw_count;
+    }
+  };
+
+  GraphDescription m_graph_description;
+  GraphInputs      m_graph_inputs = {};
+
+  // pipelines survive resizes, only a new color format compiles again
+  PipelineCache m_pipeline_cache;
+
+  // the main pass renders at a scale of the swapchain size picked from the
+  // frame times and is upscaled into the swapchain image. the graph is
+  // described again whenever the scale moves
+  ResolutionController m_resolution;
+  Upscaler             m_upscaler;
+  uint32_t             m_render_width = {};
+  uint32_t             m_render_height = {};
+
+  // cpu cost of handing the graph to the builder against the whole execute,
+  // accumulated and logged once per second
+  struct {
+    float    build_ms;
+    float    execute_ms;
+    uint32_t describes;
+    uint32_t frames;
+    float    timer;
+    // simulation step and the time the render thread waited for it
+    float    simulate_ms;
+    float    wait_ms;
+  } m_graph_stats = {};
+
   ac_dsl               m_dsl = {};
   ac_descriptor_buffer m_db = {};
 
-  struct {
+  struct Camera {
     glm::mat4 projection;
     glm::mat4 view;
     glm::mat4 model;
     glm::vec4 cam_pos;
-  } m_camera = {};
+  };
+
+  Camera m_camera = {};
 
   struct {
     ac_pipeline pbr;
     ac_pipeline pbr_double_sided;
+    // compiled on first reference, NULL until the background compile
+    // finished
     ac_pipeline pbr_alpha_blended;
+    // vertex pulling permutations of pbr and double sided for the gpu
+    // culled draws, NULL without gpu culling
+    ac_pipeline pbr_indirect;
+    ac_pipeline pbr_double_sided_indirect;
   } m_pipelines = {};
 
+  // a blended material asked for its pipeline
+  bool m_blend_referenced = false;
+
   ac_shader m_vertex_shader = {};
+  ac_shader m_indirect_vertex_shader = {};
   ac_shader m_fragment_shader = {};
 
+  // skin vertices once per frame in compute instead of in every draw pass
+  bool                 m_compute_skinning = true;
+  ac_shader            m_skinning_shader = {};
+  ac_dsl               m_skinning_dsl = {};
+  ac_descriptor_buffer m_skinning_db = {};
+  ac_pipeline          m_skinning_pipeline = {};
+  // heap generation the source vertices of every skinning set point into
+  uint32_t             m_skinning_generations[AC_MAX_FRAME_IN_FLIGHT] = {};
+
+  struct GpuDraw {
+    glm::vec4 center;
+    glm::vec4 extent;
+    uint32_t  node;
+    uint32_t  first_index;
+    uint32_t  index_count;
+    int32_t   material;
+    uint32_t  group;
+    uint32_t  pad[3];
+  };
+
+  // opaque and masked primitives of one pipeline whose index counts are
+  // within a factor of two, drawn by a single instanced indirect draw as
+  // long as the largest of them. first is where the group starts in the
+  // draw list
+  struct GpuGroup {
+    uint32_t index_count;
+    uint32_t first;
+  };
+
+  // alternate path where a compute stage culls the opaque and masked
+  // primitives against the frustum and appends the survivors of every
+  // group to a draw list. the main stage draws each group with one indirect
+  // draw whose instance count the cull stage wrote. blended primitives stay
+  // on the sorted blend stream. primitive bounds, draw data and groups are
+  // uploaded once at startup
+  bool                  m_gpu_culling = false;
+  ac_shader             m_cull_shader = {};
+  ac_dsl                m_cull_dsl = {};
+  ac_descriptor_buffer  m_cull_db = {};
+  ac_pipeline           m_cull_pipeline = {};
+  ac_buffer             m_gpu_draws = {};
+  ac_buffer             m_gpu_groups = {};
+  // 0, 1, 2 ... up to the largest group, the pulled vertex ids of the
+  // indirect draws
+  ac_buffer             m_sequence_indices = {};
+  // surviving primitives counted by the cull stage, read back once the
+  // frame that wrote them finished
+  ac_buffer             m_cull_counters[AC_MAX_FRAME_IN_FLIGHT] = {};
+  uint32_t              m_gpu_draw_count = {};
+  uint32_t              m_gpu_visible_count = {};
+  std::vector<GpuGroup> m_groups;
+  // pipeline id of every group, 0 or 1
+  std::vector<uint32_t> m_group_pipelines;
+  // cull nodes with primitives the gpu path leaves to the cpu, blended or
+  // not indexed ones
+  std::vector<uint32_t> m_cpu_nodes;
+
   PBRMaps m_maps = {};
 
   ac_buffer  m_camera_buffers[AC_MAX_FRAME_IN_FLIGHT] = {};
@@ -90,14 +243,120 @@ private:
   ac_sampler m_sampler = {};
   ac_image   m_stub_image = {};
 
+  // bindless table behind g_textures, m_texture_slots holds the slot of
+  // every texture of m_scene
+  TextureRegistry       m_textures;
+  std::vector<uint32_t> m_texture_slots;
+
   uint32_t m_animation_index = {};
   float    m_dt = {};
   float    m_animation_timer = {};
 
-  Model m_scene = {};
+  // N cross fades from the playing clip to the next one, L toggles an
+  // additive layer of the next clip masked to the last picked subtree
+  uint32_t m_fade_clip = {};
+  float    m_fade_timer = {};
+  float    m_fade = 1.0f;
+  bool     m_additive_layer = false;
+  Node*    m_picked_node = nullptr;
+  Node*    m_mask_root = nullptr;
+  int32_t  m_mask = -1;
+  float    m_stats_timer = {};
+
+  RenderQueue m_queue = {};
+  JobSystem   m_jobs;
+
+  // the sorted queue is only rebuilt when pipelines, materials or the
+  // scene change. its draws are encoded every frame on the job system, one
+  // stream per chunk, while another job sorts and encodes the blended
+  // draws, which depend on the view. a stage records into a single command
+  // buffer and ac has no secondary ones, so the streams are replayed into
+  // it in order on the stage thread
+  std::vector<CmdStream>        m_draw_streams;
+  std::vector<RenderQueueStats> m_draw_stats;
+  bool                          m_queue_valid = {};
+  CmdStream                     m_blend_stream;
+  RenderQueueStats              m_blend_stats = {};
+
+  // wall time of the encode against the time its jobs took on every
+  // thread, accumulated and logged once per second
+  struct {
+    float              wall_ms;
+    uint32_t           jobs;
+    uint32_t           frames;
+    std::vector<float> thread_ms;
+  } m_encode_stats = {};
+
+  // inputs of one simulation step, written by the render thread between
+  // waiting for the previous step and kicking the next one
+  struct SimulationInput {
+    float dt;
+    bool  gpu_culling;
+    bool  pick;
+    bool  dump_occlusion;
+    bool  next_clip;
+    bool  toggle_layer;
+  };
+
+  // everything the render thread reads of a simulated frame. the
+  // simulation of frame n + 1 writes one snapshot while frame n is
+  // recorded from the other, so neither touches the nodes of the other
+  struct FrameSnapshot {
+    Camera                          camera;
+    std::vector<Mesh::UniformBlock> node_blocks;
+    std::vector<Mesh::JointMatrix>  joint_matrices;
+    std::vector<Mesh::MorphDelta>   morph_deltas;
+    // indices into m_cull_nodes that passed culling
+    std::vector<uint32_t>           visible;
+    // world matrix and bounds of every cull node
+    std::vector<glm::mat4>          matrices;
+    std::vector<BoundingBox>        bounds;
+    bool                            gpu_culling;
+    CullStats                       cull_stats;
+    OcclusionStats                  occlusion_stats;
+  };
+
+  // animation, transforms and culling run on their own thread one frame
+  // ahead of recording and submission
+  SimulationThread m_simulation;
+  // two threads waiting on one pool would both run jobs as thread 0, so
+  // the simulation fans out on its own
+  JobSystem        m_simulation_jobs;
+  SimulationInput  m_simulation_input = {};
+  FrameSnapshot    m_snapshots[2];
+  // written by the running step, the render thread reads the other one
+  uint32_t         m_simulation_slot = 0;
+  bool             m_pick_requested = false;
+  bool             m_dump_requested = false;
+  bool             m_next_clip_requested = false;
+  bool             m_layer_requested = false;
+
+  // mesh nodes are culled every frame, the draw streams are only recorded
+  // again when the visible set differs from the one they were built for
+  Culler                m_culler;
+  std::vector<Node*>    m_cull_nodes;
+  std::vector<uint32_t> m_drawn_nodes;
+  // the streams only hold the blended draws of the gpu path
+  bool                  m_drawn_gpu_culling = false;
+
+  // the largest static meshes on screen are rasterized as occluders and
+  // the frustum visible list is tested against them
+  bool            m_occlusion_culling = true;
+  OcclusionCuller m_occlusion;
+
+  // picking and region queries, refit lazily before each pick
+  SceneBvh m_scene_bvh;
+
+  Model            m_scene = {};
+  GeometryHeap     m_geometry;
+  // heap generation the draw streams were recorded against
+  uint32_t         m_geometry_generation = {};
+  AnimationBlender m_animator = {};
 
   static void
   window_callback(const ac_window_event* event, void* ud);
+  static void
+  input_callback(const ac_input_event* event, void* ud);
 
   static ac_result
   build_frame(ac_rg_builder builder, void* ud);
@@ -105,15 +364,118 @@ private:
   stage_prepare(ac_rg_stage* stage, void* ud);
   static ac_result
   stage_cmd(ac_rg_stage* stage, void* ud);
+  static ac_result
+  skinning_stage_cmd(ac_rg_stage* stage, void* ud);
+  static ac_result
+  cull_stage_cmd(ac_rg_stage* stage, void* ud);
+
+  GraphInputs
+  get_graph_inputs() const;
+
+  void
+  describe_frame();
 
   ac_result
   create_window_dependents();
 
+  ac_result
+  create_swapchain();
+
+  // ids match the pipeline buckets: pbr, double sided and alpha blended.
+  // indirect picks the vertex pulling permutation of the gpu culled draws
+  void
+  get_pipeline_info(
+    uint32_t          pipeline_id,
+    bool              indirect,
+    ac_pipeline_info* info) const;
+
+  // only depends on the swapchain format, safe to run off the main thread
+  ac_result
+  create_pipeline(uint32_t pipeline_id, bool indirect, ac_pipeline* pipeline);
+
+  ac_result
+  create_pipelines();
+
+  // queues the permutations the scene referenced but that do not exist yet,
+  // picks them up once the background compile finished
+  void
+  request_lazy_pipelines();
+
+  void
+  log_pipeline_stats();
+
+  ac_result
+  create_shaders();
+
+  // texture registry, material buffer and the camera and node sets
+  ac_result
+  create_materials();
+
+  ac_result
+  create_environment_set();
+
   ac_result
   create_stub_images();
 
+  ac_result
+  create_skinning_pipeline();
+
+  ac_result
+  record_skinning(ac_rg_stage* stage);
+
+  ac_result
+  create_gpu_culling();
+
+  ac_result
+  record_gpu_culling(ac_rg_stage* stage);
+
+  uint32_t
+  draw_indirect(ac_rg_stage* stage);
+
+  // slot of a scene texture in the registry, -1 when there is none
+  int32_t
+  get_texture_slot(const Texture* texture) const;
+
+  // marks the permutations it hands out a stand in for
+  ac_pipeline
+  get_pipeline(
+    const Material& material,
+    uint32_t&       pipeline_id,
+    RenderPass&     pass);
+
+  // one simulation step into m_snapshots[m_simulation_slot], runs on the
+  // simulation thread
+  void
+  simulate();
+
+  const FrameSnapshot&
+  get_render_snapshot() const;
+
+  // writes the transforms of the render snapshot into the buffers of frame
   void
-  render_node(ac_rg_stage* stage, Node* node, Material::AlphaMode alpha_mode);
+  upload_snapshot(uint32_t frame);
+
+  void
+  cull_scene(const Camera& camera);
+
+  void
+  cull_occluded(const Camera& camera);
+
+  void
+  pick_center(const Camera& camera);
+
+  void
+  build_render_queue();
+
+  // encodes the draw streams and the blend stream of the frame in parallel
+  void
+  encode_streams();
+
+  void
+  record_blend_stream();
+
+  void
+  log_encode_stats();
 
 public:
   App();
@@ -133,6 +495,13 @@ App::App()
   }
   RIF(ac_init_window(App::APP_NAME));
 
+  {
+    ac_input_info info = {};
+    info.callback = App::input_callback;
+    info.callback_data = this;
+    RIF(ac_init_input(&info));
+  }
+
   {
     m_wsi.native_window = ac_window_get_native_handle();
 
@@ -164,6 +533,23 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
+  m_pipeline_cache.init(m_device);
+  {
+    ResolutionControllerInfo info = {};
+    info.vsync = m_frame_pacer.get_vsync();
+    m_resolution.init(info);
+
+#if AC_INCLUDE_DEBUG
+    if (const char* failed = ResolutionController::check())
+    {
+      AC_WARN("resolution controller check failed: %s", failed);
+    }
+#endif
+  }
+  RIF(m_upscaler.init(m_device));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -183,229 +569,200 @@ App::App()
     RIF(ac_rg_create_graph(m_rg, &info, &m_graph));
   }
 
-  RIF(compute_pbr_maps(m_device, "clouds.hdr", &m_maps));
-  RIF(create_stub_images());
-
-  m_scene.load_from_file(
-    "BrainStem.glb",
-    m_device,
-    ac_device_get_queue(m_device, ac_queue_type_graphics));
-
-  {
-    ac_shader_info info = {};
-    info.stage = ac_shader_stage_vertex;
-    info.code = main_vs[0];
-
-    RIF(ac_create_shader(m_device, &info, &m_vertex_shader));
-  }
-
-  {
-    ac_shader_info info = {};
-    info.stage = ac_shader_stage_pixel;
-    info.code = main_fs[0];
-
-    RIF(ac_create_shader(m_device, &info, &m_fragment_shader));
-  }
+  m_jobs.init();
+  m_simulation_jobs.init(std::max(2u, m_jobs.get_thread_count() / 2));
 
-  {
-    ac_shader shaders[] = {
-      m_vertex_shader,
-      m_fragment_shader,
-    };
-    ac_dsl_info info = {};
-    info.shader_count = AC_COUNTOF(shaders);
-    info.shaders = shaders;
-    RIF(ac_create_dsl(m_device, &info, &m_dsl));
-  }
+  // created here on the main thread, the pipeline task only needs its format
+  RIF(create_swapchain());
 
   {
-    ac_descriptor_buffer_info info = {};
-    info.dsl = m_dsl;
-    info.max_sets[ac_space0] = AC_MAX_FRAME_IN_FLIGHT;
-    info.max_sets[ac_space1] = 1;
-    info.max_sets[ac_space2] = 1;
-    RIF(ac_create_descriptor_buffer(m_device, &info, &m_db));
-  }
+    auto start = std::chrono::steady_clock::now();
 
-  {
-    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
-    {
-      ac_buffer_info info = {};
-      info.size = sizeof(m_camera);
-      info.usage = ac_buffer_usage_cbv_bit;
-      info.memory_usage = ac_memory_usage_cpu_to_gpu;
-      info.name = AC_DEBUG_NAME("camera buffer");
+    ac_queue graphics = ac_device_get_queue(m_device, ac_queue_type_graphics);
+    ac_queue compute = ac_device_get_queue(m_device, ac_queue_type_compute);
 
-      RIF(ac_create_buffer(m_device, &info, &m_camera_buffers[i]));
-      RIF(ac_buffer_map_memory(m_camera_buffers[i]));
-    }
-  }
+    HdrImage        hdr = {};
+    tinygltf::Model gltf_model;
 
-  {
-    ac_buffer_info info = {};
-    info.size = sizeof(ShaderMaterial) * m_scene.materials.size();
-    info.usage = ac_buffer_usage_srv_bit;
-    info.memory_usage = ac_memory_usage_cpu_to_gpu;
-    info.name = AC_DEBUG_NAME("material buffer");
+    TaskGraph graph;
 
-    RIF(ac_create_buffer(m_device, &info, &m_material_buffer));
-    RIF(ac_buffer_map_memory(m_material_buffer));
+    TaskGraph::Task hdr_decode = graph.add(
+      "hdr decode",
+      [&]() { return decode_hdr("clouds.hdr", &hdr); });
 
-    for (uint32_t i = 0; i < m_scene.materials.size(); ++i)
-    {
-      const Material* in = &m_scene.materials[i];
-      ShaderMaterial* out =
-        ((ShaderMaterial*)ac_buffer_get_mapped_memory(m_material_buffer));
+    TaskGraph::Task gltf_parse = graph.add(
+      "gltf parse",
+      [&]() { return Model::parse_file("BrainStem.glb", &gltf_model); });
 
-      out += i;
+    TaskGraph::Task shaders =
+      graph.add("shaders", [&]() { return create_shaders(); });
 
-      out->emissive_factor = in->emissive_factor;
-      out->base_color_index =
-        in->base_color_texture != nullptr ? in->tex_coord_sets.base_color : -1;
-      out->normal_index =
-        in->normal_texture != nullptr ? in->tex_coord_sets.normal : -1;
-      out->occlusion_index =
-        in->occlusion_texture != nullptr ? in->tex_coord_sets.occlusion : -1;
-      out->emissive_index =
-        in->emissive_texture != nullptr ? in->tex_coord_sets.emissive : -1;
-      out->alpha_mask =
-        static_cast<float>(in->alpha_mode == Material::ALPHAMODE_MASK);
-      out->alpha_mask_cutoff = in->alpha_cutoff;
-      out->emissive_strength = in->emissive_strength;
+    // the permutations every scene uses compile in parallel, blending is
+    // left to the first blended material
+    graph.add(
+      "pbr pipeline",
+      [&]() { return create_pipeline(0, false, &m_pipelines.pbr); },
+      {shaders});
 
-      if (in->pbr_workflows.metallic_roughness)
+    graph.add(
+      "double sided pipeline",
+      [&]()
       {
-        out->workflow = PBR_WORKFLOW_METALLIC_ROUGHNESS;
-        out->base_color_factor = in->base_color_factor;
-        out->metallic_factor = in->metallic_factor;
-        out->roughness_factor = in->roughness_factor;
-        out->metallic_roughness_index =
-          in->metallic_roughness_texture != nullptr
-            ? in->tex_coord_sets.metallic_roughness
-            : -1;
-        out->base_color_index = in->base_color_texture != nullptr
-                                  ? in->tex_coord_sets.base_color
-                                  : -1;
-      }
+        return create_pipeline(1, false, &m_pipelines.pbr_double_sided);
+      },
+      {shaders});
 
-      if (in->pbr_workflows.specular_glossiness)
+    graph.add(
+      "upscale pipeline",
+      [&]()
       {
-        out->workflow = PBR_WORKFLOW_SPECULAR_GLOSINESS;
-        out->metallic_roughness_index =
-          in->extension.specular_glossiness_texture != nullptr
-            ? in->tex_coord_sets.specular_glossiness
-            : -1;
-        out->base_color_index = in->extension.diffuse_texture != nullptr
-                                  ? in->tex_coord_sets.base_color
-                                  : -1;
-        out->diffuse_factor = in->extension.diffuse_factor;
-        out->specular_factor = glm::vec4(in->extension.specular_factor, 1.0f);
-      }
-    }
+        ac_image image = ac_swapchain_get_image(m_swapchain);
+        return m_upscaler.create_pipeline(
+          m_pipeline_cache,
+          ac_image_get_format(image));
+      });
+
+    TaskGraph::Task stub_image =
+      graph.add("stub image", [&]() { return create_stub_images(); });
+
+    // the stub image is submitted to the compute queue too, a queue is
+    // never used from two threads at once
+    TaskGraph::Task ibl = graph.add(
+      "ibl compute",
+      [&]()
+      {
+        ac_result res = compute_pbr_maps(m_device, hdr, &m_maps);
+        free_hdr(&hdr);
+        return res;
+      },
+      {hdr_decode, stub_image});
+
+    // without a dedicated compute queue the uploads wait for the ibl pass,
+    // otherwise the parse is listed twice which changes nothing
+    TaskGraph::Task queue_owner = compute == graphics ? ibl : gltf_parse;
+
+    TaskGraph::Task scene = graph.add(
+      "scene upload",
+      [&]()
+      {
+        AC_RIF(m_geometry.init(
+          m_device,
+          graphics,
+          sizeof(Model::Vertex),
+          GEOMETRY_VERTEX_CAPACITY,
+          GEOMETRY_INDEX_CAPACITY));
+
+        AC_RIF(m_scene.load(gltf_model, m_device, graphics, 1.0f, &m_geometry));
+
+        // the parsed file holds the decoded images and buffers
+        gltf_model = tinygltf::Model();
+
+        return ac_result_success;
+      },
+      {gltf_parse, queue_owner});
+
+    TaskGraph::Task materials = graph.add(
+      "materials",
+      [&]() { return create_materials(); },
+      {scene, shaders, stub_image});
+
+    graph.add(
+      "skinning pipeline",
+      [&]()
+      {
+        if (!m_compute_skinning || !m_scene.deformed)
+        {
+          return ac_result_success;
+        }
+        return create_skinning_pipeline();
+      },
+      {scene});
 
-    ac_buffer_unmap_memory(m_material_buffer);
-  }
+    // writes sets of the main descriptor buffer next to the materials
+    graph.add(
+      "gpu culling",
+      [&]() { return create_gpu_culling(); },
+      {scene, materials});
 
-  {
-    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
-    {
-      ac_descriptor camera_descriptor = {};
-      camera_descriptor.buffer = m_camera_buffers[i];
+    graph.add(
+      "environment set",
+      [&]() { return create_environment_set(); },
+      {ibl, materials});
 
-      ac_descriptor_write write = {};
-      write.type = ac_descriptor_type_cbv_buffer;
-      write.count = 1;
-      write.descriptors = &camera_descriptor;
+    ac_result res = graph.run(m_jobs);
 
-      ac_update_set(m_db, ac_space0, i, 1, &write);
+    for (const TaskTiming& timing : graph.get_timings())
+    {
+      AC_INFO(
+        "startup task %-21s start %8.3f ms took %8.3f ms on thread %u%s",
+        timing.name,
+        timing.start_ms,
+        timing.duration_ms,
+        timing.thread_index,
+        timing.failed ? " (failed)" : "");
     }
 
-    {
-      ac_descriptor d = {};
-      d.buffer = this->m_scene.matrices;
+    std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
 
-      ac_descriptor_write write = {};
-      write.type = ac_descriptor_type_srv_buffer;
-      write.count = 1;
-      write.descriptors = &d;
+    AC_INFO("startup tasks finished in %.3f ms", elapsed.count());
+    log_pipeline_stats();
 
-      ac_update_set(m_db, ac_space1, 0, 1, &write);
-    }
+    free_hdr(&hdr);
+
+    RIF(res);
   }
 
   {
-    ac_sampler_info sampler_info = {};
-    sampler_info.min_filter = ac_filter_linear;
-    sampler_info.mag_filter = ac_filter_linear;
-    sampler_info.mipmap_mode = ac_sampler_mipmap_mode_linear;
-    sampler_info.address_mode_u = ac_sampler_address_mode_repeat;
-    sampler_info.address_mode_v = ac_sampler_address_mode_repeat;
-    sampler_info.address_mode_w = ac_sampler_address_mode_repeat;
-    sampler_info.anisotropy_enable = true;
-    sampler_info.max_anisotropy = 16;
-    sampler_info.min_lod = 0;
-    sampler_info.max_lod = 1000;
-
-    RIF(ac_create_sampler(m_device, &sampler_info, &m_sampler));
-
-    ac_descriptor sampler_descriptor = {};
-    sampler_descriptor.sampler = m_sampler;
-
-    ac_descriptor buffer_descriptor = {};
-    buffer_descriptor.buffer = m_material_buffer;
+    GeometryHeapStats stats = m_geometry.get_stats();
+    AC_INFO(
+      "geometry heap: vertices %u / %u indices %u / %u fragmentation %.2f "
+      "%.2f",
+      stats.vertices.used,
+      stats.vertices.capacity,
+      stats.indices.used,
+      stats.indices.capacity,
+      stats.vertex_fragmentation,
+      stats.index_fragmentation);
+  }
 
-    ac_descriptor image_descriptors[MAX_IMAGES] = {};
-    ac_descriptor stub_descriptor = {};
-    stub_descriptor.image = m_stub_image;
-    std::fill(
-      image_descriptors,
-      image_descriptors + MAX_IMAGES,
-      stub_descriptor);
+  m_animator.init(&m_scene);
+  m_culler.min_screen_size = 0.002f;
+  m_occlusion.init(256, 144);
 
-    for (uint32_t i = 0; i < m_scene.textures.size(); ++i)
+  for (Node* node : m_scene.linear_nodes)
+  {
+    if (node->mesh)
     {
-      image_descriptors[i].image = m_scene.textures[i].image;
+      m_cull_nodes.push_back(node);
     }
+  }
+  m_culler.resize(static_cast<uint32_t>(m_cull_nodes.size()));
 
-    ac_descriptor irradiance_descriptor = {};
-    irradiance_descriptor.image = m_maps.irradiance;
-
-    ac_descriptor specular_descriptor = {};
-    specular_descriptor.image = m_maps.specular;
-
-    ac_descriptor brdf_descriptor = {};
-    brdf_descriptor.image = m_maps.brdf;
-
-    ac_descriptor_write writes[6] = {};
-    writes[0].type = ac_descriptor_type_sampler;
-    writes[0].count = 1;
-    writes[0].descriptors = &sampler_descriptor;
-
-    writes[1].type = ac_descriptor_type_srv_buffer;
-    writes[1].count = 1;
-    writes[1].descriptors = &buffer_descriptor;
-
-    writes[2].type = ac_descriptor_type_srv_image;
-    writes[2].count = 1;
-    writes[2].descriptors = &irradiance_descriptor;
-    writes[2].reg = 1;
-
-    writes[3].type = ac_descriptor_type_srv_image;
-    writes[3].count = 1;
-    writes[3].descriptors = &specular_descriptor;
-    writes[3].reg = 2;
-
-    writes[4].type = ac_descriptor_type_srv_image;
-    writes[4].count = 1;
-    writes[4].descriptors = &brdf_descriptor;
-    writes[4].reg = 3;
-
-    writes[5].type = ac_descriptor_type_srv_image;
-    writes[5].count = AC_COUNTOF(image_descriptors);
-    writes[5].descriptors = image_descriptors;
-    writes[5].reg = 4;
+  for (uint32_t i = 0; i < m_cull_nodes.size(); ++i)
+  {
+    for (Primitive* primitive : m_cull_nodes[i]->mesh->primitives)
+    {
+      if (
+        primitive->material.alpha_mode == Material::ALPHAMODE_BLEND ||
+        !primitive->has_indices || !primitive->index_count)
+      {
+        m_cpu_nodes.push_back(i);
+        break;
+      }
+    }
+  }
 
-    ac_update_set(m_db, ac_space2, 0, AC_COUNTOF(writes), writes);
+  {
+    auto start = std::chrono::steady_clock::now();
+    m_scene_bvh.build(m_scene, &m_jobs);
+    std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+    AC_INFO(
+      "scene bvh: %u triangles built in %.3f ms",
+      m_scene_bvh.get_triangle_count(),
+      elapsed.count());
   }
 
   {
@@ -426,19 +783,23 @@ App::App()
     m_camera.cam_pos = glm::vec4(eye, 0.0);
   }
 
-  RIF(create_window_dependents());
+  m_simulation.start([this]() { simulate(); });
 
   m_running = true;
 }
 
 App::~App()
 {
+  // the step reads the scene destroyed below
+  m_simulation.stop();
+
   if (m_device)
   {
     RIF(ac_queue_wait_idle(
       ac_device_get_queue(m_device, ac_queue_type_graphics)));
 
     m_scene.destroy(m_device);
+    m_geometry.shutdown();
 
     ac_destroy_image(m_maps.environment);
     ac_destroy_image(m_maps.irradiance);
@@ -454,12 +815,29 @@ App::~App()
       ac_destroy_buffer(m_camera_buffers[i]);
     }
 
+    ac_destroy_pipeline(m_skinning_pipeline);
+    ac_destroy_descriptor_buffer(m_skinning_db);
+    ac_destroy_dsl(m_skinning_dsl);
+    ac_destroy_shader(m_skinning_shader);
+
+    ac_destroy_buffer(m_gpu_draws);
+    ac_destroy_buffer(m_gpu_groups);
+    ac_destroy_buffer(m_sequence_indices);
+    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+    {
+      ac_destroy_buffer(m_cull_counters[i]);
+    }
+    ac_destroy_pipeline(m_cull_pipeline);
+    ac_destroy_descriptor_buffer(m_cull_db);
+    ac_destroy_dsl(m_cull_dsl);
+    ac_destroy_shader(m_cull_shader);
+
     ac_destroy_descriptor_buffer(m_db);
-    ac_destroy_pipeline(m_pipelines.pbr);
-    ac_destroy_pipeline(m_pipelines.pbr_alpha_blended);
-    ac_destroy_pipeline(m_pipelines.pbr_double_sided);
+    m_upscaler.shutdown();
+    m_pipeline_cache.shutdown();
     ac_destroy_dsl(m_dsl);
     ac_destroy_shader(m_vertex_shader);
+    ac_destroy_shader(m_indirect_vertex_shader);
     ac_destroy_shader(m_fragment_shader);
 
     for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
@@ -478,6 +856,7 @@ App::~App()
     m_device = NULL;
   }
 
+  ac_shutdown_input();
   ac_shutdown_window();
   ac_shutdown();
 }
@@ -492,21 +871,57 @@ App::run()
 
   uint64_t prev_time = ac_get_time(ac_time_unit_milliseconds);
 
+  // the first frame renders the rest pose simulated here
+  m_simulation_input = {};
+  m_simulation_input.gpu_culling = m_gpu_culling;
+  m_simulation.kick();
+
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     uint64_t current_time = ac_get_time(ac_time_unit_milliseconds);
     m_dt = ((float)(current_time - prev_time)) / 1000.0f;
     prev_time = current_time;
 
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      AC_INFO("swapchain recreated for %u window events", m_resize.reset());
+    }
+
+    request_lazy_pipelines();
+
+    {
+      // frame n was simulated while frame n - 1 rendered. its snapshot is
+      // read from here on while n + 1 is simulated into the other one
+      auto wait_start = std::chrono::steady_clock::now();
+      m_simulation.wait();
+      std::chrono::duration<float, std::milli> wait_elapsed =
+        std::chrono::steady_clock::now() - wait_start;
+
+      m_graph_stats.wait_ms += wait_elapsed.count();
+      m_graph_stats.simulate_ms += m_simulation.get_step_ms();
+
+      m_simulation_slot ^= 1;
+
+      m_simulation_input.dt = m_dt;
+      m_simulation_input.gpu_culling = m_gpu_culling;
+      m_simulation_input.pick = m_pick_requested;
+      m_simulation_input.dump_occlusion = m_dump_requested;
+      m_simulation_input.next_clip = m_next_clip_requested;
+      m_simulation_input.toggle_layer = m_layer_requested;
+      m_pick_requested = false;
+      m_dump_requested = false;
+      m_next_clip_requested = false;
+      m_layer_requested = false;
+
+      m_simulation.kick();
     }
 
     ac_result res;
@@ -517,19 +932,56 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    auto execute_start = std::chrono::steady_clock::now();
+
     res = ac_rg_graph_execute(m_graph);
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
-    ac_queue_present_info queue_present_info = {};
+    std::chrono::duration<float, std::milli> execute_elapsed =
+      std::chrono::steady_clock::now() - execute_start;
+    m_graph_stats.execute_ms += execute_elapsed.count();
+    m_graph_stats.frames++;
+
+    m_graph_stats.timer += m_dt;
+    if (m_graph_stats.timer >= 1.0f)
+    {
+      // execute includes the build callback
+      AC_INFO(
+        "graph build: %.3f ms execute: %.3f ms per frame, described %u times",
+        m_graph_stats.build_ms / m_graph_stats.frames,
+        m_graph_stats.execute_ms / m_graph_stats.frames,
+        m_graph_stats.describes);
+      AC_INFO(
+        "render scale: %.2f %ux%u smoothed frame: %.3f ms target: %.3f ms",
+        m_resolution.get_scale(),
+        m_render_width,
+        m_render_height,
+        m_resolution.get_smoothed_ms(),
+        m_resolution.get_target_ms());
+      AC_INFO(
+        "simulation: %.3f ms render waited: %.3f ms per frame",
+        m_graph_stats.simulate_ms / m_graph_stats.frames,
+        m_graph_stats.wait_ms / m_graph_stats.frames);
+      m_graph_stats.build_ms = 0.0f;
+      m_graph_stats.execute_ms = 0.0f;
+      m_graph_stats.simulate_ms = 0.0f;
+      m_graph_stats.wait_ms = 0.0f;
+      m_graph_stats.frames = 0;
+      m_graph_stats.timer = 0.0f;
+    }
+
+    m_frame_pacer.begin_present();
+
+    ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
     queue_present_info.swapchain = m_swapchain;
@@ -540,10 +992,16 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
+    // the present interval, execute alone also blocks on the swapchain
+    // under fifo and would follow the refresh rate
+    m_resolution.update(m_frame_pacer.get_last_frame().frame_ms);
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -558,9 +1016,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -575,8 +1038,59 @@ App::window_callback(const ac_window_event* event, void* ud)
   }
 }
 
+void
+App::input_callback(const ac_input_event* event, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+
+  switch (event->type)
+  {
+  case ac_input_event_type_mouse_button_down:
+  {
+    // the simulation thread owns the nodes, it picks in its next step
+    if (event->mouse_button == ac_mouse_button_left)
+    {
+      p->m_pick_requested = true;
+    }
+    break;
+  }
+  case ac_input_event_type_key_down:
+  {
+    if (event->key == ac_key_o)
+    {
+      p->m_dump_requested = true;
+    }
+    else if (event->key == ac_key_g && p->m_cull_pipeline)
+    {
+      p->m_gpu_culling = !p->m_gpu_culling;
+      AC_INFO("gpu culling %s", p->m_gpu_culling ? "on" : "off");
+    }
+    else if (event->key == ac_key_n)
+    {
+      p->m_next_clip_requested = true;
+    }
+    else if (event->key == ac_key_l)
+    {
+      p->m_layer_requested = true;
+    }
+    break;
+  }
+  default:
+  {
+    break;
+  }
+  }
+}
+
 ac_result
 App::create_window_dependents()
+{
+  AC_RIF(create_swapchain());
+  return create_pipelines();
+}
+
+ac_result
+App::create_swapchain()
 {
   ac_queue_wait_idle(ac_device_get_queue(m_device, ac_queue_type_graphics));
   ac_destroy_swapchain(m_swapchain);
@@ -592,330 +1106,1556 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
   AC_RIF(ac_create_swapchain(m_device, &swapchain_info, &m_swapchain));
 
-  {
-    ac_destroy_pipeline(m_pipelines.pbr);
-    ac_destroy_pipeline(m_pipelines.pbr_alpha_blended);
-    ac_destroy_pipeline(m_pipelines.pbr_double_sided);
-
-    ac_vertex_layout layout = {};
-    layout.binding_count = 1;
-    layout.bindings[0].input_rate = ac_input_rate_vertex;
-    layout.bindings[0].stride = sizeof(Model::Vertex);
-
-    layout.attribute_count = 7;
-    layout.attributes[0].format = ac_format_r32g32b32_sfloat;
-    layout.attributes[0].semantic = ac_attribute_semantic_position;
-    layout.attributes[0].offset = AC_OFFSETOF(Model::Vertex, pos);
-
-    layout.attributes[1].format = ac_format_r32g32b32_sfloat;
-    layout.attributes[1].semantic = ac_attribute_semantic_normal;
-    layout.attributes[1].offset = AC_OFFSETOF(Model::Vertex, normal);
+  // a new swapchain may change the size and format of the graph images
+  m_graph_description.invalidate();
 
-    layout.attributes[2].format = ac_format_r32g32_sfloat;
-    layout.attributes[2].semantic = ac_attribute_semantic_texcoord0;
-    layout.attributes[2].offset = AC_OFFSETOF(Model::Vertex, uv0);
-
-    layout.attributes[3].format = ac_format_r32g32_sfloat;
-    layout.attributes[3].semantic = ac_attribute_semantic_texcoord1;
-    layout.attributes[3].offset = AC_OFFSETOF(Model::Vertex, uv1);
-
-    layout.attributes[4].format = ac_format_r32g32b32a32_sfloat;
-    layout.attributes[4].semantic = ac_attribute_semantic_texcoord2;
-    layout.attributes[4].offset = AC_OFFSETOF(Model::Vertex, joint0);
-
-    layout.attributes[5].format = ac_format_r32g32b32a32_sfloat;
-    layout.attributes[5].semantic = ac_attribute_semantic_texcoord3;
-    layout.attributes[5].offset = AC_OFFSETOF(Model::Vertex, weight0);
+  return ac_result_success;
+}
 
-    layout.attributes[6].format = ac_format_r32g32b32a32_sfloat;
-    layout.attributes[6].semantic = ac_attribute_semantic_color;
-    layout.attributes[6].offset = AC_OFFSETOF(Model::Vertex, color);
+void
+App::get_pipeline_info(
+  uint32_t          pipeline_id,
+  bool              indirect,
+  ac_pipeline_info* info) const
+{
+  // the cache hashes the info bytewise, so it is zeroed as a whole and
+  // written in place, struct copies may leave their padding undefined
+  memset(info, 0, sizeof(*info));
+  info->type = ac_pipeline_type_graphics;
+
+  ac_vertex_layout* layout = &info->graphics.vertex_layout;
+  layout->binding_count = 1;
+  layout->bindings[0].input_rate = ac_input_rate_vertex;
+  layout->bindings[0].stride = sizeof(Model::Vertex);
+
+  layout->attribute_count = 7;
+  layout->attributes[0].format = ac_format_r32g32b32_sfloat;
+  layout->attributes[0].semantic = ac_attribute_semantic_position;
+  layout->attributes[0].offset = AC_OFFSETOF(Model::Vertex, pos);
+
+  layout->attributes[1].format = ac_format_r32g32b32_sfloat;
+  layout->attributes[1].semantic = ac_attribute_semantic_normal;
+  layout->attributes[1].offset = AC_OFFSETOF(Model::Vertex, normal);
+
+  layout->attributes[2].format = ac_format_r32g32_sfloat;
+  layout->attributes[2].semantic = ac_attribute_semantic_texcoord0;
+  layout->attributes[2].offset = AC_OFFSETOF(Model::Vertex, uv0);
+
+  layout->attributes[3].format = ac_format_r32g32_sfloat;
+  layout->attributes[3].semantic = ac_attribute_semantic_texcoord1;
+  layout->attributes[3].offset = AC_OFFSETOF(Model::Vertex, uv1);
+
+  layout->attributes[4].format = ac_format_r32g32b32a32_sfloat;
+  layout->attributes[4].semantic = ac_attribute_semantic_texcoord2;
+  layout->attributes[4].offset = AC_OFFSETOF(Model::Vertex, joint0);
+
+  layout->attributes[5].format = ac_format_r32g32b32a32_sfloat;
+  layout->attributes[5].semantic = ac_attribute_semantic_texcoord3;
+  layout->attributes[5].offset = AC_OFFSETOF(Model::Vertex, weight0);
+
+  layout->attributes[6].format = ac_format_r32g32b32a32_sfloat;
+  layout->attributes[6].semantic = ac_attribute_semantic_color;
+  layout->attributes[6].offset = AC_OFFSETOF(Model::Vertex, color);
+
+  ac_depth_state_info* depth = &info->graphics.depth_state_info;
+  depth->depth_write = true;
+  depth->depth_test = true;
+  depth->compare_op = ac_compare_op_less;
+
+  ac_rasterizer_state_info* rasterizer = &info->graphics.rasterizer_info;
+  rasterizer->polygon_mode = ac_polygon_mode_fill;
+  rasterizer->cull_mode = ac_cull_mode_back;
+  rasterizer->front_face = ac_front_face_counter_clockwise;
+
+  ac_image image = ac_swapchain_get_image(m_swapchain);
+
+  info->graphics.topology = ac_primitive_topology_triangle_list;
+  info->graphics.vertex_shader = m_vertex_shader;
+  info->graphics.pixel_shader = m_fragment_shader;
+  info->graphics.dsl = m_dsl;
+  info->graphics.samples = 1;
+  info->graphics.color_attachment_count = 1;
+  info->graphics.color_attachment_formats[0] = ac_image_get_format(image);
+  info->graphics.depth_stencil_format = ac_format_d32_sfloat;
+  info->name = AC_DEBUG_NAME("pbr");
+
+  // vertices are pulled from buffers, the input assembler only feeds the
+  // sequence index buffer
+  if (indirect)
+  {
+    memset(layout, 0, sizeof(*layout));
+    info->graphics.vertex_shader = m_indirect_vertex_shader;
+    info->name = AC_DEBUG_NAME("pbr_indirect");
+  }
 
-    ac_depth_state_info depth = {};
-    depth.depth_write = true;
-    depth.depth_test = true;
-    depth.compare_op = ac_compare_op_less;
+  if (pipeline_id == 0)
+  {
+    return;
+  }
 
-    ac_rasterizer_state_info rasterizer = {};
-    rasterizer.polygon_mode = ac_polygon_mode_fill;
-    rasterizer.cull_mode = ac_cull_mode_back;
-    rasterizer.front_face = ac_front_face_counter_clockwise;
+  info->name = indirect ? AC_DEBUG_NAME("pbr_double_sided_indirect")
+                        : AC_DEBUG_NAME("pbr_double_sided");
+  info->graphics.rasterizer_info.cull_mode = ac_cull_mode_none;
 
-    ac_image image = ac_swapchain_get_image(m_swapchain);
+  if (pipeline_id == 1)
+  {
+    return;
+  }
 
-    ac_pipeline_info info = {};
-    info.type = ac_pipeline_type_graphics;
-    info.graphics.vertex_layout = layout;
-    info.graphics.depth_state_info = depth;
-    info.graphics.rasterizer_info = rasterizer;
-    info.graphics.topology = ac_primitive_topology_triangle_list;
-    info.graphics.vertex_shader = m_vertex_shader;
-    info.graphics.pixel_shader = m_fragment_shader;
-    info.graphics.dsl = m_dsl;
-    info.graphics.samples = 1;
-    info.graphics.color_attachment_count = 1;
-    info.graphics.color_attachment_formats[0] = ac_image_get_format(image);
-    info.graphics.depth_stencil_format = ac_format_d32_sfloat;
-    info.name = AC_DEBUG_NAME("pbr");
+  info->name = AC_DEBUG_NAME("pbr_alpha_blended");
 
-    AC_RIF(ac_create_pipeline(m_device, &info, &m_pipelines.pbr));
+  ac_blend_attachment_state* att =
+    &info->graphics.blend_state_info.attachment_states[0];
 
-    info.name = AC_DEBUG_NAME("pbr_double_sided");
-    rasterizer.cull_mode = ac_cull_mode_none;
+  att->src_factor = ac_blend_factor_src_alpha;
+  att->dst_factor = ac_blend_factor_one_minus_src_alpha;
+  att->op = ac_blend_op_add;
+  att->src_alpha_factor = ac_blend_factor_one_minus_src_alpha;
+  att->dst_alpha_factor = ac_blend_factor_zero;
+  att->alpha_op = ac_blend_op_add;
+}
 
-    AC_RIF(ac_create_pipeline(m_device, &info, &m_pipelines.pbr_double_sided));
+ac_result
+App::create_pipeline(uint32_t pipeline_id, bool indirect, ac_pipeline* pipeline)
+{
+  ac_pipeline_info info;
+  get_pipeline_info(pipeline_id, indirect, &info);
 
-    info.name = AC_DEBUG_NAME("pbr_alpha_blended");
-    rasterizer.cull_mode = ac_cull_mode_none;
+  return m_pipeline_cache.get(info, pipeline);
+}
 
-    ac_blend_attachment_state* att =
-      &info.graphics.blend_state_info.attachment_states[0];
+ac_result
+App::create_pipelines()
+{
+  auto previous = m_pipelines;
 
-    att->src_factor = ac_blend_factor_src_alpha;
-    att->dst_factor = ac_blend_factor_one_minus_src_alpha;
-    att->op = ac_blend_op_add;
-    att->src_alpha_factor = ac_blend_factor_one_minus_src_alpha;
-    att->dst_alpha_factor = ac_blend_factor_zero;
-    att->alpha_op = ac_blend_op_add;
+  AC_RIF(create_pipeline(0, false, &m_pipelines.pbr));
+  AC_RIF(create_pipeline(1, false, &m_pipelines.pbr_double_sided));
 
-    AC_RIF(ac_create_pipeline(m_device, &info, &m_pipelines.pbr_alpha_blended));
+  if (m_cull_pipeline)
+  {
+    AC_RIF(create_pipeline(0, true, &m_pipelines.pbr_indirect));
+    AC_RIF(create_pipeline(1, true, &m_pipelines.pbr_double_sided_indirect));
   }
 
-  return ac_result_success;
-}
-
-ac_result
-App::stage_prepare(ac_rg_stage* stage, void* ud)
-{
-  App* p = static_cast<App*>(ud);
+  ac_image image = ac_swapchain_get_image(m_swapchain);
+  AC_RIF(
+    m_upscaler.create_pipeline(m_pipeline_cache, ac_image_get_format(image)));
 
-  memcpy(
-    ac_buffer_get_mapped_memory(p->m_camera_buffers[stage->frame]),
-    &p->m_camera,
-    sizeof(p->m_camera));
+  // blending is compiled again in the background if the format changed,
+  // the stand in covers the frames until then
+  m_pipelines.pbr_alpha_blended = NULL;
+  request_lazy_pipelines();
 
-  if ((p->m_scene.animations.size() > 0))
+  // the queue references the pipelines
+  if (
+    previous.pbr != m_pipelines.pbr ||
+    previous.pbr_double_sided != m_pipelines.pbr_double_sided ||
+    previous.pbr_alpha_blended != m_pipelines.pbr_alpha_blended)
   {
-    p->m_animation_timer += p->m_dt;
-    if (p->m_animation_timer > p->m_scene.animations[p->m_animation_index].end)
-    {
-      p->m_animation_timer -= p->m_scene.animations[p->m_animation_index].end;
-    }
-    p->m_scene.update_animation(p->m_animation_index, p->m_animation_timer);
+    m_queue_valid = false;
   }
 
+  log_pipeline_stats();
+
   return ac_result_success;
 }
 
 void
-App::render_node(ac_rg_stage* stage, Node* node, Material::AlphaMode alpha_mode)
+App::request_lazy_pipelines()
 {
-  if (node->mesh)
+  if (m_pipelines.pbr_alpha_blended || !m_blend_referenced)
   {
-    auto& pipelines = m_pipelines;
-    for (Primitive* primitive : node->mesh->primitives)
-    {
-      if (primitive->material.alpha_mode == alpha_mode)
-      {
-        ac_pipeline pipeline = NULL;
-        switch (alpha_mode)
-        {
-        case Material::ALPHAMODE_OPAQUE:
-        case Material::ALPHAMODE_MASK:
-        {
-          pipeline = primitive->material.double_sided
-                       ? pipelines.pbr_double_sided
-                       : pipelines.pbr;
-          break;
-        }
-        case Material::ALPHAMODE_BLEND:
-        {
-          pipeline = pipelines.pbr_alpha_blended;
-          break;
-        }
-        }
-
-        struct PushData {
-          int material;
-          int node;
-        };
-
-        PushData push_data = {};
-        push_data.material = primitive->material.index;
-        push_data.node = node->mesh->node;
-
-        ac_cmd_bind_pipeline(stage->cmd, pipeline);
-        ac_cmd_bind_set(stage->cmd, m_db, ac_space0, stage->frame);
-        ac_cmd_bind_set(stage->cmd, m_db, ac_space1, 0);
-        ac_cmd_bind_set(stage->cmd, m_db, ac_space2, 0);
+    return;
+  }
 
-        ac_cmd_push_constants(stage->cmd, sizeof(push_data), &push_data);
+  ac_pipeline_info info;
+  get_pipeline_info(2, false, &info);
 
-        if (primitive->has_indices)
-        {
-          ac_cmd_draw_indexed(
-            stage->cmd,
-            primitive->index_count,
-            1,
-            primitive->first_index,
-            0,
-            0);
-        }
-        else
-        {
-          ac_cmd_draw(stage->cmd, primitive->vertex_count, 1, 0, 0);
-        }
-      }
-    }
-  };
+  m_pipelines.pbr_alpha_blended = m_pipeline_cache.request(info);
 
-  for (auto child : node->children)
+  if (m_pipelines.pbr_alpha_blended)
   {
-    render_node(stage, child, alpha_mode);
+    // the queue holds the stand in
+    m_queue_valid = false;
+    log_pipeline_stats();
   }
 }
 
-ac_result
-App::stage_cmd(ac_rg_stage* stage, void* ud)
+void
+App::log_pipeline_stats()
 {
-  App* p = static_cast<App*>(ud);
-
-  ac_cmd   cmd = stage->cmd;
-  ac_image image = ac_swapchain_get_image(p->m_swapchain);
-  uint32_t width = ac_image_get_width(image);
-  uint32_t height = ac_image_get_height(image);
+  PipelineCacheStats stats = m_pipeline_cache.get_stats();
+  AC_INFO(
+    "pipelines created: %u reused: %u in background: %u compile time: "
+    "%.3f ms",
+    stats.misses,
+    stats.hits,
+    stats.background,
+    stats.create_ms);
+}
 
-  ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
-  ac_cmd_set_scissor(cmd, 0, 0, width, height);
+ac_result
+App::create_shaders()
+{
+  {
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_vertex;
+    info.code = main_vs[0];
 
-  Model& model = p->m_scene;
+    AC_RIF(ac_create_shader(m_device, &info, &m_vertex_shader));
 
-  ac_cmd_bind_pipeline(stage->cmd, p->m_pipelines.pbr);
-  ac_cmd_bind_vertex_buffer(stage->cmd, 0, model.vertices, 0);
+    info.code = main_vs[1];
 
-  if (model.indices)
-  {
-    ac_cmd_bind_index_buffer(stage->cmd, model.indices, 0, ac_index_type_u32);
+    AC_RIF(ac_create_shader(m_device, &info, &m_indirect_vertex_shader));
   }
 
-  for (auto node : model.nodes)
   {
-    p->render_node(stage, node, Material::ALPHAMODE_OPAQUE);
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_pixel;
+    info.code = main_fs[0];
+
+    AC_RIF(ac_create_shader(m_device, &info, &m_fragment_shader));
   }
 
-  for (auto node : model.nodes)
+  // both vertex permutations share the layout, the indirect one adds its
+  // buffers to space1
   {
-    p->render_node(stage, node, Material::ALPHAMODE_MASK);
+    ac_shader shaders[] = {
+      m_vertex_shader,
+      m_indirect_vertex_shader,
+      m_fragment_shader,
+    };
+    ac_dsl_info info = {};
+    info.shader_count = AC_COUNTOF(shaders);
+    info.shaders = shaders;
+    AC_RIF(ac_create_dsl(m_device, &info, &m_dsl));
   }
 
-  for (auto node : model.nodes)
   {
-    p->render_node(stage, node, Material::ALPHAMODE_BLEND);
+    ac_descriptor_buffer_info info = {};
+    info.dsl = m_dsl;
+    info.max_sets[ac_space0] = AC_MAX_FRAME_IN_FLIGHT;
+    // sets [AC_MAX_FRAME_IN_FLIGHT, 2 * AC_MAX_FRAME_IN_FLIGHT) belong to
+    // the indirect draws, they also point at transient graph buffers that
+    // the cpu path never binds
+    info.max_sets[ac_space1] = 2 * AC_MAX_FRAME_IN_FLIGHT;
+    info.max_sets[ac_space2] = 1;
+    AC_RIF(ac_create_descriptor_buffer(m_device, &info, &m_db));
   }
 
   return ac_result_success;
 }
 
 ac_result
-App::build_frame(ac_rg_builder builder, void* ud)
+App::create_materials()
 {
-  App* p = static_cast<App*>(ud);
+  m_textures.init(m_db, ac_space2, 0, 4, MAX_TEXTURES, m_stub_image);
+  for (const Texture& texture : m_scene.textures)
+  {
+    uint32_t slot = m_textures.add(texture.image);
+    if (slot == TextureRegistry::INVALID_SLOT)
+    {
+      AC_WARN("texture registry is full, falling back to the stub image");
+    }
+    m_texture_slots.push_back(slot);
+  }
+  AC_INFO(
+    "texture registry: %u / %u slots",
+    m_textures.get_count(),
+    m_textures.get_capacity());
 
-  ac_image      image = ac_swapchain_get_image(p->m_swapchain);
-  ac_image_info color = ac_image_get_info(image);
-  color.clear_value = {{{0.537, 0.412, 0.471, 1.0}}};
-  ac_image_info depth = ac_image_get_info(image);
-  depth.format = ac_format_d32_sfloat;
-  depth.clear_value = {{{1.0f, 0}}};
+  {
+    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+    {
+      ac_buffer_info info = {};
+      info.size = sizeof(m_camera);
+      info.usage = ac_buffer_usage_cbv_bit;
+      info.memory_usage = ac_memory_usage_cpu_to_gpu;
+      info.name = AC_DEBUG_NAME("camera buffer");
 
-  ac_rg_builder_stage_info stage_info {};
-  stage_info.name = AC_DEBUG_NAME("main stage");
-  stage_info.queue = ac_queue_type_graphics;
-  stage_info.commands = ac_queue_type_graphics;
-  stage_info.cb_prepare = App::stage_prepare;
-  stage_info.cb_cmd = App::stage_cmd;
-  stage_info.user_data = p;
+      AC_RIF(ac_create_buffer(m_device, &info, &m_camera_buffers[i]));
+      AC_RIF(ac_buffer_map_memory(m_camera_buffers[i]));
+    }
+  }
 
-  ac_rg_builder_stage stage = ac_rg_builder_create_stage(builder, &stage_info);
+  {
+    ac_buffer_info info = {};
+    info.size = sizeof(ShaderMaterial) * m_scene.materials.size();
+    info.usage = ac_buffer_usage_srv_bit;
+    info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    info.name = AC_DEBUG_NAME("material buffer");
 
-  ac_rg_builder_create_resource_info resource_info = {};
-  resource_info.image_info = &color;
-  resource_info.do_clear = true;
+    AC_RIF(ac_create_buffer(m_device, &info, &m_material_buffer));
+    AC_RIF(ac_buffer_map_memory(m_material_buffer));
 
-  ac_rg_builder_resource color_image =
-    ac_rg_builder_create_resource(builder, &resource_info);
+    for (uint32_t i = 0; i < m_scene.materials.size(); ++i)
+    {
+      const Material* in = &m_scene.materials[i];
+      ShaderMaterial* out =
+        ((ShaderMaterial*)ac_buffer_get_mapped_memory(m_material_buffer));
 
-  resource_info.image_info = &depth;
-  resource_info.do_clear = true;
+      out += i;
 
-  ac_rg_builder_resource depth_image =
-    ac_rg_builder_create_resource(builder, &resource_info);
+      out->emissive_factor = in->emissive_factor;
+      out->base_color_index = get_texture_slot(in->base_color_texture);
+      out->normal_index = get_texture_slot(in->normal_texture);
+      out->occlusion_index = get_texture_slot(in->occlusion_texture);
+      out->emissive_index = get_texture_slot(in->emissive_texture);
+      out->alpha_mask =
+        static_cast<float>(in->alpha_mode == Material::ALPHAMODE_MASK);
+      out->alpha_mask_cutoff = in->alpha_cutoff;
+      out->emissive_strength = in->emissive_strength;
 
-  ac_rg_builder_stage_use_resource_info use_info;
+      if (in->pbr_workflows.metallic_roughness)
+      {
+        out->workflow = PBR_WORKFLOW_METALLIC_ROUGHNESS;
+        out->base_color_factor = in->base_color_factor;
+        out->metallic_factor = in->metallic_factor;
+        out->roughness_factor = in->roughness_factor;
+        out->metallic_roughness_index =
+          get_texture_slot(in->metallic_roughness_texture);
+        out->base_color_index = get_texture_slot(in->base_color_texture);
+      }
 
-  use_info = {};
-  use_info.resource = color_image;
-  use_info.token = App::Token::ColorImage;
-  use_info.access_attachment = ac_rg_attachment_access_write_bit;
-  use_info.usage_bits = ac_image_usage_attachment_bit;
+      if (in->pbr_workflows.specular_glossiness)
+      {
+        out->workflow = PBR_WORKFLOW_SPECULAR_GLOSINESS;
+        out->metallic_roughness_index =
+          get_texture_slot(in->extension.specular_glossiness_texture);
+        out->base_color_index =
+          get_texture_slot(in->extension.diffuse_texture);
+        out->diffuse_factor = in->extension.diffuse_factor;
+        out->specular_factor = glm::vec4(in->extension.specular_factor, 1.0f);
+      }
+    }
 
-  color_image = ac_rg_builder_stage_use_resource(builder, stage, &use_info);
+    ac_buffer_unmap_memory(m_material_buffer);
+  }
 
-  use_info = {};
-  use_info.resource = depth_image;
-  use_info.token = App::Token::DepthImage;
-  use_info.access_attachment = ac_rg_attachment_access_write_bit;
-  use_info.usage_bits = ac_image_usage_attachment_bit;
+  {
+    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+    {
+      ac_descriptor camera_descriptor = {};
+      camera_descriptor.buffer = m_camera_buffers[i];
+
+      ac_descriptor_write write = {};
+      write.type = ac_descriptor_type_cbv_buffer;
+      write.count = 1;
+      write.descriptors = &camera_descriptor;
+
+      ac_update_set(m_db, ac_space0, i, 1, &write);
+    }
+
+    for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+    {
+      ac_descriptor nodes_descriptor = {};
+      nodes_descriptor.buffer = m_scene.matrices[i];
 
-  ac_rg_builder_stage_use_resource(builder, stage, &use_info);
+      ac_descriptor joints_descriptor = {};
+      joints_descriptor.buffer = m_scene.joints[i];
 
-  ac_rg_resource_connection connection = {};
-  connection.image = ac_swapchain_get_image(p->m_swapchain);
-  connection.image_layout = ac_image_layout_present_src;
-  connection.wait.fence = p->m_acquire_finished_fences[p->m_frame_index];
-  connection.signal.fence = p->m_render_finished_fences[p->m_frame_index];
+      ac_descriptor morphs_descriptor = {};
+      morphs_descriptor.buffer = m_scene.morphs[i];
 
-  ac_rg_builder_export_resource_info export_info = {};
-  export_info.resource = color_image;
-  export_info.connection = &connection;
+      ac_descriptor_write writes[3] = {};
+      writes[0].type = ac_descriptor_type_srv_buffer;
+      writes[0].count = 1;
+      writes[0].descriptors = &nodes_descriptor;
 
-  ac_rg_builder_export_resource(builder, &export_info);
+      writes[1].type = ac_descriptor_type_srv_buffer;
+      writes[1].count = 1;
+      writes[1].descriptors = &joints_descriptor;
+      writes[1].reg = 1;
+
+      writes[2].type = ac_descriptor_type_srv_buffer;
+      writes[2].count = 1;
+      writes[2].descriptors = &morphs_descriptor;
+      writes[2].reg = 2;
+
+      ac_update_set(m_db, ac_space1, i, AC_COUNTOF(writes), writes);
+    }
+  }
 
   return ac_result_success;
 }
 
 ac_result
-App::create_stub_images()
+App::create_environment_set()
 {
-  ac_image_info info = {};
-  info.format = ac_format_r8g8b8a8_unorm;
-  info.width = 1;
-  info.height = 1;
-  info.type = ac_image_type_2d;
-  info.layers = 1;
-  info.levels = 1;
-  info.samples = 1;
-  info.usage = ac_image_usage_srv_bit;
-  info.name = AC_DEBUG_NAME("stub_image");
+  {
+    ac_sampler_info sampler_info = {};
+    sampler_info.min_filter = ac_filter_linear;
+    sampler_info.mag_filter = ac_filter_linear;
+    sampler_info.mipmap_mode = ac_sampler_mipmap_mode_linear;
+    sampler_info.address_mode_u = ac_sampler_address_mode_repeat;
+    sampler_info.address_mode_v = ac_sampler_address_mode_repeat;
+    sampler_info.address_mode_w = ac_sampler_address_mode_repeat;
+    sampler_info.anisotropy_enable = true;
+    sampler_info.max_anisotropy = 16;
+    sampler_info.min_lod = 0;
+    sampler_info.max_lod = 1000;
 
-  AC_RIF(ac_create_image(m_device, &info, &m_stub_image));
+    AC_RIF(ac_create_sampler(m_device, &sampler_info, &m_sampler));
 
-  ac_queue queue = ac_device_get_queue(m_device, ac_queue_type_compute);
+    ac_descriptor sampler_descriptor = {};
+    sampler_descriptor.sampler = m_sampler;
 
-  ac_cmd_pool_info pool_info = {};
-  pool_info.queue = queue;
+    ac_descriptor buffer_descriptor = {};
+    buffer_descriptor.buffer = m_material_buffer;
 
-  ac_cmd_pool pool;
-  AC_RIF(ac_create_cmd_pool(m_device, &pool_info, &pool));
+    ac_descriptor irradiance_descriptor = {};
+    irradiance_descriptor.image = m_maps.irradiance;
 
-  ac_cmd cmd;
+    ac_descriptor specular_descriptor = {};
+    specular_descriptor.image = m_maps.specular;
+
+    ac_descriptor brdf_descriptor = {};
+    brdf_descriptor.image = m_maps.brdf;
+
+    ac_descriptor_write writes[5] = {};
+    writes[0].type = ac_descriptor_type_sampler;
+    writes[0].count = 1;
+    writes[0].descriptors = &sampler_descriptor;
+
+    writes[1].type = ac_descriptor_type_srv_buffer;
+    writes[1].count = 1;
+    writes[1].descriptors = &buffer_descriptor;
+
+    writes[2].type = ac_descriptor_type_srv_image;
+    writes[2].count = 1;
+    writes[2].descriptors = &irradiance_descriptor;
+    writes[2].reg = 1;
+
+    writes[3].type = ac_descriptor_type_srv_image;
+    writes[3].count = 1;
+    writes[3].descriptors = &specular_descriptor;
+    writes[3].reg = 2;
+
+    writes[4].type = ac_descriptor_type_srv_image;
+    writes[4].count = 1;
+    writes[4].descriptors = &brdf_descriptor;
+    writes[4].reg = 3;
+
+    ac_update_set(m_db, ac_space2, 0, AC_COUNTOF(writes), writes);
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+App::stage_prepare(ac_rg_stage* stage, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+
+  const FrameSnapshot& snapshot = p->get_render_snapshot();
+
+  memcpy(
+    ac_buffer_get_mapped_memory(p->m_camera_buffers[stage->frame]),
+    &snapshot.camera,
+    sizeof(snapshot.camera));
+
+  p->upload_snapshot(stage->frame);
+  p->m_textures.update();
+
+  return ac_result_success;
+}
+
+void
+App::simulate()
+{
+  const SimulationInput& input = m_simulation_input;
+  FrameSnapshot&         snapshot = m_snapshots[m_simulation_slot];
+
+  if ((m_scene.animations.size() > 0))
+  {
+    uint32_t clip_count = static_cast<uint32_t>(m_scene.animations.size());
+    uint32_t next_clip = (m_animation_index + 1) % clip_count;
+
+    if (input.next_clip && clip_count > 1)
+    {
+      m_fade_clip = m_animation_index;
+      m_fade_timer = m_animation_timer;
+      m_fade = 0.0f;
+      m_animation_index = next_clip;
+      m_animation_timer = 0.0f;
+      next_clip = (m_animation_index + 1) % clip_count;
+      AC_INFO("animation: fading to clip %u", m_animation_index);
+    }
+
+    if (input.toggle_layer)
+    {
+      m_additive_layer = !m_additive_layer;
+
+      // masks are created once per root, the blender keeps them all
+      Node* root = m_picked_node;
+      if (m_additive_layer && root && root != m_mask_root)
+      {
+        m_mask = m_animator.create_mask(root);
+        m_mask_root = root;
+      }
+      else if (!root)
+      {
+        m_mask = -1;
+        m_mask_root = nullptr;
+      }
+
+      AC_INFO(
+        "animation: additive layer %s on %s",
+        m_additive_layer ? "on" : "off",
+        m_mask_root ? m_mask_root->name.c_str() : "every node");
+    }
+
+    auto advance = [&](uint32_t clip, float& timer)
+    {
+      timer += input.dt;
+      if (timer > m_scene.animations[clip].end)
+      {
+        timer -= m_scene.animations[clip].end;
+      }
+    };
+
+    advance(m_animation_index, m_animation_timer);
+
+    AnimationLayer layers[3] = {};
+    uint32_t       layer_count = 0;
+
+    // the outgoing clip stays underneath while the new one blends in
+    if (m_fade < 1.0f)
+    {
+      advance(m_fade_clip, m_fade_timer);
+      m_fade = std::min(1.0f, m_fade + input.dt / ANIMATION_FADE_TIME);
+
+      layers[layer_count].clip = m_fade_clip;
+      layers[layer_count].time = m_fade_timer;
+      layers[layer_count].weight = 1.0f;
+      layer_count++;
+    }
+
+    layers[layer_count].clip = m_animation_index;
+    layers[layer_count].time = m_animation_timer;
+    layers[layer_count].weight = m_fade;
+    layer_count++;
+
+    if (m_additive_layer)
+    {
+      layers[layer_count].clip = next_clip;
+      layers[layer_count].time = m_animation_timer;
+      layers[layer_count].weight = 1.0f;
+      layers[layer_count].additive = true;
+      layers[layer_count].mask = m_mask;
+      layer_count++;
+    }
+
+    m_animator.evaluate(layers, layer_count);
+  }
+
+  snapshot.camera = m_camera;
+  snapshot.node_blocks = m_scene.node_blocks;
+  snapshot.joint_matrices = m_scene.joint_matrices;
+  snapshot.morph_deltas = m_scene.morph_deltas;
+  snapshot.gpu_culling = input.gpu_culling;
+
+  snapshot.matrices.resize(m_cull_nodes.size());
+  snapshot.bounds.resize(m_cull_nodes.size());
+  for (uint32_t i = 0; i < m_cull_nodes.size(); ++i)
+  {
+    snapshot.matrices[i] = m_cull_nodes[i]->get_matrix();
+    snapshot.bounds[i] = m_cull_nodes[i]->mesh->aabb;
+  }
+
+  // the gpu path culls opaque and masked primitives in compute from the
+  // uploaded matrices. blended ones are sorted on the cpu, the few nodes
+  // holding them are drawn without culling
+  snapshot.visible.clear();
+  if (input.gpu_culling)
+  {
+    snapshot.visible = m_cpu_nodes;
+  }
+  else
+  {
+    cull_scene(snapshot.camera);
+    snapshot.visible = m_culler.visible;
+    snapshot.cull_stats = m_culler.stats;
+    snapshot.occlusion_stats = m_occlusion.stats;
+  }
+
+  if (input.pick)
+  {
+    pick_center(snapshot.camera);
+  }
+
+  if (input.dump_occlusion)
+  {
+    const char* path = "occlusion_depth.pgm";
+    if (m_occlusion.dump_depth(path))
+    {
+      AC_INFO("occlusion depth written to %s", path);
+    }
+    else
+    {
+      AC_WARN("failed to write occlusion depth to %s", path);
+    }
+  }
+}
+
+const App::FrameSnapshot&
+App::get_render_snapshot() const
+{
+  return m_snapshots[m_simulation_slot ^ 1];
+}
+
+void
+App::upload_snapshot(uint32_t frame)
+{
+  const FrameSnapshot& snapshot = get_render_snapshot();
+
+  if (!snapshot.node_blocks.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(m_scene.matrices[frame]),
+      snapshot.node_blocks.data(),
+      snapshot.node_blocks.size() * sizeof(Mesh::UniformBlock));
+  }
+
+  if (!snapshot.joint_matrices.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(m_scene.joints[frame]),
+      snapshot.joint_matrices.data(),
+      snapshot.joint_matrices.size() * sizeof(Mesh::JointMatrix));
+  }
+
+  if (!snapshot.morph_deltas.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(m_scene.morphs[frame]),
+      snapshot.morph_deltas.data(),
+      snapshot.morph_deltas.size() * sizeof(Mesh::MorphDelta));
+  }
+}
+
+void
+App::cull_scene(const Camera& camera)
+{
+  for (uint32_t i = 0; i < m_cull_nodes.size(); ++i)
+  {
+    m_culler.set(i, m_cull_nodes[i]->mesh->aabb.get_aabb(camera.model));
+  }
+
+  m_culler.cull(camera.view, camera.projection, &m_simulation_jobs);
+
+  if (m_occlusion_culling)
+  {
+    cull_occluded(camera);
+  }
+}
+
+// masked and blended surfaces let geometry behind them show through, they
+// must never write occluder depth
+static bool
+is_opaque_occluder(const Primitive* primitive)
+{
+  return primitive->has_indices &&
+         primitive->material.alpha_mode == Material::ALPHAMODE_OPAQUE;
+}
+
+static bool
+has_opaque_occluder(const Mesh* mesh)
+{
+  return std::any_of(
+    mesh->primitives.begin(),
+    mesh->primitives.end(),
+    is_opaque_occluder);
+}
+
+void
+App::cull_occluded(const Camera& camera)
+{
+  glm::mat4 view = camera.view * camera.model;
+
+  struct Candidate {
+    float    size;
+    uint32_t index;
+  };
+
+  // deformed meshes would occlude with their rest pose, so only static
+  // meshes with opaque geometry are candidates, ranked by projected size
+  std::vector<Candidate> candidates;
+  for (uint32_t index : m_culler.visible)
+  {
+    Mesh* mesh = m_cull_nodes[index]->mesh;
+    if (
+      mesh->joint_offset >= 0 || mesh->morph_offset >= 0 ||
+      !mesh->aabb.valid || !has_opaque_occluder(mesh))
+    {
+      continue;
+    }
+
+    glm::vec3 center = (mesh->aabb.min + mesh->aabb.max) * 0.5f;
+    float     radius = glm::length(mesh->aabb.max - mesh->aabb.min) * 0.5f;
+    float     depth = -(view * glm::vec4(center, 1.0f)).z;
+
+    candidates.push_back({radius / std::max(depth, 0.1f), index});
+  }
+
+  uint32_t occluder_count =
+    std::min(static_cast<uint32_t>(candidates.size()), (uint32_t)MAX_OCCLUDERS);
+  std::partial_sort(
+    candidates.begin(),
+    candidates.begin() + occluder_count,
+    candidates.end(),
+    [](const Candidate& a, const Candidate& b) { return a.size > b.size; });
+
+  m_occlusion.begin(camera.projection * view);
+
+  for (uint32_t i = 0; i < occluder_count; ++i)
+  {
+    Node* node = m_cull_nodes[candidates[i].index];
+    for (Primitive* primitive : node->mesh->primitives)
+    {
+      if (is_opaque_occluder(primitive))
+      {
+        m_occlusion.add_occluder(
+          node->get_matrix(),
+          m_scene.positions.data(),
+          m_scene.index_data.data() + primitive->first_index,
+          primitive->index_count);
+      }
+    }
+  }
+
+  m_occlusion.rasterize(&m_simulation_jobs);
+
+  std::vector<uint32_t>& visible = m_culler.visible;
+  visible.erase(
+    std::remove_if(
+      visible.begin(),
+      visible.end(),
+      [this](uint32_t index)
+      {
+        const BoundingBox& aabb = m_cull_nodes[index]->mesh->aabb;
+        return aabb.valid && !m_occlusion.is_visible(aabb.min, aabb.max);
+      }),
+    visible.end());
+}
+
+void
+App::pick_center(const Camera& camera)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  m_scene_bvh.refit();
+
+  // the input api only reports mouse deltas, so picking follows the ray
+  // through the center of the view
+  glm::mat4 inverse = glm::inverse(camera.view * camera.model);
+
+  BvhRay ray = {};
+  ray.origin = glm::vec3(inverse[3]);
+  ray.direction = -glm::vec3(inverse[2]);
+
+  PickResult result = {};
+  bool       hit = m_scene_bvh.pick(ray, result);
+
+  std::chrono::duration<float, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  if (!hit)
+  {
+    AC_INFO("pick: no hit (%.3f ms)", elapsed.count());
+    return;
+  }
+
+  m_picked_node = result.node;
+
+  AC_INFO(
+    "pick: node %s triangle %u t %.3f barycentrics %.3f %.3f (%.3f ms)",
+    result.node->name.c_str(),
+    result.triangle / 3,
+    result.t,
+    result.barycentrics.x,
+    result.barycentrics.y,
+    elapsed.count());
+}
+
+int32_t
+App::get_texture_slot(const Texture* texture) const
+{
+  if (!texture)
+  {
+    return -1;
+  }
+
+  size_t index = texture - m_scene.textures.data();
+  if (
+    index >= m_texture_slots.size() ||
+    m_texture_slots[index] == TextureRegistry::INVALID_SLOT)
+  {
+    return -1;
+  }
+
+  return static_cast<int32_t>(m_texture_slots[index]);
+}
+
+ac_pipeline
+App::get_pipeline(
+  const Material& material,
+  uint32_t&       pipeline_id,
+  RenderPass&     pass)
+{
+  switch (material.alpha_mode)
+  {
+  case Material::ALPHAMODE_BLEND:
+  {
+    pass = RENDER_PASS_BLEND;
+    pipeline_id = 2;
+    m_blend_referenced = true;
+
+    // drawn without blending until the permutation is ready
+    return m_pipelines.pbr_alpha_blended ? m_pipelines.pbr_alpha_blended
+                                         : m_pipelines.pbr_double_sided;
+  }
+  case Material::ALPHAMODE_MASK:
+  case Material::ALPHAMODE_OPAQUE:
+  default:
+  {
+    pass = material.alpha_mode == Material::ALPHAMODE_MASK
+             ? RENDER_PASS_MASK
+             : RENDER_PASS_OPAQUE;
+    pipeline_id = material.double_sided ? 1 : 0;
+    return material.double_sided ? m_pipelines.pbr_double_sided
+                                 : m_pipelines.pbr;
+  }
+  }
+}
+
+void
+App::build_render_queue()
+{
+  m_queue.clear();
+
+  const FrameSnapshot& snapshot = get_render_snapshot();
+
+  glm::mat4 view = snapshot.camera.view * snapshot.camera.model;
+
+  for (uint32_t index : m_drawn_nodes)
+  {
+    Mesh*              mesh = m_cull_nodes[index]->mesh;
+    const glm::mat4&   matrix = snapshot.matrices[index];
+    const BoundingBox& bounds = snapshot.bounds[index];
+
+    glm::vec3 center = bounds.valid ? (bounds.min + bounds.max) * 0.5f
+                                    : glm::vec3(matrix[3]);
+    float     depth = -(view * glm::vec4(center, 1.0f)).z;
+
+    for (Primitive* primitive : mesh->primitives)
+    {
+      const Material& material = primitive->material;
+
+      RenderPass  pass = RENDER_PASS_OPAQUE;
+      uint32_t    pipeline_id = 0;
+      ac_pipeline pipeline = get_pipeline(material, pipeline_id, pass);
+
+      // the cull stage draws the rest
+      if (
+        snapshot.gpu_culling && pass != RENDER_PASS_BLEND &&
+        primitive->has_indices)
+      {
+        continue;
+      }
+
+      DrawItem item = {};
+      item.key =
+        RenderQueue::make_key(pass, pipeline_id, material.index, depth);
+      item.pipeline = pipeline;
+      item.material = static_cast<int32_t>(material.index);
+      item.node = static_cast<int32_t>(mesh->node);
+      item.first_index = m_scene.geometry.first_index + primitive->first_index;
+      // the vertex buffer is bound at the model, see stage_cmd
+      item.vertex_offset = 0;
+      item.index_count = primitive->index_count;
+      item.vertex_count = primitive->vertex_count;
+      item.indexed = primitive->has_indices;
+      // blended draws of one mesh are sorted against each other, so they
+      // use the center of their own bounds. it stays in node space and is
+      // moved by the matrices of every frame the queue is reused for
+      item.center = primitive->bb.valid
+                      ? (primitive->bb.min + primitive->bb.max) * 0.5f
+                      : glm::vec3(0.0f);
+      item.transform = index;
+
+      m_queue.push(item);
+    }
+  }
+
+  m_queue.sort(&m_jobs);
+}
+
+void
+App::encode_streams()
+{
+  auto start = std::chrono::steady_clock::now();
+
+  uint32_t item_count = static_cast<uint32_t>(m_queue.items.size());
+  uint32_t chunk_count = (item_count + DRAW_CHUNK_SIZE - 1) / DRAW_CHUNK_SIZE;
+  int32_t  pre_skinned = m_skinning_pipeline != NULL;
+
+  m_draw_streams.resize(chunk_count);
+  m_draw_stats.assign(chunk_count, RenderQueueStats());
+  m_encode_stats.thread_ms.resize(m_jobs.get_thread_count());
+
+  JobCounter counter;
+
+  // every chunk starts from unknown state, so the streams replay back to
+  // back in chunk order whichever thread encoded them
+  for (uint32_t chunk = 0; chunk < chunk_count; ++chunk)
+  {
+    m_jobs.submit(
+      counter,
+      [this, chunk, item_count, pre_skinned](uint32_t thread_index)
+      {
+        auto job_start = std::chrono::steady_clock::now();
+
+        uint32_t first = chunk * DRAW_CHUNK_SIZE;
+        uint32_t last = std::min(first + DRAW_CHUNK_SIZE, item_count);
+
+        CmdStream& stream = m_draw_streams[chunk];
+        stream.begin();
+        RenderQueue::record(
+          m_queue.items.data(),
+          stream,
+          m_db,
+          pre_skinned,
+          first,
+          last,
+          m_draw_stats[chunk]);
+        stream.end();
+
+        std::chrono::duration<float, std::milli> elapsed =
+          std::chrono::steady_clock::now() - job_start;
+        m_encode_stats.thread_ms[thread_index] += elapsed.count();
+      });
+  }
+
+  if (!m_queue.blend_items.empty())
+  {
+    m_jobs.submit(
+      counter,
+      [this](uint32_t thread_index)
+      {
+        auto job_start = std::chrono::steady_clock::now();
+
+        record_blend_stream();
+
+        std::chrono::duration<float, std::milli> elapsed =
+          std::chrono::steady_clock::now() - job_start;
+        m_encode_stats.thread_ms[thread_index] += elapsed.count();
+      });
+  }
+
+  m_jobs.wait(counter);
+
+  m_queue.stats = {};
+  for (const RenderQueueStats& stats : m_draw_stats)
+  {
+    m_queue.stats.draws += stats.draws;
+    m_queue.stats.pipeline_binds += stats.pipeline_binds;
+    m_queue.stats.set_binds += stats.set_binds;
+    m_queue.stats.push_constants += stats.push_constants;
+  }
+
+  std::chrono::duration<float, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  m_encode_stats.wall_ms += elapsed.count();
+  m_encode_stats.jobs += chunk_count + !m_queue.blend_items.empty();
+  m_encode_stats.frames++;
+}
+
+void
+App::log_encode_stats()
+{
+  if (!m_encode_stats.frames)
+  {
+    return;
+  }
+
+  float    frames = static_cast<float>(m_encode_stats.frames);
+  float    job_ms = 0.0f;
+  uint32_t busy_threads = 0;
+  for (float thread_ms : m_encode_stats.thread_ms)
+  {
+    job_ms += thread_ms;
+    busy_threads += thread_ms > 0.0f;
+  }
+
+  // the speedup is the time the jobs took over the time the stage waited
+  // for them
+  AC_INFO(
+    "stream encode: %.3f ms per frame, jobs %.3f ms on %u threads, %.1f "
+    "jobs per frame, speedup %.2f",
+    m_encode_stats.wall_ms / frames,
+    job_ms / frames,
+    busy_threads,
+    m_encode_stats.jobs / frames,
+    m_encode_stats.wall_ms > 0.0f ? job_ms / m_encode_stats.wall_ms : 0.0f);
+
+  for (uint32_t i = 0; i < m_encode_stats.thread_ms.size(); ++i)
+  {
+    if (m_encode_stats.thread_ms[i] > 0.0f)
+    {
+      AC_INFO(
+        "encode thread %u: %.3f ms per frame",
+        i,
+        m_encode_stats.thread_ms[i] / frames);
+    }
+  }
+
+  m_encode_stats.wall_ms = 0.0f;
+  m_encode_stats.jobs = 0;
+  m_encode_stats.frames = 0;
+  m_encode_stats.thread_ms.assign(m_encode_stats.thread_ms.size(), 0.0f);
+}
+
+ac_result
+App::stage_cmd(ac_rg_stage* stage, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+
+  ac_cmd   cmd = stage->cmd;
+  uint32_t width = p->m_render_width;
+  uint32_t height = p->m_render_height;
+
+  Model&               model = p->m_scene;
+  const FrameSnapshot& snapshot = p->get_render_snapshot();
+
+  ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
+  ac_cmd_set_scissor(cmd, 0, 0, width, height);
+
+  // bound at the first vertex of the model and drawn with a base vertex of
+  // 0. SV_VertexID includes the base vertex on vulkan but not on d3d12, so
+  // the morph lookup in main.acsl only agrees on both without one. skinned
+  // copies are per model and start at the first vertex already
+  if (p->m_skinning_pipeline)
+  {
+    ac_cmd_bind_vertex_buffer(
+      cmd,
+      0,
+      ac_rg_stage_get_buffer(stage, App::Token::SkinnedVertices),
+      0);
+  }
+  else
+  {
+    ac_cmd_bind_vertex_buffer(
+      cmd,
+      0,
+      model.get_vertex_buffer(),
+      model.geometry.first_vertex * sizeof(Model::Vertex));
+  }
+
+  // opaque and masked draws of the gpu path go first, the streams below
+  // only hold what it leaves to the cpu
+  uint32_t indirect_count = 0;
+  if (snapshot.gpu_culling)
+  {
+    indirect_count = p->draw_indirect(stage);
+  }
+
+  if (model.get_index_buffer())
+  {
+    ac_cmd_bind_index_buffer(
+      cmd,
+      model.get_index_buffer(),
+      0,
+      ac_index_type_u32);
+  }
+
+  if (
+    snapshot.visible != p->m_drawn_nodes ||
+    snapshot.gpu_culling != p->m_drawn_gpu_culling)
+  {
+    p->m_drawn_nodes = snapshot.visible;
+    p->m_drawn_gpu_culling = snapshot.gpu_culling;
+    p->m_queue_valid = false;
+  }
+
+  // moved geometry changes the offsets baked into the queue
+  if (p->m_geometry.get_generation() != p->m_geometry_generation)
+  {
+    p->m_geometry_generation = p->m_geometry.get_generation();
+    p->m_queue_valid = false;
+  }
+
+  if (!p->m_queue_valid)
+  {
+    p->build_render_queue();
+    p->m_queue_valid = true;
+  }
+
+  p->encode_streams();
+
+  uint32_t command_count = 0;
+  for (const CmdStream& stream : p->m_draw_streams)
+  {
+    stream.replay(cmd, stage->frame);
+    command_count += stream.command_count;
+  }
+
+  if (!p->m_queue.blend_items.empty())
+  {
+    p->m_blend_stream.replay(cmd, stage->frame);
+    command_count += p->m_blend_stream.command_count;
+  }
+
+  p->m_stats_timer += p->m_dt;
+  if (p->m_stats_timer >= 1.0f)
+  {
+    p->log_encode_stats();
+  }
+
+  if (p->m_stats_timer >= 1.0f && snapshot.gpu_culling)
+  {
+    // the count comes from the last frame that used this frame's counter
+    AC_INFO(
+      "gpu culling: %u / %u primitives visible indirect draws: %u blended "
+      "draws: %u",
+      p->m_gpu_visible_count,
+      p->m_gpu_draw_count,
+      indirect_count,
+      p->m_blend_stats.draws);
+    p->m_stats_timer = 0.0f;
+  }
+  else if (p->m_stats_timer >= 1.0f)
+  {
+    const RenderQueueStats& stats = p->m_queue.stats;
+    const CullStats&        cull = snapshot.cull_stats;
+    AC_INFO(
+      "recorded draws: %u pipeline binds: %u set binds: %u push constants: "
+      "%u commands: %u",
+      stats.draws,
+      stats.pipeline_binds,
+      stats.set_binds,
+      stats.push_constants,
+      command_count);
+    AC_INFO(
+      "blended draws: %u pipeline binds: %u",
+      p->m_blend_stats.draws,
+      p->m_blend_stats.pipeline_binds);
+    AC_INFO(
+      "nodes visible: %u frustum culled: %u contribution culled: %u",
+      cull.visible,
+      cull.frustum_culled,
+      cull.contribution_culled);
+
+    if (p->m_occlusion_culling)
+    {
+      const OcclusionStats& occlusion = snapshot.occlusion_stats;
+      AC_INFO(
+        "occluder triangles: %u binned: %u tested: %u occluded: %u",
+        occlusion.occluder_triangles,
+        occlusion.binned_triangles,
+        occlusion.tested,
+        occlusion.occluded);
+    }
+    p->m_stats_timer = 0.0f;
+  }
+
+  return ac_result_success;
+}
+
+void
+App::record_blend_stream()
+{
+  const FrameSnapshot& snapshot = get_render_snapshot();
+  const Camera&        camera = snapshot.camera;
+
+  // runs as a job of encode_streams, so the sort does not fan out on the
+  // pool again
+  m_queue.sort_blend(camera.view * camera.model, snapshot.matrices.data());
+
+  m_blend_stats = {};
+  m_blend_stream.begin();
+  RenderQueue::record(
+    m_queue.blend_items.data(),
+    m_blend_stream,
+    m_db,
+    m_skinning_pipeline != NULL,
+    0,
+    static_cast<uint32_t>(m_queue.blend_items.size()),
+    m_blend_stats);
+  m_blend_stream.end();
+}
+
+ac_result
+App::skinning_stage_cmd(ac_rg_stage* stage, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+  return p->record_skinning(stage);
+}
+
+ac_result
+App::record_skinning(ac_rg_stage* stage)
+{
+  struct SkinningData {
+    uint32_t first_vertex;
+    uint32_t vertex_count;
+    uint32_t node;
+    uint32_t source_vertex;
+  };
+
+  ac_cmd    cmd = stage->cmd;
+  ac_buffer skinned =
+    ac_rg_stage_get_buffer(stage, App::Token::SkinnedVertices);
+
+  uint8_t wg[3];
+  AC_RIF(ac_shader_get_workgroup(m_skinning_shader, wg));
+
+  // the output is a transient buffer of the graph, so its descriptor is
+  // written every frame
+  ac_descriptor descriptor = {};
+  descriptor.buffer = skinned;
+
+  ac_descriptor_write write = {};
+  write.type = ac_descriptor_type_uav_buffer;
+  write.count = 1;
+  write.descriptors = &descriptor;
+
+  ac_update_set(m_skinning_db, ac_space0, stage->frame, 1, &write);
+
+  // a moved heap replaces the source buffer, the set of this frame is the
+  // only one not read by the gpu right now
+  uint32_t generation = m_geometry.get_generation();
+  if (m_skinning_generations[stage->frame] != generation)
+  {
+    descriptor.buffer = m_scene.get_vertex_buffer();
+    write.type = ac_descriptor_type_srv_buffer;
+    write.reg = 0;
+
+    ac_update_set(m_skinning_db, ac_space0, stage->frame, 1, &write);
+    m_skinning_generations[stage->frame] = generation;
+  }
+
+  // attributes other than position and normal are never touched by the
+  // shader and rigid meshes are drawn from the copy as well, so the whole
+  // model is copied in first
+  ac_cmd_copy_buffer(
+    cmd,
+    m_scene.get_vertex_buffer(),
+    m_scene.geometry.first_vertex * sizeof(Model::Vertex),
+    skinned,
+    0,
+    m_scene.vertex_count * sizeof(Model::Vertex));
+
+  ac_buffer_barrier copied = {};
+  copied.src_access = ac_access_transfer_write_bit;
+  copied.dst_access = ac_access_shader_write_bit;
+  copied.src_stage = ac_pipeline_stage_transfer_bit;
+  copied.dst_stage = ac_pipeline_stage_compute_shader_bit;
+  copied.buffer = skinned;
+  ac_cmd_barrier(cmd, 1, &copied, 0, NULL);
+
+  ac_cmd_bind_pipeline(cmd, m_skinning_pipeline);
+  ac_cmd_bind_set(cmd, m_skinning_db, ac_space0, stage->frame);
+
+  for (Node* node : m_scene.linear_nodes)
+  {
+    Mesh* mesh = node->mesh;
+    if (
+      !mesh || (mesh->joint_offset < 0 && mesh->morph_offset < 0) ||
+      !mesh->vertex_count)
+    {
+      continue;
+    }
+
+    SkinningData data = {};
+    data.first_vertex = mesh->first_vertex;
+    data.source_vertex = m_scene.geometry.first_vertex + mesh->first_vertex;
+    data.vertex_count = mesh->vertex_count;
+    data.node = mesh->node;
+
+    ac_cmd_push_constants(cmd, sizeof(data), &data);
+    ac_cmd_dispatch(cmd, (mesh->vertex_count + wg[0] - 1) / wg[0], 1, 1);
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+App::build_frame(ac_rg_builder builder, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+
+  auto start = std::chrono::steady_clock::now();
+
+  // fences and the acquired image are patched in by the replay, anything
+  // else the graph depends on forces a new description
+  GraphInputs inputs = p->get_graph_inputs();
+  if (!(inputs == p->m_graph_inputs))
+  {
+    p->m_graph_description.invalidate();
+  }
+
+  if (!p->m_graph_description.valid)
+  {
+    p->m_graph_inputs = inputs;
+    p->describe_frame();
+    p->m_graph_stats.describes++;
+  }
+
+  p->m_graph_description.replay(builder, p->m_frame_index);
+
+  std::chrono::duration<float, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+  p->m_graph_stats.build_ms += elapsed.count();
+
+  return ac_result_success;
+}
+
+App::GraphInputs
+App::get_graph_inputs() const
+{
+  GraphInputs inputs = {};
+  inputs.render_scale = m_resolution.get_scale();
+  inputs.skinning = m_skinning_pipeline != NULL;
+  inputs.gpu_culling = get_render_snapshot().gpu_culling;
+  inputs.vertex_count = m_scene.vertex_count;
+  inputs.gpu_draw_count = m_gpu_draw_count;
+  return inputs;
+}
+
+void
+App::describe_frame()
+{
+  GraphDescription& graph = m_graph_description;
+  graph.begin();
+
+  ac_image      image = ac_swapchain_get_image(m_swapchain);
+  ac_image_info output = ac_image_get_info(image);
+
+  m_resolution.get_size(
+    output.width,
+    output.height,
+    &m_render_width,
+    &m_render_height);
+
+  ac_image_info color = output;
+  color.width = m_render_width;
+  color.height = m_render_height;
+  color.clear_value = {{{0.537, 0.412, 0.471, 1.0}}};
+  ac_image_info depth = color;
+  depth.format = ac_format_d32_sfloat;
+  depth.clear_value = {{{1.0f, 0}}};
+
+  ac_rg_builder_stage_use_resource_info use_info;
+
+  // uploads of the frame run in the prepare callback of the first stage,
+  // every later stage reads them
+  ac_rg_stage_cb prepare = App::stage_prepare;
+
+  // skinned vertices are written by a compute stage of their own, the
+  // graph orders it before every stage that draws them
+  GraphDescription::Resource skinned_vertices = 0;
+
+  if (m_graph_inputs.skinning)
+  {
+    ac_rg_builder_stage_info stage_info {};
+    stage_info.name = AC_DEBUG_NAME("skinning stage");
+    stage_info.queue = ac_queue_type_graphics;
+    stage_info.commands = ac_queue_type_compute;
+    stage_info.cb_prepare = prepare;
+    stage_info.cb_cmd = App::skinning_stage_cmd;
+    stage_info.user_data = this;
+
+    GraphDescription::Stage stage = graph.create_stage(stage_info);
+    prepare = NULL;
+
+    ac_buffer_info info = {};
+    info.size = m_scene.vertex_count * sizeof(Model::Vertex);
+    // the indirect draws pull vertices through a shader resource view
+    info.usage = ac_buffer_usage_vertex_bit | ac_buffer_usage_srv_bit |
+                 ac_buffer_usage_uav_bit | ac_buffer_usage_transfer_dst_bit;
+    info.memory_usage = ac_memory_usage_gpu_only;
+    info.name = AC_DEBUG_NAME("skinned vertices");
+
+    skinned_vertices = graph.create_buffer(info, false);
+
+    use_info = {};
+    use_info.token = App::Token::SkinnedVertices;
+    use_info.usage_bits = ac_buffer_usage_uav_bit |
+                          ac_buffer_usage_transfer_dst_bit;
+    use_info.access_write.stages =
+      ac_pipeline_stage_transfer_bit | ac_pipeline_stage_compute_shader_bit;
+    use_info.access_write.access =
+      ac_access_transfer_write_bit | ac_access_shader_write_bit;
+
+    skinned_vertices = graph.use_resource(stage, skinned_vertices, use_info);
+  }
+
+  // culling runs in a compute stage of its own so the dispatch stays out of
+  // the render pass of the main stage
+  GraphDescription::Resource indirect_args = 0;
+  GraphDescription::Resource draw_list = 0;
+
+  if (m_graph_inputs.gpu_culling)
+  {
+    ac_rg_builder_stage_info stage_info {};
+    stage_info.name = AC_DEBUG_NAME("cull stage");
+    stage_info.queue = ac_queue_type_graphics;
+    stage_info.commands = ac_queue_type_compute;
+    stage_info.cb_prepare = prepare;
+    stage_info.cb_cmd = App::cull_stage_cmd;
+    stage_info.user_data = this;
+
+    GraphDescription::Stage stage = graph.create_stage(stage_info);
+    prepare = NULL;
+
+    ac_buffer_info info = {};
+    info.size = m_groups.size() * INDIRECT_ARGS_SIZE;
+    info.usage = ac_buffer_usage_uav_bit | ac_buffer_usage_indirect_bit;
+    info.memory_usage = ac_memory_usage_gpu_only;
+    info.name = AC_DEBUG_NAME("indirect args");
+
+    indirect_args = graph.create_buffer(info, false);
+
+    // instance counts are reset and then incremented
+    use_info = {};
+    use_info.token = App::Token::IndirectArgs;
+    use_info.usage_bits = ac_buffer_usage_uav_bit;
+    use_info.access_write.stages = ac_pipeline_stage_compute_shader_bit;
+    use_info.access_write.access =
+      ac_access_shader_read_bit | ac_access_shader_write_bit;
+
+    indirect_args = graph.use_resource(stage, indirect_args, use_info);
+
+    info.size = m_gpu_draw_count * sizeof(uint32_t);
+    info.usage = ac_buffer_usage_uav_bit | ac_buffer_usage_srv_bit;
+    info.name = AC_DEBUG_NAME("draw list");
+
+    draw_list = graph.create_buffer(info, false);
+
+    use_info = {};
+    use_info.token = App::Token::DrawList;
+    use_info.usage_bits = ac_buffer_usage_uav_bit;
+    use_info.access_write.stages = ac_pipeline_stage_compute_shader_bit;
+    use_info.access_write.access = ac_access_shader_write_bit;
+
+    draw_list = graph.use_resource(stage, draw_list, use_info);
+  }
+
+  ac_rg_builder_stage_info stage_info {};
+  stage_info.name = AC_DEBUG_NAME("main stage");
+  stage_info.queue = ac_queue_type_graphics;
+  stage_info.commands = ac_queue_type_graphics;
+  stage_info.cb_prepare = prepare;
+  stage_info.cb_cmd = App::stage_cmd;
+  stage_info.user_data = this;
+
+  GraphDescription::Stage    stage = graph.create_stage(stage_info);
+  GraphDescription::Resource color_image = graph.create_image(color, true);
+  GraphDescription::Resource depth_image = graph.create_image(depth, true);
+
+  if (m_graph_inputs.skinning)
+  {
+    use_info = {};
+    use_info.token = App::Token::SkinnedVertices;
+    use_info.usage_bits = ac_buffer_usage_vertex_bit | ac_buffer_usage_srv_bit;
+    use_info.access_read.stages =
+      ac_pipeline_stage_vertex_input_bit | ac_pipeline_stage_vertex_shader_bit;
+    use_info.access_read.access =
+      ac_access_vertex_attribute_read_bit | ac_access_shader_read_bit;
+
+    graph.use_resource(stage, skinned_vertices, use_info);
+  }
+
+  if (m_graph_inputs.gpu_culling)
+  {
+    use_info = {};
+    use_info.token = App::Token::IndirectArgs;
+    use_info.usage_bits = ac_buffer_usage_indirect_bit;
+    use_info.access_read.stages = ac_pipeline_stage_draw_indirect_bit;
+    use_info.access_read.access = ac_access_indirect_command_read_bit;
+
+    graph.use_resource(stage, indirect_args, use_info);
+
+    use_info = {};
+    use_info.token = App::Token::DrawList;
+    use_info.usage_bits = ac_buffer_usage_srv_bit;
+    use_info.access_read.stages = ac_pipeline_stage_vertex_shader_bit;
+    use_info.access_read.access = ac_access_shader_read_bit;
+
+    graph.use_resource(stage, draw_list, use_info);
+  }
+
+  use_info = {};
+  use_info.token = App::Token::ColorImage;
+  use_info.access_attachment = ac_rg_attachment_access_write_bit;
+  use_info.usage_bits = ac_image_usage_attachment_bit;
+
+  color_image = graph.use_resource(stage, color_image, use_info);
+
+  use_info = {};
+  use_info.token = App::Token::DepthImage;
+  use_info.access_attachment = ac_rg_attachment_access_write_bit;
+  use_info.usage_bits = ac_image_usage_attachment_bit;
+
+  graph.use_resource(stage, depth_image, use_info);
+
+  // at full scale the main stage draws straight into the swapchain image,
+  // the upscale would only copy it
+  GraphDescription::Resource output_image = color_image;
+
+  if (color.width != output.width || color.height != output.height)
+  {
+    output_image = m_upscaler.describe(
+      graph,
+      color_image,
+      App::Token::ColorImage,
+      output,
+      App::Token::OutputImage);
+  }
+
+  graph.export_swapchain(
+    output_image,
+    m_swapchain,
+    ac_image_layout_present_src,
+    m_acquire_finished_fences,
+    m_render_finished_fences);
+
+  graph.end();
+}
+
+ac_result
+App::create_stub_images()
+{
+  ac_image_info info = {};
+  info.format = ac_format_r8g8b8a8_unorm;
+  info.width = 1;
+  info.height = 1;
+  info.type = ac_image_type_2d;
+  info.layers = 1;
+  info.levels = 1;
+  info.samples = 1;
+  info.usage = ac_image_usage_srv_bit;
+  info.name = AC_DEBUG_NAME("stub_image");
+
+  AC_RIF(ac_create_image(m_device, &info, &m_stub_image));
+
+  ac_queue queue = ac_device_get_queue(m_device, ac_queue_type_compute);
+
+  ac_cmd_pool_info pool_info = {};
+  pool_info.queue = queue;
+
+  ac_cmd_pool pool;
+  AC_RIF(ac_create_cmd_pool(m_device, &pool_info, &pool));
+
+  ac_cmd cmd;
   AC_RIF(ac_create_cmd(pool, &cmd));
 
   AC_RIF(ac_begin_cmd(cmd));
@@ -945,6 +2685,491 @@ App::create_stub_images()
   return ac_result_success;
 }
 
+ac_result
+App::create_skinning_pipeline()
+{
+  {
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_compute;
+    info.code = skinning_cs[0];
+
+    AC_RIF(ac_create_shader(m_device, &info, &m_skinning_shader));
+  }
+
+  {
+    ac_dsl_info info = {};
+    info.shader_count = 1;
+    info.shaders = &m_skinning_shader;
+    AC_RIF(ac_create_dsl(m_device, &info, &m_skinning_dsl));
+  }
+
+  {
+    ac_descriptor_buffer_info info = {};
+    info.dsl = m_skinning_dsl;
+    info.max_sets[ac_space0] = AC_MAX_FRAME_IN_FLIGHT;
+    AC_RIF(ac_create_descriptor_buffer(m_device, &info, &m_skinning_db));
+  }
+
+  {
+    ac_pipeline_info info = {};
+    info.type = ac_pipeline_type_compute;
+    info.compute.dsl = m_skinning_dsl;
+    info.compute.shader = m_skinning_shader;
+    info.name = AC_DEBUG_NAME("skinning");
+    AC_RIF(ac_create_pipeline(m_device, &info, &m_skinning_pipeline));
+  }
+
+  // the output is written by the skinning stage, it changes every frame
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_descriptor descriptors[4] = {};
+    descriptors[0].buffer = m_scene.get_vertex_buffer();
+    descriptors[1].buffer = m_scene.matrices[i];
+    descriptors[2].buffer = m_scene.joints[i];
+    descriptors[3].buffer = m_scene.morphs[i];
+
+    ac_descriptor_write writes[4] = {};
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      writes[j].type = ac_descriptor_type_srv_buffer;
+      writes[j].count = 1;
+      writes[j].descriptors = &descriptors[j];
+      writes[j].reg = j;
+    }
+
+    ac_update_set(m_skinning_db, ac_space0, i, AC_COUNTOF(writes), writes);
+    m_skinning_generations[i] = m_geometry.get_generation();
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+App::create_gpu_culling()
+{
+  struct Candidate {
+    GpuDraw  draw;
+    uint32_t pipeline_id;
+    uint32_t size_class;
+  };
+
+  std::vector<Candidate> candidates;
+
+  for (Node* node : m_scene.linear_nodes)
+  {
+    if (!node->mesh)
+    {
+      continue;
+    }
+
+    for (Primitive* primitive : node->mesh->primitives)
+    {
+      uint32_t   pipeline_id = 0;
+      RenderPass pass = RENDER_PASS_OPAQUE;
+      get_pipeline(primitive->material, pipeline_id, pass);
+
+      // blended primitives are sorted back to front on the cpu, non indexed
+      // ones are left to it as well
+      if (
+        pass == RENDER_PASS_BLEND || !primitive->has_indices ||
+        !primitive->index_count)
+      {
+        continue;
+      }
+
+      const BoundingBox& bb = primitive->bb;
+
+      Candidate candidate = {};
+      GpuDraw&  draw = candidate.draw;
+      if (bb.valid)
+      {
+        draw.center = glm::vec4((bb.min + bb.max) * 0.5f, 0.0f);
+        draw.extent = glm::vec4((bb.max - bb.min) * 0.5f, 0.0f);
+      }
+      else
+      {
+        // large enough to never be culled, small enough to stay finite
+        draw.extent = glm::vec4(glm::vec3(1e30f), 0.0f);
+      }
+      draw.node = node->mesh->node;
+      draw.first_index = primitive->first_index;
+      draw.index_count = primitive->index_count;
+      draw.material = static_cast<int32_t>(primitive->material.index);
+
+      // index counts within a factor of two share a group, so no draw
+      // runs more than twice the vertex shader invocations it needs
+      candidate.pipeline_id = pipeline_id;
+      while ((primitive->index_count >> candidate.size_class) > 1)
+      {
+        candidate.size_class++;
+      }
+
+      candidates.push_back(candidate);
+    }
+  }
+
+  std::stable_sort(
+    candidates.begin(),
+    candidates.end(),
+    [](const Candidate& a, const Candidate& b)
+    {
+      if (a.pipeline_id != b.pipeline_id)
+      {
+        return a.pipeline_id < b.pipeline_id;
+      }
+      return a.size_class < b.size_class;
+    });
+
+  // groups are sorted by pipeline and own a contiguous range of the draw
+  // list starting at the index of their first draw
+  std::vector<GpuDraw> draws;
+  uint32_t             max_index_count = 0;
+
+  for (uint32_t i = 0; i < candidates.size(); ++i)
+  {
+    Candidate& candidate = candidates[i];
+
+    if (
+      i == 0 || candidate.pipeline_id != candidates[i - 1].pipeline_id ||
+      candidate.size_class != candidates[i - 1].size_class)
+    {
+      GpuGroup group = {};
+      group.first = static_cast<uint32_t>(draws.size());
+      m_groups.push_back(group);
+      m_group_pipelines.push_back(candidate.pipeline_id);
+    }
+
+    GpuGroup& group = m_groups.back();
+    group.index_count =
+      std::max(group.index_count, candidate.draw.index_count);
+    max_index_count = std::max(max_index_count, group.index_count);
+
+    candidate.draw.group = static_cast<uint32_t>(m_groups.size() - 1);
+    draws.push_back(candidate.draw);
+  }
+
+  m_gpu_draw_count = static_cast<uint32_t>(draws.size());
+
+  if (draws.empty())
+  {
+    return ac_result_success;
+  }
+
+  {
+    ac_buffer_info info = {};
+    info.size = draws.size() * sizeof(GpuDraw);
+    info.usage = ac_buffer_usage_srv_bit;
+    info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    info.name = AC_DEBUG_NAME("gpu draws");
+    AC_RIF(ac_create_buffer(m_device, &info, &m_gpu_draws));
+    AC_RIF(ac_buffer_map_memory(m_gpu_draws));
+    memcpy(ac_buffer_get_mapped_memory(m_gpu_draws), draws.data(), info.size);
+    ac_buffer_unmap_memory(m_gpu_draws);
+  }
+
+  {
+    ac_buffer_info info = {};
+    info.size = m_groups.size() * sizeof(GpuGroup);
+    info.usage = ac_buffer_usage_srv_bit;
+    info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    info.name = AC_DEBUG_NAME("gpu groups");
+    AC_RIF(ac_create_buffer(m_device, &info, &m_gpu_groups));
+    AC_RIF(ac_buffer_map_memory(m_gpu_groups));
+    memcpy(
+      ac_buffer_get_mapped_memory(m_gpu_groups),
+      m_groups.data(),
+      info.size);
+    ac_buffer_unmap_memory(m_gpu_groups);
+  }
+
+  {
+    ac_buffer_info info = {};
+    info.size = max_index_count * sizeof(uint32_t);
+    info.usage = ac_buffer_usage_index_bit;
+    info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    info.name = AC_DEBUG_NAME("sequence indices");
+    AC_RIF(ac_create_buffer(m_device, &info, &m_sequence_indices));
+    AC_RIF(ac_buffer_map_memory(m_sequence_indices));
+
+    uint32_t* indices =
+      static_cast<uint32_t*>(ac_buffer_get_mapped_memory(m_sequence_indices));
+    for (uint32_t i = 0; i < max_index_count; ++i)
+    {
+      indices[i] = i;
+    }
+
+    ac_buffer_unmap_memory(m_sequence_indices);
+  }
+
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_buffer_info info = {};
+    info.size = sizeof(uint32_t);
+    info.usage = ac_buffer_usage_uav_bit;
+    info.memory_usage = ac_memory_usage_gpu_to_cpu;
+    info.name = AC_DEBUG_NAME("cull counter");
+    AC_RIF(ac_create_buffer(m_device, &info, &m_cull_counters[i]));
+    AC_RIF(ac_buffer_map_memory(m_cull_counters[i]));
+    memset(ac_buffer_get_mapped_memory(m_cull_counters[i]), 0, info.size);
+  }
+
+  {
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_compute;
+    info.code = cull_cs[0];
+
+    AC_RIF(ac_create_shader(m_device, &info, &m_cull_shader));
+  }
+
+  {
+    ac_dsl_info info = {};
+    info.shader_count = 1;
+    info.shaders = &m_cull_shader;
+    AC_RIF(ac_create_dsl(m_device, &info, &m_cull_dsl));
+  }
+
+  {
+    ac_descriptor_buffer_info info = {};
+    info.dsl = m_cull_dsl;
+    info.max_sets[ac_space0] = AC_MAX_FRAME_IN_FLIGHT;
+    AC_RIF(ac_create_descriptor_buffer(m_device, &info, &m_cull_db));
+  }
+
+  {
+    ac_pipeline_info info = {};
+    info.type = ac_pipeline_type_compute;
+    info.compute.dsl = m_cull_dsl;
+    info.compute.shader = m_cull_shader;
+    info.name = AC_DEBUG_NAME("gpu culling");
+    AC_RIF(ac_create_pipeline(m_device, &info, &m_cull_pipeline));
+  }
+
+  AC_RIF(create_pipeline(0, true, &m_pipelines.pbr_indirect));
+  AC_RIF(create_pipeline(1, true, &m_pipelines.pbr_double_sided_indirect));
+
+  // the arguments and the draw list belong to the graph and are written
+  // per frame by the cull stage
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_descriptor descriptors[4] = {};
+    descriptors[0].buffer = m_gpu_draws;
+    descriptors[1].buffer = m_scene.matrices[i];
+    descriptors[2].buffer = m_gpu_groups;
+    descriptors[3].buffer = m_cull_counters[i];
+
+    ac_descriptor_write writes[4] = {};
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      writes[j].type = ac_descriptor_type_srv_buffer;
+      writes[j].count = 1;
+      writes[j].descriptors = &descriptors[j];
+      writes[j].reg = j;
+    }
+    writes[3].type = ac_descriptor_type_uav_buffer;
+    writes[3].reg = 2;
+
+    ac_update_set(m_cull_db, ac_space0, i, AC_COUNTOF(writes), writes);
+  }
+
+  // space1 sets of the indirect draws, vertices, indices and the draw list
+  // are written by draw_indirect
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_descriptor descriptors[4] = {};
+    descriptors[0].buffer = m_scene.matrices[i];
+    descriptors[1].buffer = m_scene.joints[i];
+    descriptors[2].buffer = m_scene.morphs[i];
+    descriptors[3].buffer = m_gpu_draws;
+
+    ac_descriptor_write writes[4] = {};
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+      writes[j].type = ac_descriptor_type_srv_buffer;
+      writes[j].count = 1;
+      writes[j].descriptors = &descriptors[j];
+      writes[j].reg = j;
+    }
+    writes[3].reg = 5;
+
+    ac_update_set(
+      m_db,
+      ac_space1,
+      AC_MAX_FRAME_IN_FLIGHT + i,
+      AC_COUNTOF(writes),
+      writes);
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+App::cull_stage_cmd(ac_rg_stage* stage, void* ud)
+{
+  App* p = static_cast<App*>(ud);
+  return p->record_gpu_culling(stage);
+}
+
+ac_result
+App::record_gpu_culling(ac_rg_stage* stage)
+{
+  struct CullData {
+    glm::vec4 planes[6];
+    uint32_t  draw_count;
+    uint32_t  group_count;
+    uint32_t  reset;
+    uint32_t  pad;
+  };
+
+  ac_cmd   cmd = stage->cmd;
+  uint32_t group_count = static_cast<uint32_t>(m_groups.size());
+
+  // the graph waited for the last frame that used this counter before
+  // handing out its frame again, so the count is complete
+  m_gpu_visible_count = *static_cast<const uint32_t*>(
+    ac_buffer_get_mapped_memory(m_cull_counters[stage->frame]));
+
+  uint8_t wg[3];
+  AC_RIF(ac_shader_get_workgroup(m_cull_shader, wg));
+
+  ac_descriptor descriptors[2] = {};
+  descriptors[0].buffer =
+    ac_rg_stage_get_buffer(stage, App::Token::IndirectArgs);
+  descriptors[1].buffer = ac_rg_stage_get_buffer(stage, App::Token::DrawList);
+
+  ac_descriptor_write writes[2] = {};
+  for (uint32_t j = 0; j < 2; ++j)
+  {
+    writes[j].type = ac_descriptor_type_uav_buffer;
+    writes[j].count = 1;
+    writes[j].descriptors = &descriptors[j];
+    writes[j].reg = j;
+  }
+
+  ac_update_set(m_cull_db, ac_space0, stage->frame, AC_COUNTOF(writes), writes);
+
+  const Camera& camera = get_render_snapshot().camera;
+
+  Frustum frustum =
+    Frustum::from_matrix(camera.projection * camera.view * camera.model);
+
+  CullData data = {};
+  memcpy(data.planes, frustum.planes, sizeof(data.planes));
+  data.draw_count = m_gpu_draw_count;
+  data.group_count = group_count;
+  data.reset = 1;
+
+  ac_cmd_bind_pipeline(cmd, m_cull_pipeline);
+  ac_cmd_bind_set(cmd, m_cull_db, ac_space0, stage->frame);
+  ac_cmd_push_constants(cmd, sizeof(data), &data);
+  ac_cmd_dispatch(cmd, (group_count + wg[0] - 1) / wg[0], 1, 1);
+
+  // the culling dispatch increments what the reset wrote
+  ac_buffer_barrier barriers[2] = {};
+  barriers[0].src_access = ac_access_shader_write_bit;
+  barriers[0].dst_access =
+    ac_access_shader_read_bit | ac_access_shader_write_bit;
+  barriers[0].src_stage = ac_pipeline_stage_compute_shader_bit;
+  barriers[0].dst_stage = ac_pipeline_stage_compute_shader_bit;
+  barriers[0].buffer = descriptors[0].buffer;
+  barriers[1] = barriers[0];
+  barriers[1].buffer = m_cull_counters[stage->frame];
+  ac_cmd_barrier(cmd, AC_COUNTOF(barriers), barriers, 0, NULL);
+
+  // the graph orders the indirect and draw list reads of the main stage
+  // after this dispatch
+  data.reset = 0;
+  ac_cmd_push_constants(cmd, sizeof(data), &data);
+  ac_cmd_dispatch(cmd, (m_gpu_draw_count + wg[0] - 1) / wg[0], 1, 1);
+
+  return ac_result_success;
+}
+
+uint32_t
+App::draw_indirect(ac_rg_stage* stage)
+{
+  struct PushData {
+    uint32_t list_offset;
+    uint32_t first_index;
+    uint32_t first_vertex;
+    int32_t  pre_skinned;
+  };
+
+  ac_pipeline pipelines[2] = {
+    m_pipelines.pbr_indirect,
+    m_pipelines.pbr_double_sided_indirect,
+  };
+
+  ac_cmd   cmd = stage->cmd;
+  uint32_t set = AC_MAX_FRAME_IN_FLIGHT + stage->frame;
+
+  PushData push_data = {};
+  push_data.first_index = m_scene.geometry.first_index;
+  push_data.pre_skinned = m_skinning_pipeline != NULL;
+
+  // skinned vertices and the draw list are transient and the heap may have
+  // moved, so the buffers the vertices are pulled from are written every
+  // frame. skinned copies are per model and start at the first vertex
+  ac_descriptor descriptors[3] = {};
+  if (m_skinning_pipeline)
+  {
+    descriptors[0].buffer =
+      ac_rg_stage_get_buffer(stage, App::Token::SkinnedVertices);
+  }
+  else
+  {
+    descriptors[0].buffer = m_scene.get_vertex_buffer();
+    push_data.first_vertex = m_scene.geometry.first_vertex;
+  }
+  descriptors[1].buffer = m_scene.get_index_buffer();
+  descriptors[2].buffer = ac_rg_stage_get_buffer(stage, App::Token::DrawList);
+
+  ac_descriptor_write writes[3] = {};
+  for (uint32_t j = 0; j < 3; ++j)
+  {
+    writes[j].type = ac_descriptor_type_srv_buffer;
+    writes[j].count = 1;
+    writes[j].descriptors = &descriptors[j];
+  }
+  writes[0].reg = 3;
+  writes[1].reg = 4;
+  writes[2].reg = 6;
+
+  ac_update_set(m_db, ac_space1, set, AC_COUNTOF(writes), writes);
+
+  ac_buffer args = ac_rg_stage_get_buffer(stage, App::Token::IndirectArgs);
+
+  // one instanced draw per group whatever the number of primitives in it,
+  // the cull stage wrote how many survived. a draw count above one would
+  // need multiDrawIndirect, which ac does not expose
+  ac_cmd_bind_index_buffer(cmd, m_sequence_indices, 0, ac_index_type_u32);
+
+  uint32_t bound = UINT32_MAX;
+  for (uint32_t group = 0; group < m_groups.size(); ++group)
+  {
+    uint32_t pipeline_id = m_group_pipelines[group];
+    if (pipeline_id != bound)
+    {
+      ac_cmd_bind_pipeline(cmd, pipelines[pipeline_id]);
+      ac_cmd_bind_set(cmd, m_db, ac_space0, stage->frame);
+      ac_cmd_bind_set(cmd, m_db, ac_space1, set);
+      ac_cmd_bind_set(cmd, m_db, ac_space2, 0);
+      bound = pipeline_id;
+    }
+
+    push_data.list_offset = m_groups[group].first;
+    ac_cmd_push_constants(cmd, sizeof(push_data), &push_data);
+
+    ac_cmd_draw_indexed_indirect(
+      cmd,
+      args,
+      group * INDIRECT_ARGS_SIZE,
+      1,
+      INDIRECT_ARGS_SIZE);
+  }
+
+  return static_cast<uint32_t>(m_groups.size());
+}
+
 extern "C" ac_result
 ac_main(uint32_t argc, char** argv)
 {
@@ -4,6 +4,13 @@
 
 #include "model.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define MODEL_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#define JOINT_BOUNDS_GROUP_SIZE 24
+
 BoundingBox::BoundingBox() {};
 
 BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max)
@@ -35,7 +42,9 @@ BoundingBox::get_aabb(glm::mat4 m)
   min += glm::min(v0, v1);
   max += glm::max(v0, v1);
 
-  return BoundingBox(min, max);
+  BoundingBox aabb(min, max);
+  aabb.valid = this->valid;
+  return aabb;
 }
 
 void
@@ -202,12 +211,173 @@ Primitive::set_bounding_box(glm::vec3 min, glm::vec3 max)
   bb.valid = true;
 }
 
+BoundingBox
+Mesh::get_skinned_bounds() const
+{
+  const Mesh::JointMatrix* palette = &model->joint_matrices[joint_offset];
+  uint32_t group_count =
+    static_cast<uint32_t>(joint_bounds.size() / JOINT_BOUNDS_GROUP_SIZE);
+
+  glm::vec3 min = glm::vec3(FLT_MAX);
+  glm::vec3 max = glm::vec3(-FLT_MAX);
+
+#if defined(MODEL_USE_SSE)
+  const __m128 sign_mask = _mm_set1_ps(-0.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 pos_inf = _mm_set1_ps(FLT_MAX);
+  const __m128 neg_inf = _mm_set1_ps(-FLT_MAX);
+
+  __m128 vmin[3] = {pos_inf, pos_inf, pos_inf};
+  __m128 vmax[3] = {neg_inf, neg_inf, neg_inf};
+
+  for (uint32_t g = 0; g < group_count; ++g)
+  {
+    const float* group = &joint_bounds[g * JOINT_BOUNDS_GROUP_SIZE];
+
+    // the last group may be partially filled, pad it with empty matrices
+    const Mesh::JointMatrix* m = palette + g * 4;
+    Mesh::JointMatrix        tail[4] = {};
+    if (g * 4 + 4 > joint_count)
+    {
+      for (uint32_t i = 0; g * 4 + i < joint_count; ++i)
+      {
+        tail[i] = m[i];
+      }
+      m = tail;
+    }
+
+    __m128 cx = _mm_loadu_ps(group + 0);
+    __m128 cy = _mm_loadu_ps(group + 4);
+    __m128 cz = _mm_loadu_ps(group + 8);
+    __m128 ex = _mm_loadu_ps(group + 12);
+    __m128 ey = _mm_loadu_ps(group + 16);
+    __m128 ez = _mm_loadu_ps(group + 20);
+
+    __m128 valid = _mm_cmpge_ps(ex, zero);
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+      __m128 a = _mm_loadu_ps(&m[0].rows[r].x);
+      __m128 b = _mm_loadu_ps(&m[1].rows[r].x);
+      __m128 c = _mm_loadu_ps(&m[2].rows[r].x);
+      __m128 d = _mm_loadu_ps(&m[3].rows[r].x);
+      // a, b, c, d become the x, y, z and translation terms of four joints
+      _MM_TRANSPOSE4_PS(a, b, c, d);
+
+      __m128 center = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(a, cx), _mm_mul_ps(b, cy)),
+        _mm_add_ps(_mm_mul_ps(c, cz), d));
+
+      __m128 extent = _mm_add_ps(
+        _mm_add_ps(
+          _mm_mul_ps(_mm_andnot_ps(sign_mask, a), ex),
+          _mm_mul_ps(_mm_andnot_ps(sign_mask, b), ey)),
+        _mm_mul_ps(_mm_andnot_ps(sign_mask, c), ez));
+
+      __m128 lo = _mm_sub_ps(center, extent);
+      __m128 hi = _mm_add_ps(center, extent);
+
+      lo = _mm_or_ps(_mm_and_ps(valid, lo), _mm_andnot_ps(valid, pos_inf));
+      hi = _mm_or_ps(_mm_and_ps(valid, hi), _mm_andnot_ps(valid, neg_inf));
+
+      vmin[r] = _mm_min_ps(vmin[r], lo);
+      vmax[r] = _mm_max_ps(vmax[r], hi);
+    }
+  }
+
+  for (uint32_t r = 0; r < 3; ++r)
+  {
+    float lo[4];
+    float hi[4];
+    _mm_storeu_ps(lo, vmin[r]);
+    _mm_storeu_ps(hi, vmax[r]);
+
+    min[r] = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+    max[r] = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+  }
+#else
+  for (uint32_t j = 0; j < group_count * 4 && j < joint_count; ++j)
+  {
+    const float* group = &joint_bounds[(j / 4) * JOINT_BOUNDS_GROUP_SIZE];
+    uint32_t     lane = j % 4;
+
+    glm::vec3 center(group[lane], group[4 + lane], group[8 + lane]);
+    glm::vec3 extent(group[12 + lane], group[16 + lane], group[20 + lane]);
+
+    if (extent.x < 0.0f)
+    {
+      continue;
+    }
+
+    for (uint32_t r = 0; r < 3; ++r)
+    {
+      glm::vec4 row = palette[j].rows[r];
+      float     c = glm::dot(glm::vec3(row), center) + row.w;
+      float     e = glm::dot(glm::abs(glm::vec3(row)), extent);
+      min[r] = std::min(min[r], c - e);
+      max[r] = std::max(max[r], c + e);
+    }
+  }
+#endif
+
+  BoundingBox bounds(min, max);
+  bounds.valid = min.x <= max.x;
+  return bounds;
+}
+
+void
+Mesh::update_morph_deltas()
+{
+  Mesh::MorphDelta* out = &model->morph_deltas[morph_offset];
+  memset(out, 0, vertex_count * sizeof(Mesh::MorphDelta));
+
+  for (size_t t = 0; t < morph_targets.size(); ++t)
+  {
+    // inactive targets cost nothing, which keeps large rigs cheap
+    float weight = morph_weights[t];
+    if (weight == 0.0f)
+    {
+      continue;
+    }
+
+    const Mesh::MorphTarget& target = morph_targets[t];
+
+#if defined(MODEL_USE_SSE)
+    const __m128 w = _mm_set1_ps(weight);
+
+    for (size_t i = 0; i < target.indices.size(); ++i)
+    {
+      float*       dst = &out[target.indices[i]].position.x;
+      const float* src = &target.deltas[i * 2].x;
+
+      _mm_storeu_ps(
+        dst,
+        _mm_add_ps(_mm_loadu_ps(dst), _mm_mul_ps(w, _mm_loadu_ps(src))));
+      _mm_storeu_ps(
+        dst + 4,
+        _mm_add_ps(
+          _mm_loadu_ps(dst + 4),
+          _mm_mul_ps(w, _mm_loadu_ps(src + 4))));
+    }
+#else
+    for (size_t i = 0; i < target.indices.size(); ++i)
+    {
+      Mesh::MorphDelta& dst = out[target.indices[i]];
+      dst.position += weight * target.deltas[i * 2];
+      dst.normal += weight * target.deltas[i * 2 + 1];
+    }
+#endif
+  }
+}
+
 Mesh::Mesh(Model* m, glm::mat4 matrix)
 {
-  this->uniform_block = &(reinterpret_cast<Mesh::UniformBlock*>(
-    ac_buffer_get_mapped_memory(m->matrices)))[m->mesh_count];
-  this->uniform_block->matrix = matrix;
-  this->node = m->mesh_count;
+  this->model = m;
+  this->node = static_cast<uint32_t>(m->node_blocks.size());
+
+  Mesh::UniformBlock block = {};
+  block.matrix = matrix;
+  m->node_blocks.push_back(block);
 };
 
 Mesh::~Mesh()
@@ -251,28 +421,52 @@ Node::update()
 {
   if (mesh)
   {
-    glm::mat4 m = get_matrix();
+    glm::mat4           m = get_matrix();
+    Mesh::UniformBlock* block = &mesh->model->node_blocks[mesh->node];
+    block->matrix = m;
+
+    if (mesh->morph_offset >= 0)
+    {
+      mesh->update_morph_deltas();
+      block->morph_offset = mesh->morph_offset;
+      // draws bind the vertex buffer at the model and use a base vertex
+      // of 0, so vertex ids count from the first vertex of the model on
+      // every backend
+      block->first_vertex = mesh->first_vertex;
+    }
 
-    if (skin)
+    if (skin && mesh->joint_offset >= 0)
     {
-      mesh->uniform_block->matrix = m;
       glm::mat4 inverse_transform = glm::inverse(m);
-      size_t    num_joints =
-        std::min((uint32_t)skin->joints.size(), MAX_NUM_JOINTS);
-      for (size_t i = 0; i < num_joints; i++)
+
+      Mesh::JointMatrix* palette =
+        &mesh->model->joint_matrices[mesh->joint_offset];
+
+      for (size_t i = 0; i < mesh->joint_count; i++)
       {
         Node*     joint_node = skin->joints[i];
         glm::mat4 joint_mat =
           joint_node->get_matrix() * skin->inverse_bind_matrices[i];
-        joint_mat = inverse_transform * joint_mat;
-        mesh->uniform_block->joint_matrix[i] = joint_mat;
+        joint_mat = glm::transpose(inverse_transform * joint_mat);
+
+        palette[i].rows[0] = joint_mat[0];
+        palette[i].rows[1] = joint_mat[1];
+        palette[i].rows[2] = joint_mat[2];
       }
-      mesh->uniform_block->joint_count = (float)num_joints;
+      block->joint_offset = mesh->joint_offset;
+      block->joint_count = mesh->joint_count;
+
+      mesh->aabb = mesh->get_skinned_bounds().get_aabb(m);
     }
     else
     {
-      memcpy(this->mesh->uniform_block, &m, sizeof(glm::mat4));
+      mesh->aabb = mesh->bb.get_aabb(m);
     }
+
+    aabb = mesh->aabb;
+
+    block->bounds_min = glm::vec4(aabb.min, aabb.valid ? 1.0f : 0.0f);
+    block->bounds_max = glm::vec4(aabb.max, 0.0f);
   }
 
   for (auto& child : children)
@@ -294,11 +488,26 @@ Node::~Node()
 void
 Model::destroy(ac_device device)
 {
-  ac_destroy_buffer(matrices);
-  matrices = NULL;
-  ac_destroy_buffer(vertices);
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_destroy_buffer(matrices[i]);
+    matrices[i] = NULL;
+    ac_destroy_buffer(joints[i]);
+    joints[i] = NULL;
+    ac_destroy_buffer(morphs[i]);
+    morphs[i] = NULL;
+  }
+  if (heap)
+  {
+    heap->free(&geometry);
+    heap = nullptr;
+  }
+  else
+  {
+    ac_destroy_buffer(vertices);
+    ac_destroy_buffer(indices);
+  }
   vertices = NULL;
-  ac_destroy_buffer(indices);
   indices = NULL;
 
   for (auto texture : textures)
@@ -321,8 +530,76 @@ Model::destroy(ac_device device)
     delete skin;
   }
   skins.resize(0);
+  node_blocks.resize(0);
+  joint_matrices.resize(0);
+  morph_deltas.resize(0);
 };
 
+// reads a vec3 accessor into out, resolving sparse storage. morph target
+// accessors are allowed to have no buffer view, meaning all zeros
+static void
+read_vec3_accessor(
+  const tinygltf::Model&  model,
+  int                     accessor_index,
+  std::vector<glm::vec3>& out)
+{
+  const tinygltf::Accessor& accessor = model.accessors[accessor_index];
+  out.assign(accessor.count, glm::vec3(0.0f));
+
+  if (accessor.bufferView > -1)
+  {
+    const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+    const uint8_t*              data =
+      &model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset];
+    size_t stride = accessor.ByteStride(view) > 0 ? accessor.ByteStride(view)
+                                                  : sizeof(glm::vec3);
+
+    for (size_t i = 0; i < accessor.count; ++i)
+    {
+      memcpy(&out[i], data + i * stride, sizeof(glm::vec3));
+    }
+  }
+
+  if (!accessor.sparse.isSparse)
+  {
+    return;
+  }
+
+  const tinygltf::BufferView& index_view =
+    model.bufferViews[accessor.sparse.indices.bufferView];
+  const uint8_t* indices =
+    &model.buffers[index_view.buffer]
+       .data[accessor.sparse.indices.byteOffset + index_view.byteOffset];
+
+  const tinygltf::BufferView& value_view =
+    model.bufferViews[accessor.sparse.values.bufferView];
+  const uint8_t* values =
+    &model.buffers[value_view.buffer]
+       .data[accessor.sparse.values.byteOffset + value_view.byteOffset];
+
+  for (int i = 0; i < accessor.sparse.count; ++i)
+  {
+    uint32_t index = 0;
+    switch (accessor.sparse.indices.componentType)
+    {
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+      index = reinterpret_cast<const uint32_t*>(indices)[i];
+      break;
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+      index = reinterpret_cast<const uint16_t*>(indices)[i];
+      break;
+    default:
+      index = indices[i];
+      break;
+    }
+
+    if (index < out.size())
+    {
+      memcpy(&out[index], values + i * sizeof(glm::vec3), sizeof(glm::vec3));
+    }
+  }
+}
+
 void
 Model::load_node(
   Node*                  parent,
@@ -381,6 +658,7 @@ Model::load_node(
   {
     const tinygltf::Mesh mesh = model.meshes[node.mesh];
     Mesh*                newMesh = new Mesh(this, newNode->matrix);
+    newMesh->first_vertex = static_cast<uint32_t>(loaderInfo.vertex_pos);
     this->mesh_count++;
     for (size_t j = 0; j < mesh.primitives.size(); j++)
     {
@@ -656,6 +934,67 @@ Model::load_node(
                                 : materials.back());
       newPrimitive->set_bounding_box(posMin, posMax);
       newMesh->primitives.push_back(newPrimitive);
+
+      // Morph targets, only the non-zero deltas are kept
+      if (primitive.targets.size() > newMesh->morph_targets.size())
+      {
+        newMesh->morph_targets.resize(primitive.targets.size());
+      }
+
+      for (size_t t = 0; t < primitive.targets.size(); t++)
+      {
+        const auto&            attributes = primitive.targets[t];
+        std::vector<glm::vec3> positions(vertex_count, glm::vec3(0.0f));
+        std::vector<glm::vec3> normals(vertex_count, glm::vec3(0.0f));
+
+        auto it = attributes.find("POSITION");
+        if (it != attributes.end())
+        {
+          read_vec3_accessor(model, it->second, positions);
+        }
+        it = attributes.find("NORMAL");
+        if (it != attributes.end())
+        {
+          read_vec3_accessor(model, it->second, normals);
+        }
+
+        Mesh::MorphTarget& target = newMesh->morph_targets[t];
+        glm::vec3          extent = glm::vec3(0.0f);
+
+        for (uint32_t v = 0; v < vertex_count && v < positions.size(); v++)
+        {
+          glm::vec3 normal = v < normals.size() ? normals[v] : glm::vec3(0.0f);
+          if (positions[v] == glm::vec3(0.0f) && normal == glm::vec3(0.0f))
+          {
+            continue;
+          }
+
+          target.indices.push_back(vertexStart - newMesh->first_vertex + v);
+          target.deltas.push_back(glm::vec4(positions[v], 0.0f));
+          target.deltas.push_back(glm::vec4(normal, 0.0f));
+          extent = glm::max(extent, glm::abs(positions[v]));
+        }
+
+        target.extent = extent;
+      }
+    }
+    newMesh->vertex_count =
+      static_cast<uint32_t>(loaderInfo.vertex_pos) - newMesh->first_vertex;
+
+    if (!newMesh->morph_targets.empty())
+    {
+      // node weights override the mesh defaults
+      const std::vector<double>& weights =
+        node.weights.empty() ? mesh.weights : node.weights;
+
+      size_t weight_count =
+        std::min(weights.size(), newMesh->morph_targets.size());
+
+      newMesh->morph_weights.assign(newMesh->morph_targets.size(), 0.0f);
+      for (size_t t = 0; t < weight_count; t++)
+      {
+        newMesh->morph_weights[t] = static_cast<float>(weights[t]);
+      }
     }
     // Mesh BB from BBs of primitives
     for (auto p : newMesh->primitives)
@@ -758,6 +1097,281 @@ Model::load_skins(tinygltf::Model& gltf_model)
   }
 }
 
+void
+Model::allocate_joint_palette()
+{
+  uint32_t joint_count = 0;
+
+  for (auto node : linear_nodes)
+  {
+    if (node->mesh && node->skin)
+    {
+      node->mesh->joint_offset = static_cast<int32_t>(joint_count);
+      node->mesh->joint_count =
+        static_cast<uint32_t>(node->skin->joints.size());
+      joint_count += node->mesh->joint_count;
+    }
+  }
+
+  joint_matrices.resize(joint_count);
+}
+
+void
+Model::allocate_morph_deltas()
+{
+  uint32_t vertex_count = 0;
+
+  for (auto node : linear_nodes)
+  {
+    if (node->mesh && !node->mesh->morph_targets.empty())
+    {
+      node->mesh->morph_offset = static_cast<int32_t>(vertex_count);
+      vertex_count += node->mesh->vertex_count;
+    }
+  }
+
+  morph_deltas.resize(vertex_count);
+}
+
+// largest absolute weight a sampler gives target out of count targets
+static float
+max_abs_weight(const AnimationSampler& sampler, size_t target, size_t count)
+{
+  const std::vector<float>& outputs = sampler.outputs;
+  size_t                    keys = sampler.inputs.size();
+  float                     reach = 0.0f;
+
+  if (sampler.interpolation != AnimationSampler::CUBICSPLINE)
+  {
+    for (size_t k = 0; k < keys && (k + 1) * count <= outputs.size(); ++k)
+    {
+      reach = std::max(reach, fabsf(outputs[k * count + target]));
+    }
+    return reach;
+  }
+
+  // every key holds in tangents, values and out tangents. a hermite segment
+  // leaves the range of its end values by at most 4 / 27 of its tangents
+  // scaled by the segment length
+  for (size_t k = 0; k < keys && (3 * k + 3) * count <= outputs.size(); ++k)
+  {
+    float value = fabsf(outputs[(3 * k + 1) * count + target]);
+    reach = std::max(reach, value);
+
+    if (k + 1 >= keys || (3 * k + 6) * count > outputs.size())
+    {
+      continue;
+    }
+
+    float dt = sampler.inputs[k + 1] - sampler.inputs[k];
+    float next = fabsf(outputs[(3 * k + 4) * count + target]);
+    float out_tangent = fabsf(outputs[(3 * k + 2) * count + target]);
+    float in_tangent = fabsf(outputs[(3 * k + 3) * count + target]);
+
+    reach = std::max(
+      reach,
+      std::max(value, next) +
+        4.0f / 27.0f * dt * (out_tangent + in_tangent));
+  }
+
+  return reach;
+}
+
+void
+Model::compute_morph_extents()
+{
+  for (auto node : linear_nodes)
+  {
+    Mesh* mesh = node->mesh;
+    if (!mesh || mesh->morph_targets.empty())
+    {
+      continue;
+    }
+
+    size_t             count = mesh->morph_targets.size();
+    std::vector<float> reach(count, 0.0f);
+
+    for (size_t t = 0; t < count; ++t)
+    {
+      reach[t] = fabsf(mesh->morph_weights[t]);
+    }
+
+    for (const Animation& animation : animations)
+    {
+      for (const AnimationChannel& channel : animation.channels)
+      {
+        if (
+          channel.path != AnimationChannel::PathType::WEIGHTS ||
+          channel.node->mesh != mesh)
+        {
+          continue;
+        }
+
+        const AnimationSampler& sampler =
+          animation.samplers[channel.samplerIndex];
+        for (size_t t = 0; t < count; ++t)
+        {
+          reach[t] = std::max(reach[t], max_abs_weight(sampler, t, count));
+        }
+      }
+    }
+
+    mesh->morph_extent = glm::vec3(0.0f);
+    for (size_t t = 0; t < count; ++t)
+    {
+      mesh->morph_extent += mesh->morph_targets[t].extent * reach[t];
+    }
+
+    mesh->bb.valid = false;
+    for (auto p : mesh->primitives)
+    {
+      p->bb.min -= mesh->morph_extent;
+      p->bb.max += mesh->morph_extent;
+
+      if (p->bb.valid && !mesh->bb.valid)
+      {
+        mesh->bb = p->bb;
+        mesh->bb.valid = true;
+      }
+      mesh->bb.min = glm::min(mesh->bb.min, p->bb.min);
+      mesh->bb.max = glm::max(mesh->bb.max, p->bb.max);
+    }
+  }
+}
+
+void
+Model::compute_joint_bounds(const LoaderInfo& loader_info)
+{
+  for (auto node : linear_nodes)
+  {
+    Mesh* mesh = node->mesh;
+    if (!mesh || mesh->joint_offset < 0)
+    {
+      continue;
+    }
+
+    std::vector<BoundingBox> boxes(mesh->joint_count);
+
+    for (uint32_t v = 0; v < mesh->vertex_count; ++v)
+    {
+      const Vertex& vertex =
+        loader_info.vertex_buffer[mesh->first_vertex + v];
+
+      for (int k = 0; k < 4; ++k)
+      {
+        uint32_t joint = static_cast<uint32_t>(vertex.joint0[k]);
+        if (vertex.weight0[k] <= 0.0f || joint >= mesh->joint_count)
+        {
+          continue;
+        }
+
+        BoundingBox& box = boxes[joint];
+        if (!box.valid)
+        {
+          box.min = vertex.pos;
+          box.max = vertex.pos;
+          box.valid = true;
+        }
+        else
+        {
+          box.min = glm::min(box.min, vertex.pos);
+          box.max = glm::max(box.max, vertex.pos);
+        }
+      }
+    }
+
+    uint32_t group_count = (mesh->joint_count + 3) / 4;
+    mesh->joint_bounds.assign(group_count * JOINT_BOUNDS_GROUP_SIZE, 0.0f);
+
+    for (uint32_t j = 0; j < group_count * 4; ++j)
+    {
+      float*   group = &mesh->joint_bounds[(j / 4) * JOINT_BOUNDS_GROUP_SIZE];
+      uint32_t lane = j % 4;
+
+      if (j >= mesh->joint_count || !boxes[j].valid)
+      {
+        group[12 + lane] = -1.0f;
+        continue;
+      }
+
+      glm::vec3 center = (boxes[j].min + boxes[j].max) * 0.5f;
+      glm::vec3 extent =
+        (boxes[j].max - boxes[j].min) * 0.5f + mesh->morph_extent;
+
+      for (uint32_t r = 0; r < 3; ++r)
+      {
+        group[r * 4 + lane] = center[r];
+        group[12 + r * 4 + lane] = extent[r];
+      }
+    }
+  }
+}
+
+ac_result
+Model::create_node_buffers()
+{
+  // keep at least one element so the descriptors always point to a buffer
+  size_t node_count = std::max<size_t>(node_blocks.size(), 1);
+  size_t joint_count = std::max<size_t>(joint_matrices.size(), 1);
+  size_t morph_count = std::max<size_t>(morph_deltas.size(), 1);
+
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    ac_buffer_info buffer_info = {};
+    buffer_info.memory_usage = ac_memory_usage_cpu_to_gpu;
+    buffer_info.usage = ac_buffer_usage_srv_bit;
+    buffer_info.name = "node buffer";
+    buffer_info.size = node_count * sizeof(Mesh::UniformBlock);
+
+    AC_RIF(ac_create_buffer(device, &buffer_info, &matrices[i]));
+    AC_RIF(ac_buffer_map_memory(matrices[i]));
+
+    buffer_info.name = "joint buffer";
+    buffer_info.size = joint_count * sizeof(Mesh::JointMatrix);
+
+    AC_RIF(ac_create_buffer(device, &buffer_info, &joints[i]));
+    AC_RIF(ac_buffer_map_memory(joints[i]));
+
+    buffer_info.name = "morph buffer";
+    buffer_info.size = morph_count * sizeof(Mesh::MorphDelta);
+
+    AC_RIF(ac_create_buffer(device, &buffer_info, &morphs[i]));
+    AC_RIF(ac_buffer_map_memory(morphs[i]));
+
+    update_buffers(i);
+  }
+
+  return ac_result_success;
+}
+
+void
+Model::update_buffers(uint32_t frame)
+{
+  if (!node_blocks.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(matrices[frame]),
+      node_blocks.data(),
+      node_blocks.size() * sizeof(Mesh::UniformBlock));
+  }
+
+  if (!joint_matrices.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(joints[frame]),
+      joint_matrices.data(),
+      joint_matrices.size() * sizeof(Mesh::JointMatrix));
+  }
+
+  if (!morph_deltas.empty())
+  {
+    memcpy(
+      ac_buffer_get_mapped_memory(morphs[frame]),
+      morph_deltas.data(),
+      morph_deltas.size() * sizeof(Mesh::MorphDelta));
+  }
+}
+
 void
 Model::load_textures(
   tinygltf::Model& gltf_model,
@@ -1091,6 +1705,12 @@ Model::load_animations(tinygltf::Model& gltf_model)
           }
           break;
         }
+        case TINYGLTF_TYPE_SCALAR:
+        {
+          const float* buf = static_cast<const float*>(dataPtr);
+          sampler.outputs.assign(buf, buf + accessor.count);
+          break;
+        }
         default:
         {
           std::cout << "unknown type" << std::endl;
@@ -1121,8 +1741,7 @@ Model::load_animations(tinygltf::Model& gltf_model)
       }
       if (source.target_path == "weights")
       {
-        std::cout << "weights not yet supported, skipping channel" << std::endl;
-        continue;
+        channel.path = AnimationChannel::PathType::WEIGHTS;
       }
       channel.samplerIndex = source.sampler;
       channel.node = node_from_index(source.target_node);
@@ -1130,6 +1749,12 @@ Model::load_animations(tinygltf::Model& gltf_model)
       {
         continue;
       }
+      if (
+        channel.path == AnimationChannel::PathType::WEIGHTS &&
+        (!channel.node->mesh || channel.node->mesh->morph_targets.empty()))
+      {
+        continue;
+      }
 
       animation.channels.push_back(channel);
     }
@@ -1139,11 +1764,7 @@ Model::load_animations(tinygltf::Model& gltf_model)
 }
 
 ac_result
-Model::load_from_file(
-  const std::string& filename,
-  ac_device          device,
-  ac_queue           transfer_queue,
-  float              scale)
+Model::parse_file(const std::string& filename, tinygltf::Model* gltf_model)
 {
   void*  mem = NULL;
   size_t length = 0;
@@ -1164,7 +1785,6 @@ Model::load_from_file(
     ac_destroy_file(file);
   }
 
-  tinygltf::Model    gltf_model;
   tinygltf::TinyGLTF gltf_context;
 
   tinygltf::FsCallbacks fs_callbacks;
@@ -1235,8 +1855,6 @@ Model::load_from_file(
   std::string error;
   std::string warning;
 
-  this->device = device;
-
   bool   binary = false;
   size_t extpos = filename.rfind('.', filename.length());
   if (extpos != std::string::npos)
@@ -1245,87 +1863,110 @@ Model::load_from_file(
   }
 
   bool file_loaded = binary ? gltf_context.LoadBinaryFromMemory(
-                                &gltf_model,
+                                gltf_model,
                                 &error,
                                 &warning,
                                 (const unsigned char*)mem,
                                 static_cast<uint32_t>(length))
                             : gltf_context.LoadASCIIFromString(
-                                &gltf_model,
+                                gltf_model,
                                 &error,
                                 &warning,
                                 (const char*)mem,
                                 static_cast<uint32_t>(length),
                                 "");
 
+  ac_free(mem);
+
+  if (!file_loaded)
+  {
+    std::cerr << "Could not load gltf file: " << error << std::endl;
+    return ac_result_unknown_error;
+  }
+
+  return ac_result_success;
+}
+
+ac_result
+Model::load(
+  tinygltf::Model& gltf_model,
+  ac_device        device,
+  ac_queue         transfer_queue,
+  float            scale,
+  GeometryHeap*    heap)
+{
+  this->device = device;
+
   LoaderInfo loaderInfo {};
   size_t     vertex_count = 0;
   size_t     index_count = 0;
 
-  if (file_loaded)
-  {
-    load_texture_samplers(gltf_model);
-    load_textures(gltf_model, device, transfer_queue);
-    load_materials(gltf_model);
+  load_texture_samplers(gltf_model);
+  load_textures(gltf_model, device, transfer_queue);
+  load_materials(gltf_model);
 
-    const tinygltf::Scene& scene =
-      gltf_model
-        .scenes[gltf_model.defaultScene > -1 ? gltf_model.defaultScene : 0];
+  const tinygltf::Scene& scene =
+    gltf_model
+      .scenes[gltf_model.defaultScene > -1 ? gltf_model.defaultScene : 0];
 
-    // Get vertex and index buffer sizes up-front
-    for (size_t i = 0; i < scene.nodes.size(); i++)
-    {
-      get_node_props(
-        gltf_model.nodes[scene.nodes[i]],
-        gltf_model,
-        vertex_count,
-        index_count);
-    }
-    loaderInfo.vertex_buffer = new Vertex[vertex_count];
-    loaderInfo.index_buffer = new uint32_t[index_count];
+  // Get vertex and index buffer sizes up-front
+  for (size_t i = 0; i < scene.nodes.size(); i++)
+  {
+    get_node_props(
+      gltf_model.nodes[scene.nodes[i]],
+      gltf_model,
+      vertex_count,
+      index_count);
+  }
+  loaderInfo.vertex_buffer = new Vertex[vertex_count];
+  loaderInfo.index_buffer = new uint32_t[index_count];
 
-    if (gltf_model.meshes.size())
-    {
-      ac_buffer_info buffer_info = {};
-      buffer_info.memory_usage = ac_memory_usage_cpu_to_gpu;
-      buffer_info.usage = ac_buffer_usage_srv_bit;
-      buffer_info.name = "matrix buffer";
-      buffer_info.size = gltf_model.meshes.size() * sizeof(Mesh::UniformBlock);
+  // reserved before any node is loaded, the initial pose already needs
+  // the first vertex of the model
+  if (heap)
+  {
+    AC_RIF(heap->allocate(
+      static_cast<uint32_t>(vertex_count),
+      static_cast<uint32_t>(index_count),
+      &geometry));
+    this->heap = heap;
+  }
 
-      AC_RIF(ac_create_buffer(this->device, &buffer_info, &this->matrices));
-      AC_RIF(ac_buffer_map_memory(this->matrices));
-    }
+  for (size_t i = 0; i < scene.nodes.size(); i++)
+  {
+    const tinygltf::Node node = gltf_model.nodes[scene.nodes[i]];
+    load_node(nullptr, node, scene.nodes[i], gltf_model, loaderInfo, scale);
+  }
+  if (gltf_model.animations.size() > 0)
+  {
+    load_animations(gltf_model);
+  }
+  load_skins(gltf_model);
 
-    for (size_t i = 0; i < scene.nodes.size(); i++)
-    {
-      const tinygltf::Node node = gltf_model.nodes[scene.nodes[i]];
-      load_node(nullptr, node, scene.nodes[i], gltf_model, loaderInfo, scale);
-    }
-    if (gltf_model.animations.size() > 0)
+  // Assign skins
+  for (auto node : linear_nodes)
+  {
+    if (node->skin_index > -1)
     {
-      load_animations(gltf_model);
+      node->skin = skins[node->skin_index];
     }
-    load_skins(gltf_model);
+  }
+
+  allocate_joint_palette();
+  allocate_morph_deltas();
+  compute_morph_extents();
+  compute_joint_bounds(loaderInfo);
 
-    for (auto node : linear_nodes)
+  // Initial pose
+  for (auto node : linear_nodes)
+  {
+    if (node->mesh)
     {
-      // Assign skins
-      if (node->skin_index > -1)
-      {
-        node->skin = skins[node->skin_index];
-      }
-      // Initial pose
-      if (node->mesh)
-      {
-        node->update();
-      }
+      node->update();
     }
   }
-  else
-  {
-    std::cerr << "Could not load gltf file: " << error << std::endl;
-    return ac_result_unknown_error;
-  }
+
+  AC_RIF(create_node_buffers());
 
   extensions = gltf_model.extensionsUsed;
 
@@ -1365,15 +2006,22 @@ Model::load_from_file(
       index_buffer_size);
   }
 
+  if (!heap)
   {
     ac_buffer_info info = {};
     info.memory_usage = ac_memory_usage_gpu_only;
-    info.usage = ac_buffer_usage_vertex_bit | ac_buffer_usage_transfer_dst_bit;
+    info.usage = ac_buffer_usage_vertex_bit | ac_buffer_usage_srv_bit |
+                 ac_buffer_usage_transfer_src_bit |
+                 ac_buffer_usage_transfer_dst_bit;
     info.size = vertex_buffer_size;
     AC_RIF(ac_create_buffer(device, &info, &vertices));
   }
 
-  if (index_buffer_size > 0)
+  this->vertex_count = static_cast<uint32_t>(vertex_count);
+
+  deformed = !skins.empty() || !morph_deltas.empty();
+
+  if (index_buffer_size > 0 && !heap)
   {
     ac_buffer_info info = {};
     info.memory_usage = ac_memory_usage_gpu_only;
@@ -1392,11 +2040,23 @@ Model::load_from_file(
 
   ac_begin_cmd(cmd);
 
-  ac_cmd_copy_buffer(cmd, vertex_staging, 0, vertices, 0, vertex_buffer_size);
+  ac_cmd_copy_buffer(
+    cmd,
+    vertex_staging,
+    0,
+    get_vertex_buffer(),
+    geometry.first_vertex * sizeof(Vertex),
+    vertex_buffer_size);
 
   if (index_buffer_size > 0)
   {
-    ac_cmd_copy_buffer(cmd, index_staging, 0, indices, 0, index_buffer_size);
+    ac_cmd_copy_buffer(
+      cmd,
+      index_staging,
+      0,
+      get_index_buffer(),
+      geometry.first_index * sizeof(uint32_t),
+      index_buffer_size);
   }
 
   ac_end_cmd(cmd);
@@ -1415,16 +2075,52 @@ Model::load_from_file(
   ac_destroy_cmd(cmd);
   ac_destroy_cmd_pool(pool);
 
+  positions.resize(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i)
+  {
+    positions[i] = loaderInfo.vertex_buffer[i].pos;
+  }
+  index_data.assign(
+    loaderInfo.index_buffer,
+    loaderInfo.index_buffer + index_count);
+
   delete[] loaderInfo.vertex_buffer;
   delete[] loaderInfo.index_buffer;
 
   get_scene_dimensions();
 
-  ac_free(mem);
-
   return ac_result_success;
 }
 
+ac_result
+Model::load_from_file(
+  const std::string& filename,
+  ac_device          device,
+  ac_queue           transfer_queue,
+  float              scale,
+  GeometryHeap*      heap)
+{
+  tinygltf::Model gltf_model;
+  AC_RIF(parse_file(filename, &gltf_model));
+  return load(gltf_model, device, transfer_queue, scale, heap);
+}
+
+ac_buffer
+Model::get_vertex_buffer() const
+{
+  return heap ? heap->get_vertex_buffer() : vertices;
+}
+
+ac_buffer
+Model::get_index_buffer() const
+{
+  if (heap)
+  {
+    return geometry.index_count ? heap->get_index_buffer() : NULL;
+  }
+  return indices;
+}
+
 void
 Model::draw_node(Node* node, ac_cmd cmd)
 {
@@ -1436,7 +2132,7 @@ Model::draw_node(Node* node, ac_cmd cmd)
         cmd,
         primitive->index_count,
         1,
-        primitive->first_index,
+        geometry.first_index + primitive->first_index,
         0,
         0);
     }
@@ -1451,8 +2147,12 @@ Model::draw_node(Node* node, ac_cmd cmd)
 void
 Model::draw(ac_cmd cmd)
 {
-  ac_cmd_bind_vertex_buffer(cmd, 0, vertices, 0);
-  ac_cmd_bind_index_buffer(cmd, indices, 0, ac_index_type_u32);
+  ac_cmd_bind_vertex_buffer(
+    cmd,
+    0,
+    get_vertex_buffer(),
+    geometry.first_vertex * sizeof(Vertex));
+  ac_cmd_bind_index_buffer(cmd, get_index_buffer(), 0, ac_index_type_u32);
   for (auto& node : nodes)
   {
     draw_node(node, cmd);
@@ -1462,37 +2162,43 @@ Model::draw(ac_cmd cmd)
 void
 Model::calculate_bounding_box(Node* node, Node* parent)
 {
-  BoundingBox parent_bvh =
-    parent ? parent->bvh : BoundingBox(dimensions.min, dimensions.max);
+  node->bvh.valid = false;
 
   if (node->mesh)
   {
-    if (node->mesh->bb.valid)
+    // skinned meshes already carry their animated bounds from Node::update
+    if (!node->mesh->aabb.valid && node->mesh->bb.valid)
     {
-      node->aabb = node->mesh->bb.get_aabb(node->get_matrix());
-      if (node->children.size() == 0)
-      {
-        node->bvh.min = node->aabb.min;
-        node->bvh.max = node->aabb.max;
-        node->bvh.valid = true;
-      }
+      node->mesh->aabb = node->mesh->bb.get_aabb(node->get_matrix());
     }
+    node->aabb = node->mesh->aabb;
+    node->bvh = node->aabb;
   }
 
-  parent_bvh.min = glm::min(parent_bvh.min, node->bvh.min);
-  parent_bvh.max = glm::min(parent_bvh.max, node->bvh.max);
-
   for (auto& child : node->children)
   {
     calculate_bounding_box(child, node);
   }
+
+  if (parent && node->bvh.valid)
+  {
+    if (!parent->bvh.valid)
+    {
+      parent->bvh = node->bvh;
+    }
+    else
+    {
+      parent->bvh.min = glm::min(parent->bvh.min, node->bvh.min);
+      parent->bvh.max = glm::max(parent->bvh.max, node->bvh.max);
+    }
+  }
 }
 
 void
 Model::get_scene_dimensions()
 {
   // Calculate binary volume hierarchy for all nodes in the scene
-  for (auto node : linear_nodes)
+  for (auto node : nodes)
   {
     calculate_bounding_box(node, nullptr);
   }
@@ -1521,86 +2227,6 @@ Model::get_scene_dimensions()
   aabb[3][2] = dimensions.min[2];
 }
 
-void
-Model::update_animation(uint32_t index, float time)
-{
-  if (animations.empty())
-  {
-    std::cout << ".glTF does not contain animation." << std::endl;
-    return;
-  }
-  if (index > static_cast<uint32_t>(animations.size()) - 1)
-  {
-    std::cout << "No animation with index " << index << std::endl;
-    return;
-  }
-  Animation& animation = animations[index];
-
-  bool updated = false;
-  for (auto& channel : animation.channels)
-  {
-    AnimationSampler& sampler = animation.samplers[channel.samplerIndex];
-    if (sampler.inputs.size() > sampler.outputs_vec4.size())
-    {
-      continue;
-    }
-
-    for (size_t i = 0; i < sampler.inputs.size() - 1; i++)
-    {
-      if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1]))
-      {
-        float u = std::max(0.0f, time - sampler.inputs[i]) /
-                  (sampler.inputs[i + 1] - sampler.inputs[i]);
-
-        if (u <= 1.0f)
-        {
-          switch (channel.path)
-          {
-          case AnimationChannel::PathType::TRANSLATION:
-          {
-            glm::vec4 trans =
-              glm::mix(sampler.outputs_vec4[i], sampler.outputs_vec4[i + 1], u);
-            channel.node->translation = glm::vec3(trans);
-            break;
-          }
-          case AnimationChannel::PathType::SCALE:
-          {
-            glm::vec4 trans =
-              glm::mix(sampler.outputs_vec4[i], sampler.outputs_vec4[i + 1], u);
-            channel.node->scale = glm::vec3(trans);
-            break;
-          }
-          case AnimationChannel::PathType::ROTATION:
-          {
-            glm::quat q1;
-            q1.x = sampler.outputs_vec4[i].x;
-            q1.y = sampler.outputs_vec4[i].y;
-            q1.z = sampler.outputs_vec4[i].z;
-            q1.w = sampler.outputs_vec4[i].w;
-            glm::quat q2;
-            q2.x = sampler.outputs_vec4[i + 1].x;
-            q2.y = sampler.outputs_vec4[i + 1].y;
-            q2.z = sampler.outputs_vec4[i + 1].z;
-            q2.w = sampler.outputs_vec4[i + 1].w;
-            channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-            break;
-          }
-          }
-          updated = true;
-        }
-      }
-    }
-  }
-
-  if (updated)
-  {
-    for (auto& node : nodes)
-    {
-      node->update();
-    }
-  }
-}
-
 Node*
 Model::find_node(Node* parent, uint32_t index)
 {
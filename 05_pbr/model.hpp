@@ -19,7 +19,7 @@
 
 #include <tinygltf/tiny_gltf.h>
 
-#define MAX_NUM_JOINTS 128u
+#include "geometry_heap.hpp"
 
 struct Node;
 
@@ -118,26 +118,73 @@ struct Primitive {
 
 struct Model;
 struct Mesh {
-  ac_device               device;
+  Model*                  model;
   std::vector<Primitive*> primitives;
   BoundingBox             bb;
   BoundingBox             aabb;
-  ac_buffer               uniform_buffer;
   uint32_t                node;
-
+  uint32_t                first_vertex = 0;
+  uint32_t                vertex_count = 0;
+  int32_t                 joint_offset = -1;
+  uint32_t                joint_count = 0;
+  int32_t                 morph_offset = -1;
+
+  // per mesh entry of the node buffer, joint matrices live in a separate
+  // palette buffer and are only addressed when joint_offset is not -1,
+  // blended morph deltas likewise when morph_offset is not -1. bounds are
+  // the current world aabb of the mesh, bounds_min.w is 0 when unknown
   struct UniformBlock {
     glm::mat4 matrix {};
-    glm::mat4 joint_matrix[MAX_NUM_JOINTS] {};
-    float     joint_count {0};
+    int32_t   joint_offset {-1};
+    uint32_t  joint_count {0};
+    int32_t   morph_offset {-1};
+    uint32_t  first_vertex {0};
+    glm::vec4 bounds_min {};
+    glm::vec4 bounds_max {};
+  };
+
+  // affine joint transform stored as three rows
+  struct JointMatrix {
+    glm::vec4 rows[3];
+  };
+
+  // bind pose bounds of the vertices weighted to each joint, packed in
+  // groups of four joints as center xyz then extent xyz, one lane per joint.
+  // a negative extent marks a joint without influenced vertices
+  std::vector<float> joint_bounds;
+
+  // non-zero deltas of a single morph target, two vec4 per entry holding
+  // the position and the normal delta. indices are relative to first_vertex
+  struct MorphTarget {
+    std::vector<uint32_t>  indices;
+    std::vector<glm::vec4> deltas;
+    // largest absolute position delta at a weight of one
+    glm::vec3              extent {};
+  };
+
+  // blended morph output for one vertex
+  struct MorphDelta {
+    glm::vec4 position;
+    glm::vec4 normal;
   };
 
-  UniformBlock* uniform_block;
+  std::vector<MorphTarget> morph_targets;
+  std::vector<float>       morph_weights;
+  // largest displacement reachable with the weights the mesh defaults and
+  // its animations reach, glTF allows weights outside [0, 1]
+  glm::vec3                morph_extent {};
 
   Mesh(Model*, glm::mat4 matrix);
   ~Mesh();
 
   void
   set_bounding_box(glm::vec3 min, glm::vec3 max);
+
+  BoundingBox
+  get_skinned_bounds() const;
+
+  void
+  update_morph_deltas();
 };
 
 struct Skin {
@@ -178,7 +225,8 @@ struct AnimationChannel {
   enum PathType {
     TRANSLATION,
     ROTATION,
-    SCALE
+    SCALE,
+    WEIGHTS
   };
   PathType path;
   Node*    node;
@@ -194,6 +242,7 @@ struct AnimationSampler {
   InterpolationType      interpolation;
   std::vector<float>     inputs;
   std::vector<glm::vec4> outputs_vec4;
+  std::vector<float>     outputs;
 };
 
 struct Animation {
@@ -217,13 +266,31 @@ struct Model {
     glm::vec4 color;
   };
 
-  ac_buffer vertices;
-  ac_buffer indices;
-  ac_buffer matrices;
+  // only created when the model is not loaded into a geometry heap, use
+  // get_vertex_buffer and get_index_buffer to reach either. geometry
+  // locates the model inside them
+  ac_buffer     vertices;
+  ac_buffer     indices;
+  GeometryHeap* heap = nullptr;
+  GeometryRange geometry = {};
+  ac_buffer matrices[AC_MAX_FRAME_IN_FLIGHT];
+  ac_buffer joints[AC_MAX_FRAME_IN_FLIGHT];
+  ac_buffer morphs[AC_MAX_FRAME_IN_FLIGHT];
+  // skins or morph targets move vertices, so the skinning pass has work
+  bool      deformed = false;
+
+  std::vector<Mesh::UniformBlock> node_blocks;
+  std::vector<Mesh::JointMatrix>  joint_matrices;
+  std::vector<Mesh::MorphDelta>   morph_deltas;
+
+  // rest pose positions and indices kept on the cpu for picking and queries
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t>  index_data;
 
   glm::mat4 aabb;
 
-  size_t mesh_count;
+  size_t   mesh_count;
+  uint32_t vertex_count;
 
   std::vector<Node*> nodes;
   std::vector<Node*> linear_nodes;
@@ -270,6 +337,26 @@ struct Model {
   void
   load_skins(tinygltf::Model& model);
 
+  void
+  allocate_joint_palette();
+
+  void
+  compute_joint_bounds(const LoaderInfo& loader_info);
+
+  void
+  allocate_morph_deltas();
+
+  // scales every morph target extent by the largest weight it reaches and
+  // grows the primitive and mesh bounds by the sum
+  void
+  compute_morph_extents();
+
+  ac_result
+  create_node_buffers();
+
+  void
+  update_buffers(uint32_t frame);
+
   void
   load_textures(tinygltf::Model& model, ac_device device, ac_queue copy_queue);
 
@@ -288,12 +375,34 @@ struct Model {
   void
   load_animations(tinygltf::Model& model);
 
+  // reads and parses the file only, touches neither the model nor the gpu
+  // so it can run next to other startup work
+  static ac_result
+  parse_file(const std::string& filename, tinygltf::Model* gltf_model);
+
+  // creates textures, geometry and node buffers of a parsed file
+  ac_result
+  load(
+    tinygltf::Model& gltf_model,
+    ac_device        device,
+    ac_queue         copy_queue,
+    float            scale = 1.0f,
+    GeometryHeap*    heap = nullptr);
+
   ac_result
   load_from_file(
     const std::string& filename,
     ac_device          device,
     ac_queue           copy_queue,
-    float              scale = 1.0f);
+    float              scale = 1.0f,
+    GeometryHeap*      heap = nullptr);
+
+  // the heap may move its buffers, so they are looked up on every use
+  ac_buffer
+  get_vertex_buffer() const;
+
+  ac_buffer
+  get_index_buffer() const;
 
   void
   draw_node(Node* node, ac_cmd cmd);
@@ -307,9 +416,6 @@ struct Model {
   void
   get_scene_dimensions(void);
 
-  void
-  update_animation(uint32_t index, float time);
-
   Node*
   find_node(Node* parent, uint32_t index);
 
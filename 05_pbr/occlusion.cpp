@@ -0,0 +1,541 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "occlusion.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define OCCLUSION_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// occluder triangles set up per job
+#define OCCLUSION_CHUNK_SIZE 1024
+
+// clamped as a float first, vertices close to the near plane project far
+// outside the int range
+static int32_t
+to_pixel(float v, uint32_t limit)
+{
+  return static_cast<int32_t>(glm::clamp(v, 0.0f, static_cast<float>(limit)));
+}
+
+void
+OcclusionCuller::init(uint32_t width, uint32_t height)
+{
+  m_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+  m_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+  m_width = m_tiles_x * TILE_SIZE;
+  m_height = m_tiles_y * TILE_SIZE;
+  m_bins_x = (m_width + BIN_WIDTH - 1) / BIN_WIDTH;
+  m_bins_y = (m_height + BIN_HEIGHT - 1) / BIN_HEIGHT;
+
+  m_depth.assign(m_width * m_height, 1.0f);
+  m_tile_max.assign(m_tiles_x * m_tiles_y, 1.0f);
+}
+
+void
+OcclusionCuller::begin(const glm::mat4& view_projection)
+{
+  m_view_projection = view_projection;
+  std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+  std::fill(m_tile_max.begin(), m_tile_max.end(), 1.0f);
+  m_occluders.clear();
+  stats = {};
+}
+
+void
+OcclusionCuller::add_occluder(
+  const glm::mat4& model,
+  const glm::vec3* positions,
+  const uint32_t*  indices,
+  uint32_t         index_count)
+{
+  if (index_count < 3)
+  {
+    return;
+  }
+
+  Occluder occluder = {};
+  occluder.model = model;
+  occluder.positions = positions;
+  occluder.indices = indices;
+  occluder.index_count = index_count;
+  m_occluders.push_back(occluder);
+
+  stats.occluder_triangles += index_count / 3;
+}
+
+void
+OcclusionCuller::rasterize(JobSystem* jobs)
+{
+  m_triangle_offsets.resize(m_occluders.size() + 1);
+
+  uint32_t total = 0;
+  for (size_t i = 0; i < m_occluders.size(); ++i)
+  {
+    m_triangle_offsets[i] = total;
+    total += m_occluders[i].index_count / 3;
+  }
+  m_triangle_offsets[m_occluders.size()] = total;
+
+  uint32_t chunk_count =
+    (total + OCCLUSION_CHUNK_SIZE - 1) / OCCLUSION_CHUNK_SIZE;
+  uint32_t bin_count = m_bins_x * m_bins_y;
+
+  m_chunks.resize(chunk_count);
+  for (Chunk& chunk : m_chunks)
+  {
+    chunk.triangles.clear();
+    chunk.bins.resize(bin_count);
+    for (std::vector<uint32_t>& bin : chunk.bins)
+    {
+      bin.clear();
+    }
+  }
+
+  auto setup = [this](uint32_t first, uint32_t last, uint32_t)
+  { setup_triangles(first, last, m_chunks[first / OCCLUSION_CHUNK_SIZE]); };
+
+  // every bin owns its pixels, so bins never need to synchronize
+  auto raster = [this](uint32_t first, uint32_t last, uint32_t)
+  {
+    for (uint32_t bin = first; bin < last; ++bin)
+    {
+      rasterize_bin(bin);
+    }
+  };
+
+  if (jobs)
+  {
+    jobs->parallel_for(total, OCCLUSION_CHUNK_SIZE, setup);
+    jobs->parallel_for(bin_count, 1, raster);
+  }
+  else
+  {
+    for (uint32_t first = 0; first < total; first += OCCLUSION_CHUNK_SIZE)
+    {
+      setup(first, std::min(first + OCCLUSION_CHUNK_SIZE, total), 0);
+    }
+    raster(0, bin_count, 0);
+  }
+
+  for (const Chunk& chunk : m_chunks)
+  {
+    for (const std::vector<uint32_t>& bin : chunk.bins)
+    {
+      stats.binned_triangles += static_cast<uint32_t>(bin.size());
+    }
+  }
+}
+
+void
+OcclusionCuller::setup_triangles(uint32_t first, uint32_t last, Chunk& chunk)
+{
+  size_t occluder_index =
+    std::upper_bound(
+      m_triangle_offsets.begin(),
+      m_triangle_offsets.end(),
+      first) -
+    m_triangle_offsets.begin() - 1;
+
+  const Occluder* occluder = &m_occluders[occluder_index];
+  glm::mat4       mvp = m_view_projection * occluder->model;
+
+  for (uint32_t t = first; t < last; ++t)
+  {
+    if (t >= m_triangle_offsets[occluder_index + 1])
+    {
+      // empty occluders are never added, so the next one starts here
+      occluder_index++;
+      occluder = &m_occluders[occluder_index];
+      mvp = m_view_projection * occluder->model;
+    }
+
+    const uint32_t* indices =
+      occluder->indices + (t - m_triangle_offsets[occluder_index]) * 3;
+
+    glm::vec4 clip[3];
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+      clip[k] = mvp * glm::vec4(occluder->positions[indices[k]], 1.0f);
+    }
+
+    add_triangle(clip, chunk);
+  }
+}
+
+void
+OcclusionCuller::add_triangle(const glm::vec4* clip, Chunk& chunk)
+{
+  // clip against the near plane, depth is zero to one so inside is z >= 0.
+  // the other planes are handled by clamping to the screen
+  glm::vec4 polygon[4];
+  uint32_t  count = 0;
+
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    const glm::vec4& a = clip[i];
+    const glm::vec4& b = clip[(i + 1) % 3];
+
+    if (a.z >= 0.0f)
+    {
+      polygon[count++] = a;
+    }
+
+    if ((a.z >= 0.0f) != (b.z >= 0.0f))
+    {
+      float t = a.z / (a.z - b.z);
+      polygon[count++] = a + (b - a) * t;
+    }
+  }
+
+  if (count < 3)
+  {
+    return;
+  }
+
+  glm::vec3 screen[4];
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const glm::vec4& v = polygon[i];
+    screen[i] = glm::vec3(
+      (v.x / v.w * 0.5f + 0.5f) * m_width,
+      (v.y / v.w * 0.5f + 0.5f) * m_height,
+      v.z / v.w);
+  }
+
+  for (uint32_t i = 1; i + 1 < count; ++i)
+  {
+    add_screen_triangle(screen[0], screen[i], screen[i + 1], chunk);
+  }
+}
+
+void
+OcclusionCuller::add_screen_triangle(
+  glm::vec3 v0,
+  glm::vec3 v1,
+  glm::vec3 v2,
+  Chunk&    chunk)
+{
+  float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+
+  if (std::abs(area) < 1e-6f)
+  {
+    return;
+  }
+
+  // occluders are rasterized double sided, winding is normalized instead
+  if (area < 0.0f)
+  {
+    std::swap(v1, v2);
+    area = -area;
+  }
+
+  Triangle tri = {};
+
+  float min_x = std::min(std::min(v0.x, v1.x), v2.x);
+  float min_y = std::min(std::min(v0.y, v1.y), v2.y);
+  float max_x = std::max(std::max(v0.x, v1.x), v2.x);
+  float max_y = std::max(std::max(v0.y, v1.y), v2.y);
+
+  tri.min_x = to_pixel(std::floor(min_x), m_width);
+  tri.min_y = to_pixel(std::floor(min_y), m_height);
+  tri.max_x = to_pixel(std::ceil(max_x), m_width);
+  tri.max_y = to_pixel(std::ceil(max_y), m_height);
+
+  if (tri.min_x >= tri.max_x || tri.min_y >= tri.max_y)
+  {
+    return;
+  }
+
+  const glm::vec3* v[3] = {&v0, &v1, &v2};
+  for (uint32_t i = 0; i < 3; ++i)
+  {
+    const glm::vec3& p = *v[i];
+    const glm::vec3& q = *v[(i + 1) % 3];
+
+    float a = p.y - q.y;
+    float b = q.x - p.x;
+    tri.edges[i] = glm::vec3(a, b, -a * p.x - b * p.y);
+  }
+
+  float dz1 = v1.z - v0.z;
+  float dz2 = v2.z - v0.z;
+  float zx = (dz1 * (v2.y - v0.y) - dz2 * (v1.y - v0.y)) / area;
+  float zy = (dz2 * (v1.x - v0.x) - dz1 * (v2.x - v0.x)) / area;
+  tri.depth = glm::vec3(zx, zy, v0.z - zx * v0.x - zy * v0.y);
+
+  uint32_t index = static_cast<uint32_t>(chunk.triangles.size());
+  chunk.triangles.push_back(tri);
+
+  uint32_t bin_x0 = tri.min_x / BIN_WIDTH;
+  uint32_t bin_y0 = tri.min_y / BIN_HEIGHT;
+  uint32_t bin_x1 = (tri.max_x - 1) / BIN_WIDTH;
+  uint32_t bin_y1 = (tri.max_y - 1) / BIN_HEIGHT;
+
+  for (uint32_t y = bin_y0; y <= bin_y1; ++y)
+  {
+    for (uint32_t x = bin_x0; x <= bin_x1; ++x)
+    {
+      chunk.bins[y * m_bins_x + x].push_back(index);
+    }
+  }
+}
+
+void
+OcclusionCuller::rasterize_bin(uint32_t bin)
+{
+  int32_t bin_x0 = static_cast<int32_t>((bin % m_bins_x) * BIN_WIDTH);
+  int32_t bin_y0 = static_cast<int32_t>((bin / m_bins_x) * BIN_HEIGHT);
+  int32_t bin_x1 = std::min(bin_x0 + (int32_t)BIN_WIDTH, (int32_t)m_width);
+  int32_t bin_y1 = std::min(bin_y0 + (int32_t)BIN_HEIGHT, (int32_t)m_height);
+
+  for (const Chunk& chunk : m_chunks)
+  {
+    for (uint32_t index : chunk.bins[bin])
+    {
+      const Triangle& tri = chunk.triangles[index];
+
+      // bin edges are multiples of 4, so the aligned spans never leave the
+      // bin, and lanes outside the triangle bounds fail the edge tests
+      int32_t x0 = std::max(tri.min_x, bin_x0) & ~3;
+      int32_t x1 = std::min(tri.max_x, bin_x1);
+      int32_t y0 = std::max(tri.min_y, bin_y0);
+      int32_t y1 = std::min(tri.max_y, bin_y1);
+
+      for (int32_t y = y0; y < y1; ++y)
+      {
+        float  py = y + 0.5f;
+        float* row = m_depth.data() + y * m_width;
+
+#if defined(OCCLUSION_USE_SSE)
+        __m128 e0_row = _mm_set1_ps(tri.edges[0].y * py + tri.edges[0].z);
+        __m128 e1_row = _mm_set1_ps(tri.edges[1].y * py + tri.edges[1].z);
+        __m128 e2_row = _mm_set1_ps(tri.edges[2].y * py + tri.edges[2].z);
+        __m128 z_row = _mm_set1_ps(tri.depth.y * py + tri.depth.z);
+        __m128 e0_x = _mm_set1_ps(tri.edges[0].x);
+        __m128 e1_x = _mm_set1_ps(tri.edges[1].x);
+        __m128 e2_x = _mm_set1_ps(tri.edges[2].x);
+        __m128 z_x = _mm_set1_ps(tri.depth.x);
+        __m128 zero = _mm_setzero_ps();
+
+        for (int32_t x = x0; x < x1; x += 4)
+        {
+          __m128 px = _mm_add_ps(
+            _mm_set1_ps(static_cast<float>(x)),
+            _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+
+          __m128 inside = _mm_and_ps(
+            _mm_and_ps(
+              _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e0_x, px), e0_row), zero),
+              _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e1_x, px), e1_row), zero)),
+            _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(e2_x, px), e2_row), zero));
+
+          if (!_mm_movemask_ps(inside))
+          {
+            continue;
+          }
+
+          __m128 z = _mm_add_ps(_mm_mul_ps(z_x, px), z_row);
+          __m128 dst = _mm_loadu_ps(row + x);
+          __m128 closest = _mm_min_ps(dst, z);
+
+          _mm_storeu_ps(
+            row + x,
+            _mm_or_ps(
+              _mm_and_ps(inside, closest),
+              _mm_andnot_ps(inside, dst)));
+        }
+#else
+        for (int32_t x = std::max(x0, tri.min_x); x < x1; ++x)
+        {
+          float px = x + 0.5f;
+
+          if (
+            tri.edges[0].x * px + tri.edges[0].y * py + tri.edges[0].z < 0 ||
+            tri.edges[1].x * px + tri.edges[1].y * py + tri.edges[1].z < 0 ||
+            tri.edges[2].x * px + tri.edges[2].y * py + tri.edges[2].z < 0)
+          {
+            continue;
+          }
+
+          float z = tri.depth.x * px + tri.depth.y * py + tri.depth.z;
+          row[x] = std::min(row[x], z);
+        }
+#endif
+      }
+    }
+  }
+
+  // bins are whole tiles, refresh the farthest depth of each
+  for (int32_t ty = bin_y0; ty < bin_y1; ty += TILE_SIZE)
+  {
+    for (int32_t tx = bin_x0; tx < bin_x1; tx += TILE_SIZE)
+    {
+      float tile_max = 0.0f;
+      for (int32_t y = ty; y < ty + (int32_t)TILE_SIZE; ++y)
+      {
+        const float* row = m_depth.data() + y * m_width;
+        for (int32_t x = tx; x < tx + (int32_t)TILE_SIZE; ++x)
+        {
+          tile_max = std::max(tile_max, row[x]);
+        }
+      }
+
+      m_tile_max[(ty / TILE_SIZE) * m_tiles_x + tx / TILE_SIZE] = tile_max;
+    }
+  }
+}
+
+bool
+OcclusionCuller::is_visible(const glm::vec3& min, const glm::vec3& max)
+{
+  stats.tested++;
+
+  if (m_depth.empty())
+  {
+    return true;
+  }
+
+  float min_x = FLT_MAX;
+  float min_y = FLT_MAX;
+  float max_x = -FLT_MAX;
+  float max_y = -FLT_MAX;
+  float min_z = FLT_MAX;
+
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    glm::vec3 corner = glm::vec3(
+      i & 1 ? max.x : min.x,
+      i & 2 ? max.y : min.y,
+      i & 4 ? max.z : min.z);
+
+    glm::vec4 clip = m_view_projection * glm::vec4(corner, 1.0f);
+
+    // boxes crossing the near plane cannot be projected conservatively
+    if (clip.z < 0.0f || clip.w <= 0.0f)
+    {
+      return true;
+    }
+
+    float sx = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+    float sy = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+
+    min_x = std::min(min_x, sx);
+    min_y = std::min(min_y, sy);
+    max_x = std::max(max_x, sx);
+    max_y = std::max(max_y, sy);
+    min_z = std::min(min_z, clip.z / clip.w);
+  }
+
+  int32_t x0 = to_pixel(std::floor(min_x), m_width);
+  int32_t y0 = to_pixel(std::floor(min_y), m_height);
+  int32_t x1 = to_pixel(std::ceil(max_x), m_width);
+  int32_t y1 = to_pixel(std::ceil(max_y), m_height);
+
+  // off screen boxes are left to the frustum test
+  if (x0 >= x1 || y0 >= y1)
+  {
+    return true;
+  }
+
+  for (int32_t ty = y0 / TILE_SIZE; ty <= (y1 - 1) / (int32_t)TILE_SIZE; ++ty)
+  {
+    for (int32_t tx = x0 / TILE_SIZE; tx <= (x1 - 1) / (int32_t)TILE_SIZE;
+         ++tx)
+    {
+      // the farthest occluder of the tile is still in front of the box
+      if (min_z > m_tile_max[ty * m_tiles_x + tx])
+      {
+        continue;
+      }
+
+      int32_t py0 = std::max(y0, ty * (int32_t)TILE_SIZE);
+      int32_t py1 = std::min(y1, (ty + 1) * (int32_t)TILE_SIZE);
+      int32_t px0 = std::max(x0, tx * (int32_t)TILE_SIZE);
+      int32_t px1 = std::min(x1, (tx + 1) * (int32_t)TILE_SIZE);
+
+      for (int32_t y = py0; y < py1; ++y)
+      {
+        const float* row = m_depth.data() + y * m_width;
+        for (int32_t x = px0; x < px1; ++x)
+        {
+          if (min_z <= row[x])
+          {
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  stats.occluded++;
+  return false;
+}
+
+uint32_t
+OcclusionCuller::get_width() const
+{
+  return m_width;
+}
+
+uint32_t
+OcclusionCuller::get_height() const
+{
+  return m_height;
+}
+
+const float*
+OcclusionCuller::get_depth() const
+{
+  return m_depth.data();
+}
+
+bool
+OcclusionCuller::dump_depth(const char* path) const
+{
+  float lo = 1.0f;
+  float hi = 0.0f;
+  for (float depth : m_depth)
+  {
+    if (depth < 1.0f)
+    {
+      lo = std::min(lo, depth);
+      hi = std::max(hi, depth);
+    }
+  }
+
+  char header[64];
+  int  header_size =
+    snprintf(header, sizeof(header), "P5\n%u %u\n255\n", m_width, m_height);
+
+  std::vector<uint8_t> data(header_size + m_width * m_height);
+  memcpy(data.data(), header, header_size);
+
+  float range = hi > lo ? hi - lo : 1.0f;
+
+  // rows are stored bottom up, pgm starts at the top
+  uint8_t* pixels = data.data() + header_size;
+  for (uint32_t y = 0; y < m_height; ++y)
+  {
+    const float* row = m_depth.data() + (m_height - 1 - y) * m_width;
+    for (uint32_t x = 0; x < m_width; ++x)
+    {
+      float depth = row[x];
+      pixels[y * m_width + x] =
+        depth < 1.0f
+          ? static_cast<uint8_t>(32.0f + 223.0f * (hi - depth) / range)
+          : 0;
+    }
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (!file)
+  {
+    return false;
+  }
+
+  bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+
+  return fclose(file) == 0 && written;
+}
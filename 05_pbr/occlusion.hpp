@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "job_system.hpp"
+
+struct OcclusionStats {
+  uint32_t occluder_triangles;
+  uint32_t binned_triangles;
+  uint32_t tested;
+  uint32_t occluded;
+};
+
+// cpu occlusion culling against a low resolution depth buffer. occluders
+// are rasterized closest depth wins, 4 pixels at a time, into bins that are
+// processed in parallel. every 8x8 pixel tile also keeps its farthest depth
+// so most occludee tests are decided without touching pixels. there is no
+// gpu dependency, the whole thing can be driven from plain arrays
+class OcclusionCuller {
+public:
+  static constexpr uint32_t TILE_SIZE = 8;
+  static constexpr uint32_t BIN_WIDTH = 64;
+  static constexpr uint32_t BIN_HEIGHT = 32;
+
+  OcclusionStats stats = {};
+
+  // width and height are rounded up to whole tiles
+  void
+  init(uint32_t width, uint32_t height);
+
+  // resets the depth buffer and drops queued occluders
+  void
+  begin(const glm::mat4& view_projection);
+
+  // queues indexed triangles, transformed by model into the view
+  void
+  add_occluder(
+    const glm::mat4& model,
+    const glm::vec3* positions,
+    const uint32_t*  indices,
+    uint32_t         index_count);
+
+  // bins and rasterizes everything queued since begin
+  void
+  rasterize(JobSystem* jobs = nullptr);
+
+  // conservative, only false when every pixel the world space box covers
+  // holds a closer occluder
+  bool
+  is_visible(const glm::vec3& min, const glm::vec3& max);
+
+  uint32_t
+  get_width() const;
+
+  uint32_t
+  get_height() const;
+
+  const float*
+  get_depth() const;
+
+  // writes the depth buffer as a binary pgm, contrast stretched over the
+  // covered range with near surfaces bright. plain stdio so the culler has
+  // no dependency beyond glm
+  bool
+  dump_depth(const char* path) const;
+
+private:
+  struct Triangle {
+    // edge functions a * x + b * y + c, positive inside
+    glm::vec3 edges[3];
+    // depth plane z = a * x + b * y + c
+    glm::vec3 depth;
+    int32_t   min_x;
+    int32_t   min_y;
+    int32_t   max_x;
+    int32_t   max_y;
+  };
+
+  struct Occluder {
+    glm::mat4        model;
+    const glm::vec3* positions;
+    const uint32_t*  indices;
+    uint32_t         index_count;
+  };
+
+  // triangles set up by one chunk of occluder work and their bin lists,
+  // chunks keep submission order when bins are rasterized
+  struct Chunk {
+    std::vector<Triangle>              triangles;
+    std::vector<std::vector<uint32_t>> bins;
+  };
+
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+  uint32_t m_tiles_x = 0;
+  uint32_t m_tiles_y = 0;
+  uint32_t m_bins_x = 0;
+  uint32_t m_bins_y = 0;
+
+  glm::mat4             m_view_projection = {};
+  std::vector<float>    m_depth;
+  std::vector<float>    m_tile_max;
+  std::vector<Occluder> m_occluders;
+  // first triangle of every occluder, plus the total at the end
+  std::vector<uint32_t> m_triangle_offsets;
+  std::vector<Chunk>    m_chunks;
+
+  void
+  setup_triangles(uint32_t first, uint32_t last, Chunk& chunk);
+
+  void
+  add_triangle(const glm::vec4* clip, Chunk& chunk);
+
+  void
+  add_screen_triangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2, Chunk& chunk);
+
+  void
+  rasterize_bin(uint32_t bin);
+};
@@ -406,13 +406,8 @@ compute_pbr_maps2(ac_device device, ac_image equirectangular, PBRMaps* maps)
 }
 
 ac_result
-compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
+decode_hdr(const std::string& filename, HdrImage* image)
 {
-  void* image_data = NULL;
-
-  ac_buffer staging_buffer = NULL;
-  ac_image  equirectangular = NULL;
-
   size_t   file_length = 0;
   uint8_t* file_data = NULL;
 
@@ -432,19 +427,44 @@ compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
     ac_destroy_file(file);
   }
 
+  int w, h, ch;
+  image->pixels = stbi_loadf_from_memory(
+    file_data,
+    (int)file_length,
+    &w,
+    &h,
+    &ch,
+    STBI_rgb_alpha);
+  image->width = (uint32_t)w;
+  image->height = (uint32_t)h;
+
+  ac_free(file_data);
+
+  if (!image->pixels)
   {
-    int w, h, ch;
-    image_data = stbi_loadf_from_memory(
-      file_data,
-      (int)file_length,
-      &w,
-      &h,
-      &ch,
-      STBI_rgb_alpha);
+    return ac_result_unknown_error;
+  }
+
+  return ac_result_success;
+}
 
+void
+free_hdr(HdrImage* image)
+{
+  stbi_image_free(image->pixels);
+  image->pixels = NULL;
+}
+
+ac_result
+compute_pbr_maps(ac_device device, const HdrImage& hdr, PBRMaps* maps)
+{
+  ac_buffer staging_buffer = NULL;
+  ac_image  equirectangular = NULL;
+
+  {
     ac_image_info image_info = {};
-    image_info.width = (uint32_t)w;
-    image_info.height = (uint32_t)h;
+    image_info.width = hdr.width;
+    image_info.height = hdr.height;
     image_info.format = ac_format_r32g32b32a32_sfloat;
     image_info.layers = 1;
     image_info.levels = 1;
@@ -459,10 +479,11 @@ compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
     uint64_t pixel_size =
       ac_format_size_bytes(ac_image_get_format(equirectangular));
 
-    uint64_t src_row_size = (w * pixel_size);
+    uint64_t src_row_size = (hdr.width * pixel_size);
     uint64_t dst_row_size =
       AC_ALIGN_UP(src_row_size, props.image_row_alignment);
-    uint64_t image_size = AC_ALIGN_UP(dst_row_size * h, props.image_alignment);
+    uint64_t image_size =
+      AC_ALIGN_UP(dst_row_size * hdr.height, props.image_alignment);
 
     ac_buffer_info buffer_info = {};
     buffer_info.memory_usage = ac_memory_usage_cpu_to_gpu;
@@ -473,10 +494,10 @@ compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
     AC_RIF(ac_create_buffer(device, &buffer_info, &staging_buffer));
     ac_buffer_map_memory(staging_buffer);
 
-    const uint8_t* src = (const uint8_t*)image_data;
+    const uint8_t* src = (const uint8_t*)hdr.pixels;
     uint8_t*       dst = (uint8_t*)ac_buffer_get_mapped_memory(staging_buffer);
 
-    for (int32_t i = 0; i < h; ++i)
+    for (uint32_t i = 0; i < hdr.height; ++i)
     {
       memcpy(dst, src, src_row_size);
       dst += dst_row_size;
@@ -552,8 +573,18 @@ compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
   ac_destroy_cmd(cmd);
   ac_destroy_cmd_pool(pool);
 
-  stbi_image_free(image_data);
-  ac_free(file_data);
-
   return ac_result_success;
 }
+
+ac_result
+compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps)
+{
+  HdrImage hdr = {};
+  AC_RIF(decode_hdr(filename, &hdr));
+
+  ac_result res = compute_pbr_maps(device, hdr, maps);
+
+  free_hdr(&hdr);
+
+  return res;
+}
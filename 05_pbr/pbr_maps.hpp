@@ -10,5 +10,23 @@ struct PBRMaps {
   ac_image specular;
 };
 
+// float rgba pixels of a decoded .hdr file
+struct HdrImage {
+  float*   pixels;
+  uint32_t width;
+  uint32_t height;
+};
+
+// cpu only, reads and decodes the file
+ac_result
+decode_hdr(const std::string& filename, HdrImage* image);
+
+void
+free_hdr(HdrImage* image);
+
+// uploads the image and filters the maps on the compute queue, waits for it
+ac_result
+compute_pbr_maps(ac_device device, const HdrImage& hdr, PBRMaps* maps);
+
 ac_result
 compute_pbr_maps(ac_device device, std::string filename, PBRMaps* maps);
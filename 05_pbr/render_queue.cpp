@@ -0,0 +1,188 @@
+#include <string.h>
+#include "render_queue.hpp"
+
+static uint32_t
+depth_bits(float depth)
+{
+  // positive floats keep their order when compared as integers
+  if (!(depth > 0.0f))
+  {
+    return 0;
+  }
+
+  uint32_t bits;
+  memcpy(&bits, &depth, sizeof(bits));
+  return bits;
+}
+
+uint64_t
+RenderQueue::make_key(
+  RenderPass pass,
+  uint32_t   pipeline,
+  uint32_t   material,
+  float      depth)
+{
+  uint64_t key = static_cast<uint64_t>(pass & 0x3) << 62;
+  uint64_t state = (static_cast<uint64_t>(pipeline & 0xff) << 16) |
+                   static_cast<uint64_t>(material & 0xffff);
+
+  return key | (state << 32) | depth_bits(depth);
+}
+
+void
+RenderQueue::clear()
+{
+  items.clear();
+  blend_items.clear();
+  stats = {};
+}
+
+void
+RenderQueue::push(const DrawItem& item)
+{
+  if ((item.key >> 62) == RENDER_PASS_BLEND)
+  {
+    blend_items.push_back(item);
+  }
+  else
+  {
+    items.push_back(item);
+  }
+}
+
+#define SORT_INDEX_BITS 24
+
+void
+RenderQueue::sort(JobSystem* jobs)
+{
+  uint32_t count = static_cast<uint32_t>(items.size());
+  if (count < 2)
+  {
+    return;
+  }
+
+  AC_ASSERT(count <= (1u << SORT_INDEX_BITS));
+
+  m_keys.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    uint64_t key = items[i].key;
+    uint64_t state = ((key >> 62) << 24) | ((key >> 32) & 0xffffff);
+    // the sign bit of a depth is always clear, the exponent and the top of
+    // the mantissa are plenty for front to back
+    uint64_t depth = (key >> 17) & 0x3fff;
+
+    m_keys[i] = (state << 38) | (depth << SORT_INDEX_BITS) | i;
+  }
+
+  m_sorter.sort(m_keys, SORT_INDEX_BITS, 64, jobs);
+
+  m_scratch.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    m_scratch[i] = items[m_keys[i] & ((1u << SORT_INDEX_BITS) - 1)];
+  }
+  items.swap(m_scratch);
+}
+
+void
+RenderQueue::sort_blend(
+  const glm::mat4& view,
+  const glm::mat4* matrices,
+  JobSystem*       jobs)
+{
+  uint32_t count = static_cast<uint32_t>(blend_items.size());
+  if (count < 2)
+  {
+    return;
+  }
+
+  m_keys.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    const DrawItem& item = blend_items[i];
+
+    glm::vec4 world = matrices[item.transform] * glm::vec4(item.center, 1.0f);
+    float     depth = -(view * world).z;
+
+    uint64_t far_first = ~depth_bits(depth) & 0xffffffffull;
+    m_keys[i] = (far_first << 32) | i;
+  }
+
+  m_sorter.sort(m_keys, 32, 64, jobs);
+
+  m_scratch.resize(count);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    m_scratch[i] = blend_items[m_keys[i] & 0xffffffff];
+  }
+  blend_items.swap(m_scratch);
+}
+
+void
+RenderQueue::record(
+  const DrawItem*      draws,
+  CmdStream&           stream,
+  ac_descriptor_buffer db,
+  int32_t              extra_push,
+  uint32_t             first,
+  uint32_t             last,
+  RenderQueueStats&    stats)
+{
+  struct PushData {
+    int32_t material;
+    int32_t node;
+    int32_t extra;
+  };
+
+  ac_pipeline bound_pipeline = NULL;
+  PushData    pushed = {-1, -1, 0};
+
+  for (uint32_t i = first; i < last; ++i)
+  {
+    const DrawItem& item = draws[i];
+
+    if (item.pipeline != bound_pipeline)
+    {
+      stream.bind_pipeline(item.pipeline);
+      stats.pipeline_binds++;
+
+      // sets are bound against the pipeline layout, so they are only
+      // refreshed when the pipeline actually changes
+      stream.bind_frame_set(db, ac_space0);
+      stream.bind_frame_set(db, ac_space1);
+      stream.bind_set(db, ac_space2, 0);
+      stats.set_binds += 3;
+
+      bound_pipeline = item.pipeline;
+      pushed.material = -1;
+    }
+
+    PushData push_data = {};
+    push_data.material = item.material;
+    push_data.node = item.node;
+    push_data.extra = extra_push;
+
+    if (memcmp(&push_data, &pushed, sizeof(push_data)) != 0)
+    {
+      stream.push_constants(sizeof(push_data), &push_data);
+      stats.push_constants++;
+      pushed = push_data;
+    }
+
+    if (item.indexed)
+    {
+      stream.draw_indexed(
+        item.index_count,
+        1,
+        item.first_index,
+        item.vertex_offset,
+        0);
+    }
+    else
+    {
+      stream.draw(item.vertex_count, 1, item.vertex_offset, 0);
+    }
+    stats.draws++;
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <ac/ac.h>
+#include <glm/glm.hpp>
+#include "cmd_stream.hpp"
+#include "radix_sort.hpp"
+
+// sort key layout, most significant first:
+//   pass:2 | pipeline:8 | material:16 | depth:32
+// so state changes are grouped and draws run front to back within a state.
+// blended draws do not use the key, they are kept apart and ordered back to
+// front by view depth every frame
+enum RenderPass : uint32_t {
+  RENDER_PASS_OPAQUE = 0,
+  RENDER_PASS_MASK = 1,
+  RENDER_PASS_BLEND = 2,
+};
+
+struct DrawItem {
+  uint64_t    key;
+  ac_pipeline pipeline;
+  int32_t     material;
+  int32_t     node;
+  uint32_t    first_index;
+  uint32_t    index_count;
+  int32_t     vertex_offset;
+  uint32_t    vertex_count;
+  bool        indexed;
+  // node space point the blend pass sorts by, moved into the world by the
+  // matrix at index transform of the frame
+  glm::vec3   center;
+  uint32_t    transform;
+};
+
+struct RenderQueueStats {
+  uint32_t draws;
+  uint32_t pipeline_binds;
+  uint32_t set_binds;
+  uint32_t push_constants;
+};
+
+struct RenderQueue {
+  // opaque and mask draws sorted by key
+  std::vector<DrawItem> items;
+  // blended draws, back to front after sort_blend
+  std::vector<DrawItem> blend_items;
+  RenderQueueStats      stats = {};
+
+  static uint64_t
+  make_key(
+    RenderPass pass,
+    uint32_t   pipeline,
+    uint32_t   material,
+    float      depth);
+
+  void
+  clear();
+
+  void
+  push(const DrawItem& item);
+
+  // stable sort of the opaque and mask items by key. the sorter only moves
+  // 64 bit keys, so every item gets a compact key of its state, the top 14
+  // bits of its depth and its index:
+  //   pass:2 | pipeline:8 | material:16 | depth:14 | index:24
+  void
+  sort(JobSystem* jobs = nullptr);
+
+  // orders blend_items back to front by the depth of their centers under
+  // the matrices of this frame. every item gets a compact key of its view
+  // depth as 32 bits over its index, only the depth bytes are sorted, so
+  // equal depths keep last frame's order and nothing flickers
+  void
+  sort_blend(
+    const glm::mat4& view,
+    const glm::mat4* matrices,
+    JobSystem*       jobs = nullptr);
+
+  // records draws [first, last) of a sorted list, binding pipelines,
+  // sets and push constants only when they differ from the previous draw.
+  // every range starts from unknown state so ranges can be encoded on
+  // different threads and replayed back to back. extra_push is appended to
+  // every push constant block
+  static void
+  record(
+    const DrawItem*      draws,
+    CmdStream&           stream,
+    ac_descriptor_buffer db,
+    int32_t              extra_push,
+    uint32_t             first,
+    uint32_t             last,
+    RenderQueueStats&    stats);
+
+private:
+  std::vector<DrawItem> m_scratch;
+  std::vector<uint64_t> m_keys;
+  RadixSorter           m_sorter;
+};
@@ -2,6 +2,12 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 #include <ac/ac.h>
+#include "cmd_stream.hpp"
+#include "resize_debouncer.hpp"
+#include "frame_pacer.hpp"
+#include "pipeline_cache.hpp"
+#include "resolution_controller.hpp"
+#include "upscaler.hpp"
 
 #include "compiled/shadow_mapping.h"
 #include "compiled/shadow_mapping_depth.h"
@@ -98,10 +104,13 @@ private:
     ShadowImage = 0,
     ColorImage = 1,
     DepthImage = 2,
+    OutputImage = 3,
   };
 
   bool m_running = {};
-  bool m_window_changed = {};
+
+  ResizeDebouncer m_resize;
+  FramePacer      m_frame_pacer;
 
   ac_wsi m_wsi = {};
 
@@ -114,6 +123,16 @@ private:
   ac_rg       m_rg = {};
   ac_rg_graph m_graph = {};
 
+  // pipelines survive resizes, only a new color format compiles again
+  PipelineCache m_pipeline_cache;
+
+  // the lit pass renders at a scale of the swapchain size picked from the
+  // frame times and is upscaled into the swapchain image
+  ResolutionController m_resolution;
+  Upscaler             m_upscaler;
+  uint32_t             m_render_width = {};
+  uint32_t             m_render_height = {};
+
   ac_dsl               m_shadow_mapping_dsl = {};
   ac_dsl               m_shadow_mapping_depth_dsl = {};
   ac_descriptor_buffer m_db = {};
@@ -135,6 +154,11 @@ private:
 
   UBO m_ubo = {};
 
+  // the scene is static, both passes replay their recorded draws until the
+  // pipelines are recreated
+  CmdStream m_depth_stream = {};
+  CmdStream m_draw_stream = {};
+
   static void
   window_callback(const ac_window_event* event, void* ud);
 
@@ -201,6 +225,23 @@ App::App()
     RIF(ac_create_device(&info, &m_device));
   }
 
+  m_frame_pacer.init(ac_device_get_queue(m_device, ac_queue_type_graphics));
+
+  m_pipeline_cache.init(m_device);
+  {
+    ResolutionControllerInfo info = {};
+    info.vsync = m_frame_pacer.get_vsync();
+    m_resolution.init(info);
+
+#if AC_INCLUDE_DEBUG
+    if (const char* failed = ResolutionController::check())
+    {
+      AC_WARN("resolution controller check failed: %s", failed);
+    }
+#endif
+  }
+  RIF(m_upscaler.init(m_device));
+
   for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
   {
     ac_fence_info info = {};
@@ -429,8 +470,8 @@ App::~App()
     ac_destroy_descriptor_buffer(m_db);
     ac_destroy_dsl(m_shadow_mapping_depth_dsl);
     ac_destroy_dsl(m_shadow_mapping_dsl);
-    ac_destroy_pipeline(m_pipelines.shadow_mapping);
-    ac_destroy_pipeline(m_pipelines.shadow_mapping_depth);
+    m_upscaler.shutdown();
+    m_pipeline_cache.shutdown();
     ac_destroy_shader(m_vs_shadow_mapping_depth_shader);
     ac_destroy_shader(m_vs_shadow_mapping_shader);
     ac_destroy_shader(m_fs_shadow_mapping_shader);
@@ -465,15 +506,17 @@ App::run()
 
   while (m_running)
   {
+    m_frame_pacer.begin_frame();
+
     ac_window_poll_events();
 
-    if (m_window_changed)
+    if (m_resize.should_recreate(ac_get_time(ac_time_unit_milliseconds)))
     {
       if (create_window_dependents() != ac_result_success)
       {
         continue;
       }
-      m_window_changed = false;
+      m_resize.reset();
     }
 
     ac_result res;
@@ -484,7 +527,7 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
@@ -492,10 +535,12 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.begin_present();
+
     ac_queue_present_info queue_present_info = {};
     queue_present_info.wait_fence_count = 1;
     queue_present_info.wait_fences = &m_render_finished_fences[m_frame_index];
@@ -507,10 +552,23 @@ App::run()
 
     if (res != ac_result_success)
     {
-      m_window_changed = true;
+      m_resize.on_swapchain_error(ac_get_time(ac_time_unit_milliseconds));
       continue;
     }
 
+    m_frame_pacer.end_frame();
+
+    // the present interval, execute alone also blocks on the swapchain
+    // under fifo and would follow the refresh rate
+    if (m_resolution.update(m_frame_pacer.get_last_frame().frame_ms))
+    {
+      AC_INFO(
+        "render scale: %.2f smoothed frame: %.3f ms target: %.3f ms",
+        m_resolution.get_scale(),
+        m_resolution.get_smoothed_ms(),
+        m_resolution.get_target_ms());
+    }
+
     m_frame_index = (m_frame_index + 1) % AC_MAX_FRAME_IN_FLIGHT;
   }
 
@@ -525,9 +583,14 @@ App::window_callback(const ac_window_event* event, void* ud)
   switch (event->type)
   {
   case ac_window_event_type_monitor_change:
+  {
+    // the new monitor may want another format
+    p->m_resize.invalidate();
+    break;
+  }
   case ac_window_event_type_resize:
   {
-    p->m_window_changed = true;
+    p->m_resize.on_resize(ac_get_time(ac_time_unit_milliseconds));
     break;
   }
   case ac_window_event_type_close:
@@ -559,20 +622,21 @@ App::create_window_dependents()
   swapchain_info.width = state.width;
   swapchain_info.height = state.height;
 
-  swapchain_info.min_image_count = AC_MAX_FRAME_IN_FLIGHT;
-  swapchain_info.vsync = true;
+  swapchain_info.min_image_count = m_frame_pacer.get_swapchain_image_count();
+  swapchain_info.vsync = m_frame_pacer.get_vsync();
   swapchain_info.queue = ac_device_get_queue(m_device, ac_queue_type_graphics);
   swapchain_info.wsi = &m_wsi;
 
   AC_RIF(ac_create_swapchain(m_device, &swapchain_info, &m_swapchain));
 
   {
-    ac_destroy_pipeline(m_pipelines.shadow_mapping);
-    ac_destroy_pipeline(m_pipelines.shadow_mapping_depth);
+    auto previous = m_pipelines;
 
     ac_image image = ac_swapchain_get_image(m_swapchain);
 
-    ac_pipeline_info info = {};
+    // zeroed with its padding, the cache hashes the info bytewise
+    ac_pipeline_info info;
+    memset(&info, 0, sizeof(info));
     info.type = ac_pipeline_type_graphics;
     info.name = AC_DEBUG_NAME("shadow mapping");
     info.graphics.dsl = m_shadow_mapping_dsl;
@@ -609,7 +673,7 @@ App::create_window_dependents()
     layout->attributes[2].offset = AC_OFFSETOF(Vertex, color);
     layout->attributes[2].semantic = ac_attribute_semantic_color;
 
-    AC_RIF(ac_create_pipeline(m_device, &info, &m_pipelines.shadow_mapping));
+    AC_RIF(m_pipeline_cache.get(info, &m_pipelines.shadow_mapping));
 
     layout->binding_count = 1;
     layout->bindings[0].input_rate = ac_input_rate_vertex;
@@ -632,8 +696,27 @@ App::create_window_dependents()
     info.graphics.pixel_shader = NULL;
     info.graphics.color_attachment_count = 0;
 
-    AC_RIF(
-      ac_create_pipeline(m_device, &info, &m_pipelines.shadow_mapping_depth));
+    AC_RIF(m_pipeline_cache.get(info, &m_pipelines.shadow_mapping_depth));
+
+    AC_RIF(m_upscaler.create_pipeline(
+      m_pipeline_cache,
+      ac_image_get_format(image)));
+
+    // the cached streams reference the pipelines
+    if (
+      previous.shadow_mapping != m_pipelines.shadow_mapping ||
+      previous.shadow_mapping_depth != m_pipelines.shadow_mapping_depth)
+    {
+      m_depth_stream.invalidate();
+      m_draw_stream.invalidate();
+    }
+
+    const PipelineCacheStats& stats = m_pipeline_cache.get_stats();
+    AC_INFO(
+      "pipelines created: %u reused: %u compile time: %.3f ms",
+      stats.misses,
+      stats.hits,
+      stats.create_ms);
   }
 
   return ac_result_success;
@@ -672,17 +755,28 @@ App::shadow_mapping_depth_stage_cmd(ac_rg_stage* stage, void* ud)
     1.0f);
   ac_cmd_set_scissor(cmd, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
 
-  ac_cmd_bind_pipeline(cmd, p->m_pipelines.shadow_mapping_depth);
-  ac_cmd_bind_set(cmd, p->m_db_depth, ac_space0, stage->frame);
-
-  ac_cmd_bind_vertex_buffer(cmd, 0, p->m_cube_vb, 0);
+  CmdStream& stream = p->m_depth_stream;
 
-  for (uint32_t i = 1; i < 4; ++i)
+  if (!stream.valid)
   {
-    ac_cmd_push_constants(cmd, sizeof(i), &i);
-    ac_cmd_draw(cmd, AC_COUNTOF(CUBE_VERTICES), 1, 0, 0);
+    stream.begin();
+
+    stream.bind_pipeline(p->m_pipelines.shadow_mapping_depth);
+    stream.bind_frame_set(p->m_db_depth, ac_space0);
+
+    stream.bind_vertex_buffer(0, p->m_cube_vb, 0);
+
+    for (uint32_t i = 1; i < 4; ++i)
+    {
+      stream.push_constants(sizeof(i), &i);
+      stream.draw(AC_COUNTOF(CUBE_VERTICES), 1, 0, 0);
+    }
+
+    stream.end();
   }
 
+  stream.replay(cmd, stage->frame);
+
   return ac_result_success;
 }
 
@@ -692,9 +786,8 @@ App::shadow_mapping_stage_cmd(ac_rg_stage* stage, void* ud)
   App* p = static_cast<App*>(ud);
 
   ac_cmd   cmd = stage->cmd;
-  ac_image image = ac_swapchain_get_image(p->m_swapchain);
-  uint32_t width = ac_image_get_width(image);
-  uint32_t height = ac_image_get_height(image);
+  uint32_t width = p->m_render_width;
+  uint32_t height = p->m_render_height;
 
   ac_descriptor sampler_descriptor = {};
   sampler_descriptor.sampler = p->m_sampler;
@@ -715,24 +808,35 @@ App::shadow_mapping_stage_cmd(ac_rg_stage* stage, void* ud)
   ac_cmd_set_viewport(cmd, 0, 0, (float)width, (float)height, 0.0f, 1.0f);
   ac_cmd_set_scissor(cmd, 0, 0, width, height);
 
-  ac_cmd_bind_pipeline(cmd, p->m_pipelines.shadow_mapping);
-  ac_cmd_bind_set(cmd, p->m_db, ac_space0, stage->frame);
-  ac_cmd_bind_set(cmd, p->m_db, ac_space1, stage->frame);
+  CmdStream& stream = p->m_draw_stream;
 
-  ac_cmd_bind_vertex_buffer(cmd, 0, p->m_plane_vb, 0);
+  if (!stream.valid)
+  {
+    stream.begin();
 
-  uint32_t i = 0;
-  ac_cmd_push_constants(cmd, sizeof(i), &i);
-  ac_cmd_draw(cmd, AC_COUNTOF(PLANE_VERTICES), 1, 0, 0);
+    stream.bind_pipeline(p->m_pipelines.shadow_mapping);
+    stream.bind_frame_set(p->m_db, ac_space0);
+    stream.bind_frame_set(p->m_db, ac_space1);
 
-  ac_cmd_bind_vertex_buffer(cmd, 0, p->m_cube_vb, 0);
+    stream.bind_vertex_buffer(0, p->m_plane_vb, 0);
 
-  for (i = 1; i < 4; ++i)
-  {
-    ac_cmd_push_constants(cmd, sizeof(i), &i);
-    ac_cmd_draw(cmd, AC_COUNTOF(CUBE_VERTICES), 1, 0, 0);
+    uint32_t i = 0;
+    stream.push_constants(sizeof(i), &i);
+    stream.draw(AC_COUNTOF(PLANE_VERTICES), 1, 0, 0);
+
+    stream.bind_vertex_buffer(0, p->m_cube_vb, 0);
+
+    for (i = 1; i < 4; ++i)
+    {
+      stream.push_constants(sizeof(i), &i);
+      stream.draw(AC_COUNTOF(CUBE_VERTICES), 1, 0, 0);
+    }
+
+    stream.end();
   }
 
+  stream.replay(cmd, stage->frame);
+
   return ac_result_success;
 }
 
@@ -778,9 +882,19 @@ App::build_frame(ac_rg_builder builder, void* ud)
 
   {
     ac_image      image = ac_swapchain_get_image(p->m_swapchain);
-    ac_image_info color = ac_image_get_info(image);
+    ac_image_info output = ac_image_get_info(image);
+
+    p->m_resolution.get_size(
+      output.width,
+      output.height,
+      &p->m_render_width,
+      &p->m_render_height);
+
+    ac_image_info color = output;
+    color.width = p->m_render_width;
+    color.height = p->m_render_height;
     color.clear_value = {{{0.580, 0.659, 0.604, 1.0}}};
-    ac_image_info depth = ac_image_get_info(image);
+    ac_image_info depth = color;
     depth.format = ac_format_d32_sfloat;
     depth.clear_value = {{{1.0f, 0}}};
 
@@ -833,14 +947,28 @@ App::build_frame(ac_rg_builder builder, void* ud)
     use_info.token = App::Token::ShadowImage;
     ac_rg_builder_stage_use_resource(builder, stage, &use_info);
 
+    // at full scale the main stage draws straight into the swapchain
+    // image, the upscale would only copy it
+    ac_rg_builder_resource output_image = color_image;
+
+    if (color.width != output.width || color.height != output.height)
+    {
+      output_image = p->m_upscaler.build(
+        builder,
+        color_image,
+        App::Token::ColorImage,
+        output,
+        App::Token::OutputImage);
+    }
+
     ac_rg_resource_connection connection = {};
-    connection.image = ac_swapchain_get_image(p->m_swapchain);
+    connection.image = image;
     connection.image_layout = ac_image_layout_present_src;
     connection.wait.fence = p->m_acquire_finished_fences[p->m_frame_index];
     connection.signal.fence = p->m_render_finished_fences[p->m_frame_index];
 
     ac_rg_builder_export_resource_info export_info = {};
-    export_info.resource = color_image;
+    export_info.resource = output_image;
     export_info.connection = &connection;
 
     ac_rg_builder_export_resource(builder, &export_info);
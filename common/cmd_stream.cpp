@@ -0,0 +1,273 @@
+#include <string.h>
+#include "cmd_stream.hpp"
+
+enum CmdStreamOp : uint8_t {
+  CMD_STREAM_OP_BIND_PIPELINE,
+  CMD_STREAM_OP_BIND_SET,
+  CMD_STREAM_OP_BIND_FRAME_SET,
+  CMD_STREAM_OP_BIND_VERTEX_BUFFER,
+  CMD_STREAM_OP_BIND_FRAME_VERTEX_BUFFER,
+  CMD_STREAM_OP_BIND_INDEX_BUFFER,
+  CMD_STREAM_OP_PUSH_CONSTANTS,
+  CMD_STREAM_OP_DRAW,
+  CMD_STREAM_OP_DRAW_INDEXED,
+};
+
+template <typename T>
+void
+CmdStream::write(const T& value)
+{
+  size_t offset = data.size();
+  data.resize(offset + sizeof(T));
+  memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static T
+read(const uint8_t*& cursor)
+{
+  T value;
+  memcpy(&value, cursor, sizeof(T));
+  cursor += sizeof(T);
+  return value;
+}
+
+void
+CmdStream::invalidate()
+{
+  valid = false;
+}
+
+void
+CmdStream::begin()
+{
+  data.clear();
+  command_count = 0;
+  valid = false;
+}
+
+void
+CmdStream::end()
+{
+  valid = true;
+}
+
+void
+CmdStream::bind_pipeline(ac_pipeline pipeline)
+{
+  write(CMD_STREAM_OP_BIND_PIPELINE);
+  write(pipeline);
+  command_count++;
+}
+
+void
+CmdStream::bind_set(ac_descriptor_buffer db, ac_space space, uint32_t index)
+{
+  write(CMD_STREAM_OP_BIND_SET);
+  write(db);
+  write(space);
+  write(index);
+  command_count++;
+}
+
+void
+CmdStream::bind_frame_set(ac_descriptor_buffer db, ac_space space)
+{
+  write(CMD_STREAM_OP_BIND_FRAME_SET);
+  write(db);
+  write(space);
+  command_count++;
+}
+
+void
+CmdStream::bind_vertex_buffer(
+  uint32_t  binding,
+  ac_buffer buffer,
+  uint64_t  offset)
+{
+  write(CMD_STREAM_OP_BIND_VERTEX_BUFFER);
+  write(binding);
+  write(buffer);
+  write(offset);
+  command_count++;
+}
+
+void
+CmdStream::bind_frame_vertex_buffer(
+  uint32_t         binding,
+  const ac_buffer* buffers,
+  uint64_t         offset)
+{
+  write(CMD_STREAM_OP_BIND_FRAME_VERTEX_BUFFER);
+  write(binding);
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    write(buffers[i]);
+  }
+  write(offset);
+  command_count++;
+}
+
+void
+CmdStream::bind_index_buffer(
+  ac_buffer     buffer,
+  uint64_t      offset,
+  ac_index_type type)
+{
+  write(CMD_STREAM_OP_BIND_INDEX_BUFFER);
+  write(buffer);
+  write(offset);
+  write(type);
+  command_count++;
+}
+
+void
+CmdStream::push_constants(uint32_t size, const void* src)
+{
+  write(CMD_STREAM_OP_PUSH_CONSTANTS);
+  write(size);
+  size_t offset = data.size();
+  data.resize(offset + size);
+  memcpy(data.data() + offset, src, size);
+  command_count++;
+}
+
+void
+CmdStream::draw(
+  uint32_t vertex_count,
+  uint32_t instance_count,
+  uint32_t first_vertex,
+  uint32_t first_instance)
+{
+  write(CMD_STREAM_OP_DRAW);
+  write(vertex_count);
+  write(instance_count);
+  write(first_vertex);
+  write(first_instance);
+  command_count++;
+}
+
+void
+CmdStream::draw_indexed(
+  uint32_t index_count,
+  uint32_t instance_count,
+  uint32_t first_index,
+  int32_t  vertex_offset,
+  uint32_t first_instance)
+{
+  write(CMD_STREAM_OP_DRAW_INDEXED);
+  write(index_count);
+  write(instance_count);
+  write(first_index);
+  write(vertex_offset);
+  write(first_instance);
+  command_count++;
+}
+
+void
+CmdStream::replay(ac_cmd cmd, uint32_t frame) const
+{
+  const uint8_t* cursor = data.data();
+  const uint8_t* end = cursor + data.size();
+
+  while (cursor < end)
+  {
+    switch (read<CmdStreamOp>(cursor))
+    {
+    case CMD_STREAM_OP_BIND_PIPELINE:
+    {
+      ac_cmd_bind_pipeline(cmd, read<ac_pipeline>(cursor));
+      break;
+    }
+    case CMD_STREAM_OP_BIND_SET:
+    {
+      ac_descriptor_buffer db = read<ac_descriptor_buffer>(cursor);
+      ac_space             space = read<ac_space>(cursor);
+      uint32_t             index = read<uint32_t>(cursor);
+      ac_cmd_bind_set(cmd, db, space, index);
+      break;
+    }
+    case CMD_STREAM_OP_BIND_FRAME_SET:
+    {
+      ac_descriptor_buffer db = read<ac_descriptor_buffer>(cursor);
+      ac_space             space = read<ac_space>(cursor);
+      ac_cmd_bind_set(cmd, db, space, frame);
+      break;
+    }
+    case CMD_STREAM_OP_BIND_VERTEX_BUFFER:
+    {
+      uint32_t  binding = read<uint32_t>(cursor);
+      ac_buffer buffer = read<ac_buffer>(cursor);
+      uint64_t  offset = read<uint64_t>(cursor);
+      ac_cmd_bind_vertex_buffer(cmd, binding, buffer, offset);
+      break;
+    }
+    case CMD_STREAM_OP_BIND_FRAME_VERTEX_BUFFER:
+    {
+      uint32_t  binding = read<uint32_t>(cursor);
+      ac_buffer buffer = NULL;
+      for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+      {
+        ac_buffer b = read<ac_buffer>(cursor);
+        if (i == frame)
+        {
+          buffer = b;
+        }
+      }
+      uint64_t offset = read<uint64_t>(cursor);
+      ac_cmd_bind_vertex_buffer(cmd, binding, buffer, offset);
+      break;
+    }
+    case CMD_STREAM_OP_BIND_INDEX_BUFFER:
+    {
+      ac_buffer     buffer = read<ac_buffer>(cursor);
+      uint64_t      offset = read<uint64_t>(cursor);
+      ac_index_type type = read<ac_index_type>(cursor);
+      ac_cmd_bind_index_buffer(cmd, buffer, offset, type);
+      break;
+    }
+    case CMD_STREAM_OP_PUSH_CONSTANTS:
+    {
+      uint32_t size = read<uint32_t>(cursor);
+      ac_cmd_push_constants(cmd, size, cursor);
+      cursor += size;
+      break;
+    }
+    case CMD_STREAM_OP_DRAW:
+    {
+      uint32_t vertex_count = read<uint32_t>(cursor);
+      uint32_t instance_count = read<uint32_t>(cursor);
+      uint32_t first_vertex = read<uint32_t>(cursor);
+      uint32_t first_instance = read<uint32_t>(cursor);
+      ac_cmd_draw(
+        cmd,
+        vertex_count,
+        instance_count,
+        first_vertex,
+        first_instance);
+      break;
+    }
+    case CMD_STREAM_OP_DRAW_INDEXED:
+    {
+      uint32_t index_count = read<uint32_t>(cursor);
+      uint32_t instance_count = read<uint32_t>(cursor);
+      uint32_t first_index = read<uint32_t>(cursor);
+      int32_t  vertex_offset = read<int32_t>(cursor);
+      uint32_t first_instance = read<uint32_t>(cursor);
+      ac_cmd_draw_indexed(
+        cmd,
+        index_count,
+        instance_count,
+        first_index,
+        vertex_offset,
+        first_instance);
+      break;
+    }
+    default:
+    {
+      AC_ASSERT(false);
+      return;
+    }
+    }
+  }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <ac/ac.h>
+
+// compact cache of draw state commands. a static draw sequence is recorded
+// once and replayed into the stage command buffer every frame, per frame
+// handles are resolved at replay time
+struct CmdStream {
+  std::vector<uint8_t> data;
+  uint32_t             command_count = 0;
+  bool                 valid = false;
+
+  // drops the recorded commands, the owner re-records on next use
+  void
+  invalidate();
+
+  // starts a new recording, replaces the previous one
+  void
+  begin();
+
+  void
+  end();
+
+  void
+  bind_pipeline(ac_pipeline pipeline);
+
+  void
+  bind_set(ac_descriptor_buffer db, ac_space space, uint32_t index);
+
+  // binds set index equal to the frame in flight of the replay
+  void
+  bind_frame_set(ac_descriptor_buffer db, ac_space space);
+
+  void
+  bind_vertex_buffer(uint32_t binding, ac_buffer buffer, uint64_t offset);
+
+  // binds buffers[frame] of the replay
+  void
+  bind_frame_vertex_buffer(
+    uint32_t         binding,
+    const ac_buffer* buffers,
+    uint64_t         offset);
+
+  void
+  bind_index_buffer(ac_buffer buffer, uint64_t offset, ac_index_type type);
+
+  void
+  push_constants(uint32_t size, const void* data);
+
+  void
+  draw(
+    uint32_t vertex_count,
+    uint32_t instance_count,
+    uint32_t first_vertex,
+    uint32_t first_instance);
+
+  void
+  draw_indexed(
+    uint32_t index_count,
+    uint32_t instance_count,
+    uint32_t first_index,
+    int32_t  vertex_offset,
+    uint32_t first_instance);
+
+  void
+  replay(ac_cmd cmd, uint32_t frame) const;
+
+private:
+  template <typename T>
+  void
+  write(const T& value);
+};
@@ -0,0 +1,277 @@
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include "frame_pacer.hpp"
+
+// the low latency sleep ends this much before the gpu is expected to finish
+static const float LOW_LATENCY_MARGIN_MS = 1.0f;
+// weight of the newest frame in the predicted gpu time
+static const float LOW_LATENCY_SMOOTHING = 0.1f;
+
+static const char* PRESENT_MODE_NAMES[] = {
+  "fifo",
+  "uncapped",
+};
+
+static uint64_t
+now_us()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+static float
+elapsed_ms(uint64_t start, uint64_t end)
+{
+  return static_cast<float>(end - start) / 1000.0f;
+}
+
+void
+FramePacer::init(ac_queue queue, uint32_t frames_in_flight)
+{
+  if (!frames_in_flight)
+  {
+    const char* env = getenv(FRAMES_IN_FLIGHT_ENV);
+    frames_in_flight = env ? static_cast<uint32_t>(atoi(env)) : 0;
+
+    if (env && !frames_in_flight)
+    {
+      AC_WARN(
+        "%s=%s is not a frame count, using %u",
+        FRAMES_IN_FLIGHT_ENV,
+        env,
+        AC_MAX_FRAME_IN_FLIGHT);
+    }
+  }
+
+  // the per frame arrays and the slots of the render graph are sized by
+  // the compile time constant, a deeper pipeline needs ac rebuilt
+  if (frames_in_flight > AC_MAX_FRAME_IN_FLIGHT)
+  {
+    AC_WARN(
+      "%u frames in flight requested, ac is built with at most %u, using %u",
+      frames_in_flight,
+      AC_MAX_FRAME_IN_FLIGHT,
+      AC_MAX_FRAME_IN_FLIGHT);
+    frames_in_flight = AC_MAX_FRAME_IN_FLIGHT;
+  }
+
+  if (!frames_in_flight)
+  {
+    frames_in_flight = AC_MAX_FRAME_IN_FLIGHT;
+  }
+
+  m_present_mode = PRESENT_MODE_FIFO;
+
+  if (const char* env = getenv(PRESENT_MODE_ENV))
+  {
+    bool found = false;
+    for (uint32_t i = 0; i < AC_COUNTOF(PRESENT_MODE_NAMES); ++i)
+    {
+      if (strcmp(env, PRESENT_MODE_NAMES[i]) == 0)
+      {
+        m_present_mode = static_cast<PresentMode>(i);
+        found = true;
+      }
+    }
+
+    if (!found)
+    {
+      AC_WARN(
+        "%s=%s is not a present mode, use fifo or uncapped",
+        PRESENT_MODE_ENV,
+        env);
+    }
+  }
+
+  const char* low_latency = getenv(LOW_LATENCY_ENV);
+  m_low_latency = low_latency && atoi(low_latency) != 0;
+
+  // only one frame can be waited for just in time
+  if (m_low_latency)
+  {
+    frames_in_flight = 1;
+  }
+
+  m_queue = queue;
+  m_frames_in_flight = frames_in_flight;
+  m_queued = 0;
+  m_last_end = now_us();
+  m_phase_start = m_last_end;
+  m_timer = 0.0f;
+  m_gpu_ms = 0.0f;
+  m_frame = {};
+  m_last_frame = {};
+  m_stats = {};
+
+  AC_INFO(
+    "frames in flight: %u of %u present mode: %s low latency: %s",
+    m_frames_in_flight,
+    AC_MAX_FRAME_IN_FLIGHT,
+    PRESENT_MODE_NAMES[m_present_mode],
+    m_low_latency ? "on" : "off");
+
+  if (m_present_mode == PRESENT_MODE_UNCAPPED)
+  {
+    AC_INFO("uncapped turns vsync off, the backend picks mailbox or immediate");
+  }
+
+  if (m_frames_in_flight < AC_MAX_FRAME_IN_FLIGHT)
+  {
+    AC_INFO(
+      "frames in flight below %u drain the queue with ac_queue_wait_idle "
+      "every %u frames, they are not a bounded ring of %u slots",
+      AC_MAX_FRAME_IN_FLIGHT,
+      m_frames_in_flight,
+      m_frames_in_flight);
+  }
+}
+
+uint32_t
+FramePacer::get_frames_in_flight() const
+{
+  return m_frames_in_flight;
+}
+
+PresentMode
+FramePacer::get_present_mode() const
+{
+  return m_present_mode;
+}
+
+bool
+FramePacer::get_vsync() const
+{
+  return m_present_mode == PRESENT_MODE_FIFO;
+}
+
+uint32_t
+FramePacer::get_swapchain_image_count() const
+{
+  uint32_t min_count = m_present_mode == PRESENT_MODE_UNCAPPED ? 3 : 2;
+
+  return m_frames_in_flight < min_count ? min_count : m_frames_in_flight;
+}
+
+void
+FramePacer::begin_frame()
+{
+  uint64_t start = now_us();
+
+  // at the full depth the render graph already waits for the frame it
+  // reuses
+  bool drain = m_low_latency || m_frames_in_flight < AC_MAX_FRAME_IN_FLIGHT;
+
+  if (drain && m_queued >= m_frames_in_flight)
+  {
+    if (m_low_latency)
+    {
+      float sleep_ms =
+        m_gpu_ms - LOW_LATENCY_MARGIN_MS - elapsed_ms(m_last_end, start);
+
+      if (sleep_ms > 0.0f)
+      {
+        std::this_thread::sleep_for(
+          std::chrono::microseconds(static_cast<int64_t>(sleep_ms * 1000)));
+      }
+    }
+
+    uint64_t wait_start = now_us();
+    ac_queue_wait_idle(m_queue);
+    uint64_t wait_end = now_us();
+
+    m_queued = 0;
+
+    if (m_low_latency)
+    {
+      float gpu_ms = elapsed_ms(m_last_end, wait_end);
+
+      // a wait that did not block only bounds the gpu time from above,
+      // pull the prediction down so the sleep does not overshoot
+      if (wait_end - wait_start < 50)
+      {
+        gpu_ms -= LOW_LATENCY_MARGIN_MS;
+      }
+
+      if (gpu_ms < 0.0f)
+      {
+        gpu_ms = 0.0f;
+      }
+
+      m_gpu_ms += (gpu_ms - m_gpu_ms) * LOW_LATENCY_SMOOTHING;
+    }
+  }
+
+  uint64_t end = now_us();
+
+  m_frame.wait_ms = elapsed_ms(start, end);
+  m_phase_start = end;
+}
+
+void
+FramePacer::begin_present()
+{
+  uint64_t now = now_us();
+
+  m_frame.record_ms = elapsed_ms(m_phase_start, now);
+  m_phase_start = now;
+}
+
+void
+FramePacer::end_frame()
+{
+  uint64_t end = now_us();
+  float    frame_ms = elapsed_ms(m_last_end, end);
+  m_last_end = end;
+
+  m_frame.present_ms = elapsed_ms(m_phase_start, end);
+  m_frame.frame_ms = frame_ms;
+  m_last_frame = m_frame;
+  m_frame = {};
+  m_queued++;
+
+  m_stats.frames++;
+  m_stats.frame_ms += frame_ms;
+  m_stats.wait_ms += m_last_frame.wait_ms;
+  m_stats.record_ms += m_last_frame.record_ms;
+  m_stats.present_ms += m_last_frame.present_ms;
+  m_timer += frame_ms;
+
+  if (m_timer < 1000.0f)
+  {
+    return;
+  }
+
+  float average = m_stats.frame_ms / m_stats.frames;
+
+  // a frame is shown at most frames in flight frames after its cpu work
+  // started, its input is that old when it reaches the screen
+  AC_INFO(
+    "frames in flight %u: %.1f fps frame %.3f ms latency bound %.3f ms",
+    m_frames_in_flight,
+    1000.0f / average,
+    average,
+    average * m_frames_in_flight);
+  AC_INFO(
+    "wait %.3f ms record %.3f ms present %.3f ms",
+    m_stats.wait_ms / m_stats.frames,
+    m_stats.record_ms / m_stats.frames,
+    m_stats.present_ms / m_stats.frames);
+
+  m_stats = {};
+  m_timer = 0.0f;
+}
+
+const FrameTimings&
+FramePacer::get_last_frame() const
+{
+  return m_last_frame;
+}
+
+const FramePacerStats&
+FramePacer::get_stats() const
+{
+  return m_stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <ac/ac.h>
+
+// environment variable holding the frames in flight count
+#define FRAMES_IN_FLIGHT_ENV "AC_FRAMES_IN_FLIGHT"
+// environment variable holding the present mode: fifo or uncapped
+#define PRESENT_MODE_ENV "AC_PRESENT_MODE"
+// environment variable enabling the low latency mode when set to 1
+#define LOW_LATENCY_ENV "AC_LOW_LATENCY"
+
+// ac only exposes vsync on the swapchain, so these are the only two modes
+// an example can ask for
+enum PresentMode : uint8_t {
+  // waits for vblank, never tears, frame rate capped at the refresh rate
+  PRESENT_MODE_FIFO,
+  // vsync off, the backend picks mailbox or immediate, so it may tear
+  PRESENT_MODE_UNCAPPED,
+};
+
+// cpu time of the phases of one frame
+struct FrameTimings {
+  // blocked on the gpu, including the low latency sleep
+  float wait_ms;
+  // input, simulation, acquire and graph execute, which records and
+  // submits
+  float record_ms;
+  // the present call
+  float present_ms;
+  // cpu time since the previous present. under fifo this is the present
+  // interval, a whole number of refresh periods
+  float frame_ms;
+};
+
+struct FramePacerStats {
+  uint32_t frames;
+  // cpu time between presents, summed since the last report
+  float    frame_ms;
+  // phase times, summed since the last report
+  float    wait_ms;
+  float    record_ms;
+  float    present_ms;
+};
+
+// limits how many frames the cpu runs ahead of the gpu. the count is read
+// once at startup and clamped to [1, AC_MAX_FRAME_IN_FLIGHT], larger counts
+// are reported and capped. the per frame arrays keep their compile time
+// capacity because the render graph hands out frame indices up to it, so
+// only the full depth is a real ring. 1 or 2 keep input latency low, the
+// full depth keeps the gpu busy. below the full depth the pacer drains the
+// queue with ac_queue_wait_idle every count frames, so no more than count
+// frames are ever queued, but the gpu also idles once per drain. the drain
+// happens in begin_frame, before the frame samples its input.
+//
+// the low latency mode runs one frame in flight and sleeps until shortly
+// before the previous frame is expected to finish, predicted from how long
+// earlier frames took after their present. the wait that follows is short
+// and the input read after it is as fresh as the gpu allows. once a second
+// the pacer logs throughput, phase times and the latency bound
+class FramePacer {
+public:
+  // frames_in_flight 0 reads FRAMES_IN_FLIGHT_ENV and falls back to
+  // AC_MAX_FRAME_IN_FLIGHT. the present mode and low latency mode are read
+  // from their environment variables
+  void
+  init(ac_queue queue, uint32_t frames_in_flight = 0);
+
+  uint32_t
+  get_frames_in_flight() const;
+
+  PresentMode
+  get_present_mode() const;
+
+  bool
+  get_vsync() const;
+
+  // swapchains need at least two images even at a depth of one. uncapped
+  // asks for a third, so a backend that picks mailbox has an image to
+  // replace
+  uint32_t
+  get_swapchain_image_count() const;
+
+  // call at the top of the frame, before input is polled
+  void
+  begin_frame();
+
+  // call right before present
+  void
+  begin_present();
+
+  // call once after every successful present
+  void
+  end_frame();
+
+  // timings of the last presented frame
+  const FrameTimings&
+  get_last_frame() const;
+
+  const FramePacerStats&
+  get_stats() const;
+
+private:
+  ac_queue    m_queue = NULL;
+  uint32_t    m_frames_in_flight = AC_MAX_FRAME_IN_FLIGHT;
+  PresentMode m_present_mode = PRESENT_MODE_FIFO;
+  bool        m_low_latency = false;
+  // frames presented since the queue was last drained
+  uint32_t    m_queued = 0;
+  uint64_t    m_last_end = 0;
+  uint64_t    m_phase_start = 0;
+  float       m_timer = 0.0f;
+  // smoothed time from present until the gpu finished the frame
+  float       m_gpu_ms = 0.0f;
+
+  FrameTimings    m_frame = {};
+  FrameTimings    m_last_frame = {};
+  FramePacerStats m_stats = {};
+};
@@ -0,0 +1,189 @@
+#include "graph_description.hpp"
+
+void
+GraphDescription::invalidate()
+{
+  valid = false;
+}
+
+void
+GraphDescription::begin()
+{
+  m_ops.clear();
+  m_stages.clear();
+  m_images.clear();
+  m_buffers.clear();
+  m_uses.clear();
+  m_exports.clear();
+  m_resource_count = 0;
+  valid = false;
+}
+
+void
+GraphDescription::end()
+{
+  valid = true;
+}
+
+GraphDescription::Stage
+GraphDescription::create_stage(const ac_rg_builder_stage_info& info)
+{
+  Op op = {};
+  op.type = OP_TYPE_STAGE;
+  op.data = static_cast<uint32_t>(m_stages.size());
+  m_ops.push_back(op);
+
+  m_stages.push_back(info);
+
+  return op.data;
+}
+
+GraphDescription::Resource
+GraphDescription::create_image(const ac_image_info& info, bool do_clear)
+{
+  Op op = {};
+  op.type = OP_TYPE_IMAGE;
+  op.do_clear = do_clear;
+  op.resource = m_resource_count++;
+  op.data = static_cast<uint32_t>(m_images.size());
+  m_ops.push_back(op);
+
+  m_images.push_back(info);
+
+  return op.resource;
+}
+
+GraphDescription::Resource
+GraphDescription::create_buffer(const ac_buffer_info& info, bool do_clear)
+{
+  Op op = {};
+  op.type = OP_TYPE_BUFFER;
+  op.do_clear = do_clear;
+  op.resource = m_resource_count++;
+  op.data = static_cast<uint32_t>(m_buffers.size());
+  m_ops.push_back(op);
+
+  m_buffers.push_back(info);
+
+  return op.resource;
+}
+
+GraphDescription::Resource
+GraphDescription::use_resource(
+  Stage                                        stage,
+  Resource                                     resource,
+  const ac_rg_builder_stage_use_resource_info& info)
+{
+  Op op = {};
+  op.type = OP_TYPE_USE;
+  op.stage = stage;
+  op.resource = resource;
+  op.data = static_cast<uint32_t>(m_uses.size());
+  m_ops.push_back(op);
+
+  m_uses.push_back(info);
+
+  // every use produces a new version, numbered like created resources
+  return m_resource_count++;
+}
+
+void
+GraphDescription::export_swapchain(
+  Resource        resource,
+  ac_swapchain    swapchain,
+  ac_image_layout layout,
+  const ac_fence* wait_fences,
+  const ac_fence* signal_fences)
+{
+  Op op = {};
+  op.type = OP_TYPE_EXPORT;
+  op.resource = resource;
+  op.data = static_cast<uint32_t>(m_exports.size());
+  m_ops.push_back(op);
+
+  Export e = {};
+  e.swapchain = swapchain;
+  e.layout = layout;
+  e.wait_fences = wait_fences;
+  e.signal_fences = signal_fences;
+  m_exports.push_back(e);
+}
+
+void
+GraphDescription::replay(ac_rg_builder builder, uint32_t frame)
+{
+  m_stage_handles.resize(m_stages.size());
+  m_resource_handles.resize(m_resource_count);
+
+  uint32_t next_resource = 0;
+
+  for (const Op& op : m_ops)
+  {
+    switch (op.type)
+    {
+    case OP_TYPE_STAGE:
+    {
+      m_stage_handles[op.data] =
+        ac_rg_builder_create_stage(builder, &m_stages[op.data]);
+      break;
+    }
+    case OP_TYPE_IMAGE:
+    case OP_TYPE_BUFFER:
+    {
+      // the builder keeps the info pointers only for the call, a copy is
+      // taken so the description stays untouched
+      ac_image_info  image = {};
+      ac_buffer_info buffer = {};
+
+      ac_rg_builder_create_resource_info info = {};
+      if (op.type == OP_TYPE_IMAGE)
+      {
+        image = m_images[op.data];
+        info.image_info = &image;
+      }
+      else
+      {
+        buffer = m_buffers[op.data];
+        info.buffer_info = &buffer;
+      }
+      info.do_clear = op.do_clear;
+
+      m_resource_handles[next_resource++] =
+        ac_rg_builder_create_resource(builder, &info);
+      break;
+    }
+    case OP_TYPE_USE:
+    {
+      ac_rg_builder_stage_use_resource_info info = m_uses[op.data];
+      info.resource = m_resource_handles[op.resource];
+
+      m_resource_handles[next_resource++] = ac_rg_builder_stage_use_resource(
+        builder,
+        m_stage_handles[op.stage],
+        &info);
+      break;
+    }
+    case OP_TYPE_EXPORT:
+    {
+      const Export& e = m_exports[op.data];
+
+      ac_rg_resource_connection connection = {};
+      connection.image = ac_swapchain_get_image(e.swapchain);
+      connection.image_layout = e.layout;
+      connection.wait.fence = e.wait_fences[frame];
+      connection.signal.fence = e.signal_fences[frame];
+
+      ac_rg_builder_export_resource_info info = {};
+      info.resource = m_resource_handles[op.resource];
+      info.connection = &connection;
+
+      ac_rg_builder_export_resource(builder, &info);
+      break;
+    }
+    default:
+    {
+      break;
+    }
+    }
+  }
+}
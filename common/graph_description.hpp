@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vector>
+#include <ac/ac.h>
+
+// plain data copy of a render graph build. the stages, resources and exports
+// are described once and replayed into the builder every ac_rg_graph_execute
+// hands out, so the frame does not query swapchain images and fill infos
+// again. per frame fences and the acquired swapchain image are resolved at
+// replay time, the owner only describes again when the inputs of the graph
+// change, e.g. the swapchain was recreated
+struct GraphDescription {
+  typedef uint32_t Stage;
+  typedef uint32_t Resource;
+
+  bool valid = false;
+
+  // drops the description, the owner describes again on next build
+  void
+  invalidate();
+
+  // starts a new description, replaces the previous one
+  void
+  begin();
+
+  void
+  end();
+
+  Stage
+  create_stage(const ac_rg_builder_stage_info& info);
+
+  Resource
+  create_image(const ac_image_info& info, bool do_clear);
+
+  Resource
+  create_buffer(const ac_buffer_info& info, bool do_clear);
+
+  // info.resource is ignored, returns the version of resource written by
+  // the stage
+  Resource
+  use_resource(
+    Stage                                        stage,
+    Resource                                     resource,
+    const ac_rg_builder_stage_use_resource_info& info);
+
+  // exports resource to the image acquired from swapchain, waits on
+  // wait_fences[frame] and signals signal_fences[frame] of the replay
+  void
+  export_swapchain(
+    Resource        resource,
+    ac_swapchain    swapchain,
+    ac_image_layout layout,
+    const ac_fence* wait_fences,
+    const ac_fence* signal_fences);
+
+  void
+  replay(ac_rg_builder builder, uint32_t frame);
+
+private:
+  enum OpType : uint8_t {
+    OP_TYPE_STAGE,
+    OP_TYPE_IMAGE,
+    OP_TYPE_BUFFER,
+    OP_TYPE_USE,
+    OP_TYPE_EXPORT,
+  };
+
+  struct Op {
+    OpType   type;
+    bool     do_clear;
+    Stage    stage;
+    Resource resource;
+    // index into the array of the op type
+    uint32_t data;
+  };
+
+  struct Export {
+    ac_swapchain    swapchain;
+    ac_image_layout layout;
+    const ac_fence* wait_fences;
+    const ac_fence* signal_fences;
+  };
+
+  std::vector<Op>                                    m_ops;
+  std::vector<ac_rg_builder_stage_info>              m_stages;
+  std::vector<ac_image_info>                         m_images;
+  std::vector<ac_buffer_info>                        m_buffers;
+  std::vector<ac_rg_builder_stage_use_resource_info> m_uses;
+  std::vector<Export>                                m_exports;
+  uint32_t                                           m_resource_count = 0;
+
+  // builder handles of the current replay, indexed by Stage and Resource
+  std::vector<ac_rg_builder_stage>    m_stage_handles;
+  std::vector<ac_rg_builder_resource> m_resource_handles;
+};
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include "job_system.hpp"
+
+JobSystem::~JobSystem()
+{
+  shutdown();
+}
+
+void
+JobSystem::init(uint32_t thread_count)
+{
+  shutdown();
+
+  if (thread_count == 0)
+  {
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  m_stop = false;
+
+  for (uint32_t i = 1; i < thread_count; ++i)
+  {
+    m_workers.emplace_back(&JobSystem::worker_main, this, i);
+  }
+}
+
+void
+JobSystem::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  for (std::thread& worker : m_workers)
+  {
+    worker.join();
+  }
+
+  m_workers.clear();
+  m_queue.clear();
+}
+
+uint32_t
+JobSystem::get_thread_count() const
+{
+  return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+void
+JobSystem::submit(JobCounter& counter, Job job)
+{
+  counter.pending.fetch_add(1);
+
+  // without workers the job runs inline, keeps single core machines simple
+  if (m_workers.empty())
+  {
+    job(0);
+    counter.pending.fetch_sub(1);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.push_back({&counter, std::move(job)});
+  }
+  m_cv.notify_one();
+}
+
+bool
+JobSystem::run_one(uint32_t thread_index)
+{
+  Entry entry;
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_queue.empty())
+    {
+      return false;
+    }
+    entry = std::move(m_queue.front());
+    m_queue.pop_front();
+  }
+
+  entry.job(thread_index);
+  entry.counter->pending.fetch_sub(1);
+
+  return true;
+}
+
+void
+JobSystem::wait(JobCounter& counter)
+{
+  while (counter.pending.load() > 0)
+  {
+    if (!run_one(0))
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+void
+JobSystem::worker_main(uint32_t thread_index)
+{
+  for (;;)
+  {
+    Entry entry;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+      if (m_queue.empty())
+      {
+        return;
+      }
+
+      entry = std::move(m_queue.front());
+      m_queue.pop_front();
+    }
+
+    entry.job(thread_index);
+    entry.counter->pending.fetch_sub(1);
+  }
+}
+
+void
+JobSystem::parallel_for(
+  uint32_t                                                 count,
+  uint32_t                                                 chunk_size,
+  const std::function<void(uint32_t, uint32_t, uint32_t)>& fn)
+{
+  if (count == 0)
+  {
+    return;
+  }
+
+  chunk_size = std::max(chunk_size, 1u);
+
+  JobCounter counter;
+
+  for (uint32_t first = 0; first < count; first += chunk_size)
+  {
+    uint32_t last = std::min(first + chunk_size, count);
+    submit(
+      counter,
+      [&fn, first, last](uint32_t thread_index)
+      { fn(first, last, thread_index); });
+  }
+
+  wait(counter);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// counts outstanding jobs of one submission, wait on it to join them
+struct JobCounter {
+  std::atomic<uint32_t> pending {0};
+};
+
+// fixed pool of worker threads with a shared fifo queue. thread index 0 is
+// the thread that calls wait or parallel_for, workers use 1..count-1 so
+// callers can keep per-thread data without locking
+class JobSystem {
+public:
+  using Job = std::function<void(uint32_t thread_index)>;
+
+  JobSystem() = default;
+  ~JobSystem();
+
+  JobSystem(const JobSystem&) = delete;
+  JobSystem&
+  operator=(const JobSystem&) = delete;
+
+  // thread_count includes the calling thread, 0 picks the hardware count
+  void
+  init(uint32_t thread_count = 0);
+
+  void
+  shutdown();
+
+  uint32_t
+  get_thread_count() const;
+
+  void
+  submit(JobCounter& counter, Job job);
+
+  // runs queued jobs on the calling thread until counter drops to zero
+  void
+  wait(JobCounter& counter);
+
+  // splits [0, count) into chunks of chunk_size and blocks until every
+  // chunk ran. fn receives first, last and the executing thread index
+  void
+  parallel_for(
+    uint32_t                                                 count,
+    uint32_t                                                 chunk_size,
+    const std::function<void(uint32_t, uint32_t, uint32_t)>& fn);
+
+private:
+  struct Entry {
+    JobCounter* counter;
+    Job         job;
+  };
+
+  std::vector<std::thread> m_workers;
+  std::deque<Entry>        m_queue;
+  std::mutex               m_mutex;
+  std::condition_variable  m_cv;
+  bool                     m_stop = false;
+
+  void
+  worker_main(uint32_t thread_index);
+
+  bool
+  run_one(uint32_t thread_index);
+};
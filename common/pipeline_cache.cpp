@@ -0,0 +1,212 @@
+#include <chrono>
+#include <string.h>
+#include "pipeline_cache.hpp"
+
+// copied bytewise so padding is compared as the caller zeroed it
+static void
+get_key(const ac_pipeline_info& info, ac_pipeline_info* key)
+{
+  memcpy(key, &info, sizeof(info));
+  key->name = NULL;
+}
+
+static uint64_t
+hash(const ac_pipeline_info& key)
+{
+  // fnv-1a
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&key);
+  uint64_t       h = 14695981039346656037ull;
+  for (size_t i = 0; i < sizeof(key); ++i)
+  {
+    h ^= bytes[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+void
+PipelineCache::init(ac_device device)
+{
+  m_device = device;
+  m_entries.clear();
+  m_queue.clear();
+  m_stop = false;
+  m_stats = {};
+}
+
+void
+PipelineCache::shutdown()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  if (m_thread.joinable())
+  {
+    m_thread.join();
+  }
+
+  for (auto& it : m_entries)
+  {
+    if (it.second.state == ENTRY_STATE_READY)
+    {
+      ac_destroy_pipeline(it.second.pipeline);
+    }
+  }
+  m_entries.clear();
+  m_queue.clear();
+}
+
+ac_result
+PipelineCache::get(const ac_pipeline_info& info, ac_pipeline* pipeline)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  bool   inserted = false;
+  Entry* entry = find_or_insert(info, &inserted);
+
+  if (!inserted)
+  {
+    m_cv.wait(lock, [entry] { return entry->state != ENTRY_STATE_PENDING; });
+
+    if (entry->state == ENTRY_STATE_READY)
+    {
+      m_stats.hits++;
+      *pipeline = entry->pipeline;
+      return ac_result_success;
+    }
+
+    // a failed compile is retried by the next blocking request
+    entry->state = ENTRY_STATE_PENDING;
+  }
+
+  entry->name = info.name;
+
+  AC_RIF(compile(lock, entry));
+
+  *pipeline = entry->pipeline;
+
+  return ac_result_success;
+}
+
+ac_pipeline
+PipelineCache::request(const ac_pipeline_info& info)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  bool   inserted = false;
+  Entry* entry = find_or_insert(info, &inserted);
+
+  if (!inserted)
+  {
+    return entry->state == ENTRY_STATE_READY ? entry->pipeline : NULL;
+  }
+
+  entry->name = info.name;
+  m_queue.push_back(entry);
+
+  if (!m_thread.joinable())
+  {
+    m_thread = std::thread(&PipelineCache::thread_main, this);
+  }
+
+  lock.unlock();
+  m_cv.notify_all();
+
+  return NULL;
+}
+
+PipelineCacheStats
+PipelineCache::get_stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+PipelineCache::Entry*
+PipelineCache::find_or_insert(const ac_pipeline_info& info, bool* inserted)
+{
+  ac_pipeline_info key;
+  get_key(info, &key);
+
+  uint64_t h = hash(key);
+
+  auto range = m_entries.equal_range(h);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (memcmp(&it->second.info, &key, sizeof(key)) == 0)
+    {
+      *inserted = false;
+      return &it->second;
+    }
+  }
+
+  Entry entry = {};
+  memcpy(&entry.info, &key, sizeof(key));
+  entry.state = ENTRY_STATE_PENDING;
+
+  *inserted = true;
+  return &m_entries.emplace(h, entry)->second;
+}
+
+ac_result
+PipelineCache::compile(std::unique_lock<std::mutex>& lock, Entry* entry)
+{
+  // the key has no name, the compiled pipeline should keep it
+  ac_pipeline_info info;
+  memcpy(&info, &entry->info, sizeof(info));
+  info.name = entry->name;
+
+  lock.unlock();
+
+  auto start = std::chrono::steady_clock::now();
+
+  ac_pipeline pipeline = NULL;
+  ac_result   res = ac_create_pipeline(m_device, &info, &pipeline);
+
+  std::chrono::duration<float, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  lock.lock();
+
+  m_stats.create_ms += elapsed.count();
+  m_stats.misses++;
+
+  entry->pipeline = pipeline;
+  entry->state =
+    res == ac_result_success ? ENTRY_STATE_READY : ENTRY_STATE_FAILED;
+
+  m_cv.notify_all();
+
+  return res;
+}
+
+void
+PipelineCache::thread_main()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+
+    if (m_stop)
+    {
+      return;
+    }
+
+    Entry* entry = m_queue.front();
+    m_queue.pop_front();
+
+    if (compile(lock, entry) == ac_result_success)
+    {
+      m_stats.background++;
+    }
+    else
+    {
+      AC_WARN("background pipeline compile failed");
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <ac/ac.h>
+
+struct PipelineCacheStats {
+  // requests served by an existing pipeline
+  uint32_t hits;
+  // requests that compiled a new pipeline
+  uint32_t misses;
+  // misses that were compiled by the background thread
+  uint32_t background;
+  // time spent in ac_create_pipeline since init, summed over threads
+  float    create_ms;
+};
+
+// owns graphics and compute pipelines keyed on their full description, the
+// debug name excluded. recreating the swapchain asks for the same pipelines
+// again and gets the existing ones back unless the color format changed.
+// infos are hashed and compared bytewise, padding included, so callers
+// memset them and write every member in place. = {} and struct copies
+// leave padding undefined and would miss the cache. every call is thread
+// safe, a pipeline that is being compiled is never compiled a second time
+class PipelineCache {
+public:
+  void
+  init(ac_device device);
+
+  // joins the background thread and destroys every pipeline the cache
+  // created
+  void
+  shutdown();
+
+  // compiles on the calling thread, or waits for another thread that is
+  // compiling the same pipeline
+  ac_result
+  get(const ac_pipeline_info& info, ac_pipeline* pipeline);
+
+  // never blocks on a compile. returns the pipeline once it exists,
+  // otherwise queues it for the background thread and returns NULL. a
+  // pipeline that failed to compile keeps returning NULL. info.name has to
+  // outlive the compile
+  ac_pipeline
+  request(const ac_pipeline_info& info);
+
+  PipelineCacheStats
+  get_stats() const;
+
+private:
+  enum EntryState : uint8_t {
+    ENTRY_STATE_PENDING,
+    ENTRY_STATE_READY,
+    ENTRY_STATE_FAILED,
+  };
+
+  struct Entry {
+    ac_pipeline_info info;
+    const char*      name;
+    ac_pipeline      pipeline;
+    EntryState       state;
+  };
+
+  ac_device m_device = NULL;
+
+  mutable std::mutex      m_mutex;
+  // signaled whenever an entry leaves the pending state or work is queued
+  std::condition_variable m_cv;
+
+  // elements keep their address on insert, so entries are referenced by
+  // pointer while the lock is dropped
+  std::unordered_multimap<uint64_t, Entry> m_entries;
+  std::deque<Entry*>                       m_queue;
+  std::thread                              m_thread;
+  bool                                     m_stop = false;
+
+  PipelineCacheStats m_stats = {};
+
+  // returns the entry of info, inserts a pending one when there is none
+  Entry*
+  find_or_insert(const ac_pipeline_info& info, bool* inserted);
+
+  // compiles entry with the lock dropped and wakes everyone waiting on it
+  ac_result
+  compile(std::unique_lock<std::mutex>& lock, Entry* entry);
+
+  void
+  thread_main();
+};
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include "radix_sort.hpp"
+
+void
+RadixSorter::sort(
+  std::vector<uint64_t>& keys,
+  uint32_t               first_bit,
+  uint32_t               last_bit,
+  JobSystem*             jobs)
+{
+  uint32_t count = static_cast<uint32_t>(keys.size());
+  if (count < 2)
+  {
+    return;
+  }
+
+  m_scratch.resize(count);
+
+  uint64_t* src = keys.data();
+  uint64_t* dst = m_scratch.data();
+
+  bool parallel =
+    jobs && jobs->get_thread_count() > 1 && count >= PARALLEL_THRESHOLD;
+
+  last_bit = std::min(last_bit, 64u);
+  for (uint32_t shift = first_bit & ~7u; shift < last_bit; shift += 8)
+  {
+    bool moved = parallel ? pass_parallel(src, dst, count, shift, jobs)
+                          : pass_serial(src, dst, count, shift);
+    if (moved)
+    {
+      std::swap(src, dst);
+    }
+  }
+
+  if (src != keys.data())
+  {
+    keys.swap(m_scratch);
+  }
+}
+
+bool
+RadixSorter::pass_serial(
+  const uint64_t* src,
+  uint64_t*       dst,
+  uint32_t        count,
+  uint32_t        shift)
+{
+  uint32_t offsets[256] = {};
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    offsets[(src[i] >> shift) & 0xff]++;
+  }
+
+  if (offsets[(src[0] >> shift) & 0xff] == count)
+  {
+    return false;
+  }
+
+  uint32_t sum = 0;
+  for (uint32_t b = 0; b < 256; ++b)
+  {
+    uint32_t c = offsets[b];
+    offsets[b] = sum;
+    sum += c;
+  }
+
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    dst[offsets[(src[i] >> shift) & 0xff]++] = src[i];
+  }
+
+  return true;
+}
+
+bool
+RadixSorter::pass_parallel(
+  const uint64_t* src,
+  uint64_t*       dst,
+  uint32_t        count,
+  uint32_t        shift,
+  JobSystem*      jobs)
+{
+  uint32_t chunk_count = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  m_histograms.assign(chunk_count * 256, 0);
+
+  jobs->parallel_for(
+    count,
+    CHUNK_SIZE,
+    [&](uint32_t first, uint32_t last, uint32_t)
+    {
+      uint32_t* histogram = &m_histograms[first / CHUNK_SIZE * 256];
+      for (uint32_t i = first; i < last; ++i)
+      {
+        histogram[(src[i] >> shift) & 0xff]++;
+      }
+    });
+
+  uint32_t digit = (src[0] >> shift) & 0xff;
+  uint32_t digit_total = 0;
+  for (uint32_t c = 0; c < chunk_count; ++c)
+  {
+    digit_total += m_histograms[c * 256 + digit];
+  }
+
+  if (digit_total == count)
+  {
+    return false;
+  }
+
+  // digit major, chunk minor, so every chunk scatters behind the earlier
+  // chunks with the same digit and the pass stays stable
+  uint32_t sum = 0;
+  for (uint32_t b = 0; b < 256; ++b)
+  {
+    for (uint32_t c = 0; c < chunk_count; ++c)
+    {
+      uint32_t& slot = m_histograms[c * 256 + b];
+      uint32_t  n = slot;
+      slot = sum;
+      sum += n;
+    }
+  }
+
+  jobs->parallel_for(
+    count,
+    CHUNK_SIZE,
+    [&](uint32_t first, uint32_t last, uint32_t)
+    {
+      uint32_t* offsets = &m_histograms[first / CHUNK_SIZE * 256];
+      for (uint32_t i = first; i < last; ++i)
+      {
+        dst[offsets[(src[i] >> shift) & 0xff]++] = src[i];
+      }
+    });
+
+  return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "job_system.hpp"
+
+// stable lsd radix sort of 64 bit keys, one byte per pass. only the bytes
+// covering [first_bit, last_bit) are sorted on, so keys that carry a
+// payload such as an item index in their low bits keep it in submission
+// order. scratch and histogram storage is kept between calls
+class RadixSorter {
+public:
+  // below this many keys the job system is not worth the submission cost
+  static constexpr uint32_t PARALLEL_THRESHOLD = 16384;
+  static constexpr uint32_t CHUNK_SIZE = 4096;
+
+  void
+  sort(
+    std::vector<uint64_t>& keys,
+    uint32_t               first_bit = 0,
+    uint32_t               last_bit = 64,
+    JobSystem*             jobs = nullptr);
+
+private:
+  std::vector<uint64_t> m_scratch;
+  // 256 counters per chunk, turned into scatter offsets in place
+  std::vector<uint32_t> m_histograms;
+
+  // one byte pass from src to dst, false when every key shares the byte
+  // and the pass was skipped
+  bool
+  pass_serial(
+    const uint64_t* src,
+    uint64_t*       dst,
+    uint32_t        count,
+    uint32_t        shift);
+
+  bool
+  pass_parallel(
+    const uint64_t* src,
+    uint64_t*       dst,
+    uint32_t        count,
+    uint32_t        shift,
+    JobSystem*      jobs);
+};
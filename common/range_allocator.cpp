@@ -0,0 +1,315 @@
+#include <algorithm>
+#include "range_allocator.hpp"
+
+static uint32_t
+find_msb(uint32_t value)
+{
+  uint32_t bit = 0;
+  while (value >>= 1)
+  {
+    bit++;
+  }
+  return bit;
+}
+
+static uint32_t
+find_lsb(uint32_t value)
+{
+  uint32_t bit = 0;
+  while (!(value & 1))
+  {
+    value >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+void
+RangeAllocator::init(uint32_t capacity)
+{
+  m_capacity = capacity;
+  m_used = 0;
+  m_blocks.clear();
+  m_unused.clear();
+  m_allocated.clear();
+  m_fl_bitmap = 0;
+
+  for (uint32_t fl = 0; fl < FL_COUNT; ++fl)
+  {
+    m_sl_bitmap[fl] = 0;
+    for (uint32_t sl = 0; sl < SL_COUNT; ++sl)
+    {
+      m_heads[fl][sl] = NONE;
+    }
+  }
+
+  if (capacity == 0)
+  {
+    return;
+  }
+
+  uint32_t block = new_block();
+  m_blocks[block].offset = 0;
+  m_blocks[block].size = capacity;
+  insert_free(block);
+}
+
+uint32_t
+RangeAllocator::allocate(uint32_t size)
+{
+  if (size == 0 || size > m_capacity - m_used)
+  {
+    return INVALID_OFFSET;
+  }
+
+  // round up to the next class boundary so every block of the class found
+  // below is large enough
+  uint32_t search = size;
+  if (search >= SL_COUNT)
+  {
+    uint32_t round = (1u << (find_msb(search) - SL_BITS)) - 1;
+    if (search > UINT32_MAX - round)
+    {
+      return INVALID_OFFSET;
+    }
+    search += round;
+  }
+
+  uint32_t fl, sl;
+  mapping(search, fl, sl);
+
+  uint32_t block = NONE;
+  uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+  if (!sl_map)
+  {
+    uint32_t fl_map = fl + 1 < FL_COUNT ? m_fl_bitmap & (~0u << (fl + 1)) : 0;
+    if (fl_map)
+    {
+      fl = find_lsb(fl_map);
+      sl_map = m_sl_bitmap[fl];
+    }
+  }
+
+  if (sl_map)
+  {
+    block = m_heads[fl][find_lsb(sl_map)];
+  }
+  else
+  {
+    // only the class of size itself is left, its blocks may still fit
+    mapping(size, fl, sl);
+    for (block = m_heads[fl][sl]; block != NONE;
+         block = m_blocks[block].next_free)
+    {
+      if (m_blocks[block].size >= size)
+      {
+        break;
+      }
+    }
+  }
+
+  if (block == NONE)
+  {
+    return INVALID_OFFSET;
+  }
+
+  remove_free(block);
+
+  // the remainder goes back as its own free block
+  if (m_blocks[block].size > size)
+  {
+    uint32_t rest = new_block();
+    Block&   b = m_blocks[block];
+    Block&   r = m_blocks[rest];
+    r.offset = b.offset + size;
+    r.size = b.size - size;
+    r.prev = block;
+    r.next = b.next;
+    if (b.next != NONE)
+    {
+      m_blocks[b.next].prev = rest;
+    }
+    b.next = rest;
+    b.size = size;
+    insert_free(rest);
+  }
+
+  Block& b = m_blocks[block];
+  b.free = false;
+  m_used += b.size;
+  m_allocated[b.offset] = block;
+
+  return b.offset;
+}
+
+void
+RangeAllocator::free(uint32_t offset)
+{
+  auto it = m_allocated.find(offset);
+  if (it == m_allocated.end())
+  {
+    return;
+  }
+
+  uint32_t block = it->second;
+  m_allocated.erase(it);
+  m_used -= m_blocks[block].size;
+
+  uint32_t prev = m_blocks[block].prev;
+  if (prev != NONE && m_blocks[prev].free)
+  {
+    remove_free(prev);
+    m_blocks[prev].size += m_blocks[block].size;
+    m_blocks[prev].next = m_blocks[block].next;
+    if (m_blocks[block].next != NONE)
+    {
+      m_blocks[m_blocks[block].next].prev = prev;
+    }
+    release_block(block);
+    block = prev;
+  }
+
+  uint32_t next = m_blocks[block].next;
+  if (next != NONE && m_blocks[next].free)
+  {
+    remove_free(next);
+    m_blocks[block].size += m_blocks[next].size;
+    m_blocks[block].next = m_blocks[next].next;
+    if (m_blocks[next].next != NONE)
+    {
+      m_blocks[m_blocks[next].next].prev = block;
+    }
+    release_block(next);
+  }
+
+  insert_free(block);
+}
+
+uint32_t
+RangeAllocator::get_capacity() const
+{
+  return m_capacity;
+}
+
+RangeAllocatorStats
+RangeAllocator::get_stats() const
+{
+  RangeAllocatorStats stats = {};
+  stats.capacity = m_capacity;
+  stats.used = m_used;
+  stats.allocations = static_cast<uint32_t>(m_allocated.size());
+
+  for (const Block& block : m_blocks)
+  {
+    if (block.alive && block.free)
+    {
+      stats.free_blocks++;
+      stats.largest_free = std::max(stats.largest_free, block.size);
+    }
+  }
+
+  return stats;
+}
+
+uint32_t
+RangeAllocator::new_block()
+{
+  uint32_t block;
+  if (!m_unused.empty())
+  {
+    block = m_unused.back();
+    m_unused.pop_back();
+  }
+  else
+  {
+    block = static_cast<uint32_t>(m_blocks.size());
+    m_blocks.emplace_back();
+  }
+
+  Block& b = m_blocks[block];
+  b = {};
+  b.prev = NONE;
+  b.next = NONE;
+  b.prev_free = NONE;
+  b.next_free = NONE;
+  b.alive = true;
+
+  return block;
+}
+
+void
+RangeAllocator::release_block(uint32_t block)
+{
+  m_blocks[block].alive = false;
+  m_unused.push_back(block);
+}
+
+void
+RangeAllocator::mapping(uint32_t size, uint32_t& fl, uint32_t& sl)
+{
+  if (size < SL_COUNT)
+  {
+    fl = 0;
+    sl = size;
+    return;
+  }
+
+  uint32_t msb = find_msb(size);
+  fl = msb - SL_BITS + 1;
+  sl = (size >> (msb - SL_BITS)) - SL_COUNT;
+}
+
+void
+RangeAllocator::insert_free(uint32_t block)
+{
+  uint32_t fl, sl;
+  mapping(m_blocks[block].size, fl, sl);
+
+  Block& b = m_blocks[block];
+  b.free = true;
+  b.prev_free = NONE;
+  b.next_free = m_heads[fl][sl];
+  if (b.next_free != NONE)
+  {
+    m_blocks[b.next_free].prev_free = block;
+  }
+
+  m_heads[fl][sl] = block;
+  m_sl_bitmap[fl] |= 1u << sl;
+  m_fl_bitmap |= 1u << fl;
+}
+
+void
+RangeAllocator::remove_free(uint32_t block)
+{
+  uint32_t fl, sl;
+  mapping(m_blocks[block].size, fl, sl);
+
+  Block& b = m_blocks[block];
+  if (b.prev_free != NONE)
+  {
+    m_blocks[b.prev_free].next_free = b.next_free;
+  }
+  else
+  {
+    m_heads[fl][sl] = b.next_free;
+  }
+
+  if (b.next_free != NONE)
+  {
+    m_blocks[b.next_free].prev_free = b.prev_free;
+  }
+
+  b.free = false;
+  b.prev_free = NONE;
+  b.next_free = NONE;
+
+  if (m_heads[fl][sl] == NONE)
+  {
+    m_sl_bitmap[fl] &= ~(1u << sl);
+    if (!m_sl_bitmap[fl])
+    {
+      m_fl_bitmap &= ~(1u << fl);
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+struct RangeAllocatorStats {
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t allocations;
+  uint32_t free_blocks;
+  uint32_t largest_free;
+};
+
+// two level segregated fit allocator handing out ranges of an abstract
+// linear space, elements of a buffer for example. free blocks are binned by
+// size class so allocate and free are constant time, neighbouring free
+// blocks are merged on free. it never touches the memory it manages
+class RangeAllocator {
+public:
+  static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+  // drops every allocation and starts over with one free block
+  void
+  init(uint32_t capacity);
+
+  // offset of a range of size elements or INVALID_OFFSET when no free block
+  // is large enough
+  uint32_t
+  allocate(uint32_t size);
+
+  void
+  free(uint32_t offset);
+
+  uint32_t
+  get_capacity() const;
+
+  // walks every block, meant for reporting rather than per frame use
+  RangeAllocatorStats
+  get_stats() const;
+
+private:
+  // 16 linear classes per power of two, sizes below 16 map one to one
+  static constexpr uint32_t SL_BITS = 4;
+  static constexpr uint32_t SL_COUNT = 1 << SL_BITS;
+  static constexpr uint32_t FL_COUNT = 32;
+  static constexpr uint32_t NONE = UINT32_MAX;
+
+  struct Block {
+    uint32_t offset;
+    uint32_t size;
+    // neighbours in address order
+    uint32_t prev;
+    uint32_t next;
+    // neighbours in the free list of the size class
+    uint32_t prev_free;
+    uint32_t next_free;
+    bool     free;
+    bool     alive;
+  };
+
+  uint32_t                               m_capacity = 0;
+  uint32_t                               m_used = 0;
+  std::vector<Block>                     m_blocks;
+  std::vector<uint32_t>                  m_unused;
+  std::unordered_map<uint32_t, uint32_t> m_allocated;
+  uint32_t                               m_fl_bitmap = 0;
+  uint32_t                               m_sl_bitmap[FL_COUNT] = {};
+  uint32_t                               m_heads[FL_COUNT][SL_COUNT] = {};
+
+  uint32_t
+  new_block();
+
+  void
+  release_block(uint32_t block);
+
+  static void
+  mapping(uint32_t size, uint32_t& fl, uint32_t& sl);
+
+  void
+  insert_free(uint32_t block);
+
+  void
+  remove_free(uint32_t block);
+};
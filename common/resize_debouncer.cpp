@@ -0,0 +1,60 @@
+#include "resize_debouncer.hpp"
+
+void
+ResizeDebouncer::on_resize(uint64_t time_ms)
+{
+  m_pending = true;
+  m_last_event = time_ms;
+  m_event_count++;
+}
+
+void
+ResizeDebouncer::invalidate()
+{
+  m_invalid = true;
+  m_event_count++;
+}
+
+void
+ResizeDebouncer::on_swapchain_error(uint64_t time_ms)
+{
+  ac_window_state state = ac_window_get_state();
+
+  if (state.width == m_width && state.height == m_height)
+  {
+    invalidate();
+    return;
+  }
+
+  if (!m_pending)
+  {
+    m_pending = true;
+    m_last_event = time_ms;
+    m_event_count++;
+  }
+}
+
+bool
+ResizeDebouncer::should_recreate(uint64_t time_ms) const
+{
+  if (m_invalid)
+  {
+    return true;
+  }
+
+  return m_pending && time_ms - m_last_event >= RESIZE_DEBOUNCE_MS;
+}
+
+uint32_t
+ResizeDebouncer::reset()
+{
+  ac_window_state state = ac_window_get_state();
+  m_width = state.width;
+  m_height = state.height;
+
+  uint32_t count = m_event_count;
+  m_pending = false;
+  m_invalid = false;
+  m_event_count = 0;
+  return count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <ac/ac.h>
+
+// coalesces window events into one swapchain recreation. dragging a window
+// border sends a resize event for every mouse move, recreating the
+// swapchain for each of them drains the gpu over and over. resizes are
+// applied once no new one arrived for RESIZE_DEBOUNCE_MS, the old swapchain
+// keeps presenting meanwhile. acquire and present fail while the window
+// no longer matches the swapchain, those failures join the debounce. a
+// failure at the swapchain size can not be waited out and recreates on
+// the next frame
+class ResizeDebouncer {
+public:
+  static constexpr uint64_t RESIZE_DEBOUNCE_MS = 100;
+
+  void
+  on_resize(uint64_t time_ms);
+
+  // recreate on the next frame without waiting for the size to settle
+  void
+  invalidate();
+
+  // a failed acquire, execute or present. when the window size differs
+  // from the swapchain it counts as a resize, the wait starts at the first
+  // failure and later ones do not push it back
+  void
+  on_swapchain_error(uint64_t time_ms);
+
+  bool
+  should_recreate(uint64_t time_ms) const;
+
+  // the swapchain was recreated at the current window size, returns the
+  // events it coalesced
+  uint32_t
+  reset();
+
+private:
+  bool     m_pending = false;
+  bool     m_invalid = false;
+  uint64_t m_last_event = 0;
+  uint32_t m_event_count = 0;
+  // window size the swapchain was created with
+  uint32_t m_width = 0;
+  uint32_t m_height = 0;
+};
@@ -0,0 +1,207 @@
+#include <math.h>
+#include "resolution_controller.hpp"
+
+// growth per frame of the measured refresh period, about 6% a second at
+// 60 hz
+#define INTERVAL_RELAX 0.001f
+#define MAX_PROBE_BACKOFF 16
+
+void
+ResolutionController::init(const ResolutionControllerInfo& info)
+{
+  m_info = info;
+  m_scale = quantize(info.max_scale);
+  m_smoothed_ms = 0.0f;
+  m_over = 0;
+  m_under = 0;
+  m_primed = false;
+  m_interval_ms = 0.0f;
+  m_probe_frames = info.probe_frames;
+  m_probing = false;
+}
+
+bool
+ResolutionController::update(float frame_ms)
+{
+  if (!m_primed)
+  {
+    m_smoothed_ms = frame_ms;
+    m_interval_ms = frame_ms;
+    m_primed = true;
+  }
+  else
+  {
+    m_smoothed_ms += (frame_ms - m_smoothed_ms) * m_info.smoothing;
+  }
+
+  // tracked on the smoothed time, the burst of quick presents that
+  // follows a hitch would otherwise pass for the refresh period
+  m_interval_ms =
+    fminf(m_smoothed_ms, m_interval_ms * (1.0f + INTERVAL_RELAX));
+
+  float target = get_target_ms();
+  float high = target * (1.0f + m_info.band);
+  float low = target * (1.0f - m_info.band);
+
+  m_over = m_smoothed_ms > high ? m_over + 1 : 0;
+
+  // under vsync every frame that makes its vblank counts towards a probe
+  uint32_t settle_under = m_info.settle_frames;
+  if (m_info.vsync)
+  {
+    m_under = m_smoothed_ms <= high ? m_under + 1 : 0;
+    settle_under = m_probe_frames;
+  }
+  else
+  {
+    m_under = m_smoothed_ms < low ? m_under + 1 : 0;
+  }
+
+  float scale = m_scale;
+
+  if (m_over >= m_info.settle_frames && m_probing)
+  {
+    // the scale before the probe made its vblanks
+    scale = quantize(m_scale - m_info.step);
+  }
+  else if (m_over >= m_info.settle_frames)
+  {
+    // at least one step, the quantization would round small changes away
+    float wanted = m_scale * sqrtf(target / m_smoothed_ms);
+    scale = fminf(quantize(wanted), quantize(m_scale - m_info.step));
+  }
+  else if (m_under >= settle_under)
+  {
+    scale = quantize(m_scale + m_info.step);
+  }
+
+  if (scale == m_scale)
+  {
+    return false;
+  }
+
+  if (scale < m_scale && m_probing)
+  {
+    uint32_t max_frames = m_info.probe_frames * MAX_PROBE_BACKOFF;
+    m_probe_frames =
+      m_probe_frames * 2 < max_frames ? m_probe_frames * 2 : max_frames;
+  }
+  m_probing = m_info.vsync && scale > m_scale;
+
+  // the time measured so far belongs to the old scale, scale it along so
+  // the next decision does not act on it again
+  float ratio = scale / m_scale;
+  m_smoothed_ms *= ratio * ratio;
+  m_scale = scale;
+  m_over = 0;
+  m_under = 0;
+
+  return true;
+}
+
+float
+ResolutionController::get_scale() const
+{
+  return m_scale;
+}
+
+float
+ResolutionController::get_smoothed_ms() const
+{
+  return m_smoothed_ms;
+}
+
+float
+ResolutionController::get_target_ms() const
+{
+  return m_info.vsync ? m_interval_ms : m_info.target_ms;
+}
+
+void
+ResolutionController::get_size(
+  uint32_t  width,
+  uint32_t  height,
+  uint32_t* scaled_width,
+  uint32_t* scaled_height) const
+{
+  *scaled_width = static_cast<uint32_t>(width * m_scale + 0.5f);
+  *scaled_height = static_cast<uint32_t>(height * m_scale + 0.5f);
+
+  if (*scaled_width < 1)
+  {
+    *scaled_width = 1;
+  }
+  if (*scaled_height < 1)
+  {
+    *scaled_height = 1;
+  }
+}
+
+float
+ResolutionController::quantize(float scale) const
+{
+  if (m_info.step > 0.0f)
+  {
+    scale = roundf(scale / m_info.step) * m_info.step;
+  }
+
+  return fmaxf(m_info.min_scale, fminf(m_info.max_scale, scale));
+}
+
+// feeds frames alternating jitter_ms above and below frame_ms
+static float
+feed(
+  ResolutionController* controller,
+  uint32_t              frames,
+  float                 frame_ms,
+  float                 jitter_ms)
+{
+  for (uint32_t i = 0; i < frames; ++i)
+  {
+    controller->update(frame_ms + ((i & 1) ? jitter_ms : -jitter_ms));
+  }
+
+  return controller->get_scale();
+}
+
+const char*
+ResolutionController::check()
+{
+  ResolutionControllerInfo info = {};
+  info.vsync = true;
+
+  ResolutionController controller;
+
+  controller.init(info);
+  if (feed(&controller, 2000, 1000.0f / 60.0f, 0.3f) != info.max_scale)
+  {
+    return "idle at 60 hz under vsync lost scale";
+  }
+
+  controller.init(info);
+  if (feed(&controller, 2000, 1000.0f / 30.0f, 0.3f) != info.max_scale)
+  {
+    return "idle at 30 hz under vsync lost scale";
+  }
+
+  controller.init(info);
+  feed(&controller, 300, 1000.0f / 60.0f, 0.3f);
+  if (feed(&controller, 300, 2000.0f / 60.0f, 0.3f) >= info.max_scale)
+  {
+    return "missed vblanks did not shrink the scale";
+  }
+
+  info.vsync = false;
+
+  controller.init(info);
+  if (feed(&controller, 300, 25.0f, 0.3f) >= info.max_scale)
+  {
+    return "slow uncapped frames did not shrink the scale";
+  }
+  if (feed(&controller, 2000, 8.0f, 0.3f) != info.max_scale)
+  {
+    return "fast uncapped frames did not grow the scale back";
+  }
+
+  return NULL;
+}
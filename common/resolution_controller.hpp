@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ResolutionControllerInfo {
+  // frame time the controller holds, ignored under vsync
+  float    target_ms = 16.6f;
+  // the fed times are present intervals of a fifo swapchain. they never
+  // drop below the refresh period however idle the gpu is, so the target
+  // is the shortest interval seen instead and only missed vblanks shrink
+  // the scale
+  bool     vsync = false;
+  float    min_scale = 0.5f;
+  float    max_scale = 1.0f;
+  // scales are multiples of step, so the render graph is only described
+  // again when the scale really moves
+  float    step = 0.05f;
+  // frame times within target_ms * (1 +- band) leave the scale alone
+  float    band = 0.1f;
+  // frames the smoothed time has to stay outside the band before the
+  // scale changes, then again before it changes once more
+  uint32_t settle_frames = 30;
+  // weight of the newest frame in the smoothed time
+  float    smoothing = 0.1f;
+  // under vsync a frame that makes its vblank shows no headroom, so the
+  // scale tries a step up after this many frames on the interval. a probe
+  // that ends in missed vblanks steps back and doubles the wait, up to 16
+  // times
+  uint32_t probe_frames = 240;
+};
+
+// picks the internal render resolution from measured frame times. the
+// cost of a pass is taken as proportional to its pixel count: an over
+// budget frame shrinks the scale by sqrt(target / time) at once, an
+// under budget frame grows it a single step, so a spike is answered
+// quickly and the scale does not oscillate around the target. feed it
+// the present interval, not the time of a single call: under fifo the
+// graph execute also blocks on the swapchain and would follow the refresh
+// rate. plain cpu code without ac, it can be driven with synthetic timings
+class ResolutionController {
+public:
+  void
+  init(const ResolutionControllerInfo& info);
+
+  // feeds the time of one frame, returns true when the scale changed
+  bool
+  update(float frame_ms);
+
+  // drives controllers with synthetic timings: idle frames at 60 and 30 hz
+  // under vsync keep the full scale, missed vblanks and slow uncapped
+  // frames shrink it, fast uncapped frames grow it back. returns the
+  // first case that fails, NULL when all pass
+  static const char*
+  check();
+
+  // scale applied to both dimensions
+  float
+  get_scale() const;
+
+  float
+  get_smoothed_ms() const;
+
+  // target_ms, or the refresh period measured under vsync
+  float
+  get_target_ms() const;
+
+  // size at the current scale, never below one pixel
+  void
+  get_size(
+    uint32_t  width,
+    uint32_t  height,
+    uint32_t* scaled_width,
+    uint32_t* scaled_height) const;
+
+private:
+  ResolutionControllerInfo m_info = {};
+
+  float    m_scale = 1.0f;
+  float    m_smoothed_ms = 0.0f;
+  uint32_t m_over = 0;
+  uint32_t m_under = 0;
+  bool     m_primed = false;
+  // shortest present interval seen, relaxed slowly so a slower display
+  // is picked up
+  float    m_interval_ms = 0.0f;
+  uint32_t m_probe_frames = 0;
+  // the last change was a probe up
+  bool     m_probing = false;
+
+  float
+  quantize(float scale) const;
+};
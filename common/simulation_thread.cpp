@@ -0,0 +1,90 @@
+#include <chrono>
+#include "simulation_thread.hpp"
+
+SimulationThread::~SimulationThread()
+{
+  stop();
+}
+
+void
+SimulationThread::start(Step step)
+{
+  m_step = std::move(step);
+  m_pending = false;
+  m_stop = false;
+  m_thread = std::thread(&SimulationThread::thread_main, this);
+}
+
+void
+SimulationThread::stop()
+{
+  if (!m_thread.joinable())
+  {
+    return;
+  }
+
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+
+  m_thread.join();
+}
+
+void
+SimulationThread::kick()
+{
+  wait();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pending = true;
+  }
+  m_cv.notify_all();
+}
+
+void
+SimulationThread::wait()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this] { return !m_pending; });
+}
+
+float
+SimulationThread::get_step_ms() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_step_ms;
+}
+
+void
+SimulationThread::thread_main()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  for (;;)
+  {
+    m_cv.wait(lock, [this] { return m_stop || m_pending; });
+
+    if (m_stop)
+    {
+      return;
+    }
+
+    lock.unlock();
+
+    auto start = std::chrono::steady_clock::now();
+    m_step();
+    std::chrono::duration<float, std::milli> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+
+    m_step_ms = elapsed.count();
+    m_pending = false;
+    m_cv.notify_all();
+  }
+}
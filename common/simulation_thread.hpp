@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// dedicated thread that runs one simulation step per kick, so the step of
+// the next frame overlaps with recording and submitting the current one.
+// the owner double buffers what the step writes: it waits for the step,
+// flips the buffers, then kicks the next step before it renders
+class SimulationThread {
+public:
+  typedef std::function<void()> Step;
+
+  SimulationThread() = default;
+  ~SimulationThread();
+
+  SimulationThread(const SimulationThread&) = delete;
+  SimulationThread&
+  operator=(const SimulationThread&) = delete;
+
+  void
+  start(Step step);
+
+  // waits for a running step and joins the thread
+  void
+  stop();
+
+  // runs the step once, at most one step is in flight
+  void
+  kick();
+
+  // returns immediately when nothing was kicked
+  void
+  wait();
+
+  // duration of the last finished step
+  float
+  get_step_ms() const;
+
+private:
+  std::thread             m_thread;
+  mutable std::mutex      m_mutex;
+  std::condition_variable m_cv;
+  Step                    m_step;
+  bool                    m_pending = false;
+  bool                    m_stop = false;
+  float                   m_step_ms = 0.0f;
+
+  void
+  thread_main();
+};
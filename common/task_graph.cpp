@@ -0,0 +1,117 @@
+#include <chrono>
+#include "task_graph.hpp"
+
+static uint64_t
+now_ns()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+}
+
+TaskGraph::Task
+TaskGraph::add(
+  const char*                 name,
+  Fn                          fn,
+  std::initializer_list<Task> dependencies)
+{
+  Task task = static_cast<Task>(m_nodes.size());
+
+  std::unique_ptr<Node> node(new Node());
+  node->name = name;
+  node->fn = std::move(fn);
+  node->dependency_count = static_cast<uint32_t>(dependencies.size());
+  node->remaining = node->dependency_count;
+  node->skip = false;
+
+  for (Task dependency : dependencies)
+  {
+    AC_ASSERT(dependency < task);
+    m_nodes[dependency]->dependents.push_back(task);
+  }
+
+  m_nodes.push_back(std::move(node));
+
+  return task;
+}
+
+ac_result
+TaskGraph::run(JobSystem& jobs)
+{
+  m_timings.assign(m_nodes.size(), TaskTiming {});
+  m_result = ac_result_success;
+
+  uint64_t   start = now_ns();
+  JobCounter counter;
+
+  for (Task task = 0; task < m_nodes.size(); ++task)
+  {
+    if (m_nodes[task]->dependency_count == 0)
+    {
+      submit(jobs, counter, task, start);
+    }
+  }
+
+  jobs.wait(counter);
+
+  return static_cast<ac_result>(m_result.load());
+}
+
+const std::vector<TaskTiming>&
+TaskGraph::get_timings() const
+{
+  return m_timings;
+}
+
+void
+TaskGraph::submit(
+  JobSystem&  jobs,
+  JobCounter& counter,
+  Task        task,
+  uint64_t    start)
+{
+  jobs.submit(
+    counter,
+    [this, &jobs, &counter, task, start](uint32_t thread_index)
+    {
+      Node&       node = *m_nodes[task];
+      TaskTiming& timing = m_timings[task];
+
+      uint64_t task_start = now_ns();
+
+      ac_result res = ac_result_unknown_error;
+      if (!node.skip)
+      {
+        res = node.fn();
+      }
+
+      uint64_t task_end = now_ns();
+
+      timing.name = node.name;
+      timing.start_ms = (float)(task_start - start) / 1000000.0f;
+      timing.duration_ms = (float)(task_end - task_start) / 1000000.0f;
+      timing.thread_index = thread_index;
+      timing.failed = res != ac_result_success;
+
+      if (timing.failed && !node.skip)
+      {
+        int32_t expected = ac_result_success;
+        m_result.compare_exchange_strong(expected, res);
+      }
+
+      // dependents are queued before this job counts as done, so the
+      // counter can not drop to zero while work is left
+      for (Task dependent : node.dependents)
+      {
+        Node& next = *m_nodes[dependent];
+        if (timing.failed)
+        {
+          next.skip = true;
+        }
+        if (next.remaining.fetch_sub(1) == 1)
+        {
+          submit(jobs, counter, dependent, start);
+        }
+      }
+    });
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+#include <ac/ac.h>
+#include "job_system.hpp"
+
+struct TaskTiming {
+  const char* name;
+  // relative to the start of run
+  float       start_ms;
+  float       duration_ms;
+  uint32_t    thread_index;
+  // the task failed or one of its dependencies did and it never ran
+  bool        failed;
+};
+
+// one shot graph of named tasks with dependencies, meant for startup work.
+// a task is handed to the job system as soon as every task it depends on
+// finished, so independent cpu work and gpu waits overlap. tasks must not
+// use the job system themselves, a worker waiting on it would run other
+// jobs as thread 0
+class TaskGraph {
+public:
+  typedef uint32_t Task;
+  typedef std::function<ac_result()> Fn;
+
+  // dependencies have to be added before the task
+  Task
+  add(const char* name, Fn fn, std::initializer_list<Task> dependencies = {});
+
+  // blocks until every task ran, the calling thread helps. returns the
+  // result of the first failed task, its dependents are skipped
+  ac_result
+  run(JobSystem& jobs);
+
+  const std::vector<TaskTiming>&
+  get_timings() const;
+
+private:
+  struct Node {
+    const char*           name;
+    Fn                    fn;
+    std::vector<Task>     dependents;
+    uint32_t              dependency_count;
+    std::atomic<uint32_t> remaining;
+    std::atomic<bool>     skip;
+  };
+
+  std::vector<std::unique_ptr<Node>> m_nodes;
+  std::vector<TaskTiming>            m_timings;
+  std::atomic<int32_t>               m_result {ac_result_success};
+
+  void
+  submit(JobSystem& jobs, JobCounter& counter, Task task, uint64_t start);
+};
@@ -0,0 +1,159 @@
+#include <algorithm>
+#include "texture_registry.hpp"
+
+void
+TextureRegistry::init(
+  ac_descriptor_buffer db,
+  ac_space             space,
+  uint32_t             set,
+  uint32_t             reg,
+  uint32_t             capacity,
+  ac_image             fallback)
+{
+  m_db = db;
+  m_space = space;
+  m_set = set;
+  m_reg = reg;
+  m_fallback = fallback;
+  m_frame = 0;
+  m_count = 0;
+  m_retiring.clear();
+
+  m_images.assign(capacity, fallback);
+  m_states.assign(capacity, SLOT_STATE_FREE);
+
+  // popped from the back, so low slots are handed out first
+  m_free.resize(capacity);
+  m_dirty.resize(capacity);
+  for (uint32_t i = 0; i < capacity; ++i)
+  {
+    m_free[i] = capacity - 1 - i;
+    m_dirty[i] = i;
+  }
+
+  flush();
+}
+
+uint32_t
+TextureRegistry::add(ac_image image)
+{
+  if (m_free.empty())
+  {
+    return INVALID_SLOT;
+  }
+
+  uint32_t slot = m_free.back();
+  m_free.pop_back();
+
+  m_images[slot] = image;
+  m_states[slot] = SLOT_STATE_LIVE;
+  m_dirty.push_back(slot);
+  m_count++;
+
+  return slot;
+}
+
+void
+TextureRegistry::remove(uint32_t slot)
+{
+  bool live = slot < m_states.size() && m_states[slot] == SLOT_STATE_LIVE;
+  AC_ASSERT(live);
+
+  // a second remove would free the slot twice and hand it out to two owners
+  if (!live)
+  {
+    return;
+  }
+
+  m_states[slot] = SLOT_STATE_RETIRING;
+  m_retiring.push_back({slot, m_frame});
+  m_count--;
+}
+
+void
+TextureRegistry::update()
+{
+  m_frame++;
+
+  // frames recorded before the removal may still sample the old image
+  size_t kept = 0;
+  for (const Retiring& retiring : m_retiring)
+  {
+    if (m_frame - retiring.frame > AC_MAX_FRAME_IN_FLIGHT)
+    {
+      m_images[retiring.slot] = m_fallback;
+      m_states[retiring.slot] = SLOT_STATE_FREE;
+      m_dirty.push_back(retiring.slot);
+      m_free.push_back(retiring.slot);
+    }
+    else
+    {
+      m_retiring[kept++] = retiring;
+    }
+  }
+  m_retiring.resize(kept);
+
+  flush();
+}
+
+uint32_t
+TextureRegistry::get_capacity() const
+{
+  return static_cast<uint32_t>(m_images.size());
+}
+
+uint32_t
+TextureRegistry::get_count() const
+{
+  return m_count;
+}
+
+void
+TextureRegistry::flush()
+{
+  if (m_dirty.empty())
+  {
+    return;
+  }
+
+  std::sort(m_dirty.begin(), m_dirty.end());
+  m_dirty.erase(std::unique(m_dirty.begin(), m_dirty.end()), m_dirty.end());
+
+  // descriptors are filled first, writes point into them afterwards so the
+  // vector does not move under them
+  m_descriptors.resize(m_dirty.size());
+  for (size_t i = 0; i < m_dirty.size(); ++i)
+  {
+    m_descriptors[i] = {};
+    m_descriptors[i].image = m_images[m_dirty[i]];
+  }
+
+  m_writes.clear();
+  for (size_t i = 0; i < m_dirty.size(); ++i)
+  {
+    if (
+      !m_writes.empty() &&
+      m_writes.back().index + m_writes.back().count == m_dirty[i])
+    {
+      m_writes.back().count++;
+      continue;
+    }
+
+    ac_descriptor_write write = {};
+    write.type = ac_descriptor_type_srv_image;
+    write.count = 1;
+    write.reg = m_reg;
+    write.index = m_dirty[i];
+    write.descriptors = &m_descriptors[i];
+    m_writes.push_back(write);
+  }
+
+  ac_update_set(
+    m_db,
+    m_space,
+    m_set,
+    static_cast<uint32_t>(m_writes.size()),
+    m_writes.data());
+
+  m_dirty.clear();
+}
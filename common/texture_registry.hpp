@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <ac/ac.h>
+
+// runtime table of sampled images behind one descriptor array. slots are
+// handed out from a free list and go back to it only after every frame that
+// could still sample them has retired, until then they keep their image.
+// descriptor writes are queued and flushed once per frame, adjacent slots
+// share one write. unused slots point at a fallback image so the array is
+// always fully valid
+class TextureRegistry {
+public:
+  static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+
+  // capacity must not exceed the array size declared in the shader
+  void
+  init(
+    ac_descriptor_buffer db,
+    ac_space             space,
+    uint32_t             set,
+    uint32_t             reg,
+    uint32_t             capacity,
+    ac_image             fallback);
+
+  // INVALID_SLOT when every slot is taken or still retiring
+  uint32_t
+  add(ac_image image);
+
+  // the image must stay alive until the slot retires, AC_MAX_FRAME_IN_FLIGHT
+  // updates from now. only slots handed out by add and not removed yet are
+  // accepted, anything else asserts and is ignored
+  void
+  remove(uint32_t slot);
+
+  // call once per frame before recording, retires removed slots and writes
+  // every queued change
+  void
+  update();
+
+  uint32_t
+  get_capacity() const;
+
+  uint32_t
+  get_count() const;
+
+private:
+  enum SlotState : uint8_t {
+    SLOT_STATE_FREE,
+    SLOT_STATE_LIVE,
+    SLOT_STATE_RETIRING,
+  };
+
+  struct Retiring {
+    uint32_t slot;
+    uint64_t frame;
+  };
+
+  ac_descriptor_buffer   m_db = NULL;
+  ac_space               m_space = ac_space0;
+  uint32_t               m_set = 0;
+  uint32_t               m_reg = 0;
+  ac_image               m_fallback = NULL;
+  uint64_t               m_frame = 0;
+  uint32_t               m_count = 0;
+  std::vector<ac_image>  m_images;
+  std::vector<SlotState> m_states;
+  std::vector<uint32_t>  m_free;
+  std::vector<Retiring>  m_retiring;
+  std::vector<uint32_t>  m_dirty;
+  // reused by update for the batched writes
+  std::vector<ac_descriptor>       m_descriptors;
+  std::vector<ac_descriptor_write> m_writes;
+
+  void
+  flush();
+};
@@ -0,0 +1,113 @@
+#include "upload_ring.hpp"
+
+ac_result
+UploadRing::init(
+  ac_device   device,
+  uint64_t    size,
+  uint32_t    usage,
+  const char* name)
+{
+  ac_buffer_info info = {};
+  info.size = size;
+  info.usage = usage;
+  info.memory_usage = ac_memory_usage_cpu_to_gpu;
+  info.name = name;
+
+  AC_RIF(ac_create_buffer(device, &info, &m_buffer));
+  AC_RIF(ac_buffer_map_memory(m_buffer));
+
+  m_mapped = static_cast<uint8_t*>(ac_buffer_get_mapped_memory(m_buffer));
+  m_size = size;
+  m_head = 0;
+  m_tail = 0;
+  m_frame_start = 0;
+  m_frame = 0;
+  for (uint32_t i = 0; i < AC_MAX_FRAME_IN_FLIGHT; ++i)
+  {
+    m_frame_end[i] = 0;
+  }
+
+  m_stats = {};
+  m_stats.capacity = size;
+
+  return ac_result_success;
+}
+
+void
+UploadRing::shutdown()
+{
+  if (m_buffer)
+  {
+    ac_buffer_unmap_memory(m_buffer);
+    ac_destroy_buffer(m_buffer);
+  }
+  m_buffer = NULL;
+  m_mapped = NULL;
+  m_size = 0;
+}
+
+void
+UploadRing::begin_frame(uint32_t frame)
+{
+  m_frame_end[m_frame] = m_head;
+
+  // frames retire in order, so everything up to the end of the one that
+  // used this slot last is free again
+  m_frame = frame;
+  m_tail = m_frame_end[frame];
+  m_frame_start = m_head;
+  m_stats.frame_used = 0;
+}
+
+UploadAllocation
+UploadRing::allocate(uint64_t size, uint64_t alignment)
+{
+  UploadAllocation allocation = {};
+  allocation.buffer = m_buffer;
+
+  if (size == 0 || size > m_size)
+  {
+    m_stats.overflows++;
+    return allocation;
+  }
+
+  uint64_t start = (m_head + alignment - 1) / alignment * alignment;
+
+  // wrap to the start of the buffer instead of splitting the allocation
+  if (start % m_size + size > m_size)
+  {
+    start = (start / m_size + 1) * m_size;
+  }
+
+  if (start + size - m_tail > m_size)
+  {
+    m_stats.overflows++;
+    return allocation;
+  }
+
+  m_head = start + size;
+
+  allocation.offset = start % m_size;
+  allocation.size = size;
+  allocation.data = m_mapped + allocation.offset;
+
+  m_stats.frame_used = m_head - m_frame_start;
+  if (m_stats.frame_used > m_stats.high_water)
+  {
+    m_stats.high_water = m_stats.frame_used;
+  }
+
+  return allocation;
+}
+
+ac_buffer
+UploadRing::get_buffer() const
+{
+  return m_buffer;
+}
+
+const UploadRingStats&
+UploadRing::get_stats() const
+{
+  return m_stats;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <ac/ac.h>
+
+// d3d12 needs constant buffer views at 256 bytes, which also covers the
+// vulkan limits of every device we run on
+#define UPLOAD_RING_ALIGNMENT 256
+
+struct UploadAllocation {
+  ac_buffer buffer;
+  uint64_t  offset;
+  uint64_t  size;
+  // null when the ring had no room, nothing was reserved then
+  void*     data;
+};
+
+struct UploadRingStats {
+  uint64_t capacity;
+  // bytes reserved by the current frame, alignment and wrap padding
+  // included
+  uint64_t frame_used;
+  // largest frame_used seen since init
+  uint64_t high_water;
+  // allocations refused since init
+  uint32_t overflows;
+};
+
+// persistently mapped cpu to gpu buffer handing out transient memory for
+// one frame: constants, dynamic vertices and indices. frames are carved out
+// back to back and a frame's memory is reused once the same frame in flight
+// slot begins again, which the render graph only does after its fence
+// signaled. allocations never straddle the end of the buffer
+class UploadRing {
+public:
+  // usage is a mask of the buffer usages allocations are bound as
+  ac_result
+  init(ac_device device, uint64_t size, uint32_t usage, const char* name);
+
+  void
+  shutdown();
+
+  // retires the memory the previous use of this frame in flight handed out
+  void
+  begin_frame(uint32_t frame);
+
+  UploadAllocation
+  allocate(uint64_t size, uint64_t alignment = UPLOAD_RING_ALIGNMENT);
+
+  ac_buffer
+  get_buffer() const;
+
+  const UploadRingStats&
+  get_stats() const;
+
+private:
+  ac_buffer m_buffer = NULL;
+  uint8_t*  m_mapped = NULL;
+  uint64_t  m_size = 0;
+  // monotonic byte positions, the buffer offset is position % size
+  uint64_t  m_head = 0;
+  uint64_t  m_tail = 0;
+  uint64_t  m_frame_start = 0;
+  uint64_t  m_frame_end[AC_MAX_FRAME_IN_FLIGHT] = {};
+  uint32_t  m_frame = 0;
+
+  UploadRingStats m_stats = {};
+};
@@ -0,0 +1,229 @@
+#include <string.h>
+#include "upscaler.hpp"
+#include "compiled/upscale.h"
+
+ac_result
+Upscaler::init(ac_device device)
+{
+  m_device = device;
+
+  {
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_vertex;
+    info.code = upscale_vs[0];
+    info.name = AC_DEBUG_NAME("upscale vs");
+
+    AC_RIF(ac_create_shader(m_device, &info, &m_vertex_shader));
+  }
+
+  {
+    ac_shader_info info = {};
+    info.stage = ac_shader_stage_pixel;
+    info.code = upscale_fs[0];
+    info.name = AC_DEBUG_NAME("upscale fs");
+
+    AC_RIF(ac_create_shader(m_device, &info, &m_pixel_shader));
+  }
+
+  {
+    ac_shader shaders[] = {
+      m_vertex_shader,
+      m_pixel_shader,
+    };
+
+    ac_dsl_info info = {};
+    info.shader_count = AC_COUNTOF(shaders);
+    info.shaders = shaders;
+    info.name = AC_DEBUG_NAME("upscale");
+
+    AC_RIF(ac_create_dsl(m_device, &info, &m_dsl));
+  }
+
+  {
+    ac_descriptor_buffer_info info = {};
+    info.dsl = m_dsl;
+    info.max_sets[ac_space0] = AC_MAX_FRAME_IN_FLIGHT;
+    info.name = AC_DEBUG_NAME("upscale");
+
+    AC_RIF(ac_create_descriptor_buffer(m_device, &info, &m_db));
+  }
+
+  {
+    ac_sampler_info info = {};
+    info.mag_filter = ac_filter_linear;
+    info.min_filter = ac_filter_linear;
+    info.address_mode_u = ac_sampler_address_mode_clamp_to_edge;
+    info.address_mode_v = ac_sampler_address_mode_clamp_to_edge;
+    info.address_mode_w = ac_sampler_address_mode_clamp_to_edge;
+    info.mipmap_mode = ac_sampler_mipmap_mode_linear;
+
+    AC_RIF(ac_create_sampler(m_device, &info, &m_sampler));
+  }
+
+  return ac_result_success;
+}
+
+void
+Upscaler::shutdown()
+{
+  ac_destroy_sampler(m_sampler);
+  ac_destroy_descriptor_buffer(m_db);
+  ac_destroy_dsl(m_dsl);
+  ac_destroy_shader(m_pixel_shader);
+  ac_destroy_shader(m_vertex_shader);
+
+  m_sampler = NULL;
+  m_db = NULL;
+  m_dsl = NULL;
+  m_pixel_shader = NULL;
+  m_vertex_shader = NULL;
+  m_pipeline = NULL;
+}
+
+ac_result
+Upscaler::create_pipeline(PipelineCache& cache, ac_format format)
+{
+  // zeroed with its padding, the cache hashes the info bytewise
+  ac_pipeline_info info;
+  memset(&info, 0, sizeof(info));
+  info.type = ac_pipeline_type_graphics;
+  info.graphics.vertex_shader = m_vertex_shader;
+  info.graphics.pixel_shader = m_pixel_shader;
+  info.graphics.dsl = m_dsl;
+  info.graphics.topology = ac_primitive_topology_triangle_list;
+  info.graphics.samples = 1;
+  info.graphics.color_attachment_count = 1;
+  info.graphics.color_attachment_formats[0] = format;
+  info.name = AC_DEBUG_NAME("upscale");
+
+  return cache.get(info, &m_pipeline);
+}
+
+ac_rg_builder_stage_info
+Upscaler::begin_stage(uint64_t source_token, const ac_image_info& output)
+{
+  m_width = output.width;
+  m_height = output.height;
+  m_source_token = source_token;
+
+  ac_rg_builder_stage_info stage_info = {};
+  stage_info.name = AC_DEBUG_NAME("upscale");
+  stage_info.queue = ac_queue_type_graphics;
+  stage_info.commands = ac_queue_type_graphics;
+  stage_info.cb_cmd = Upscaler::stage_cmd;
+  stage_info.user_data = this;
+
+  return stage_info;
+}
+
+ac_rg_builder_stage_use_resource_info
+Upscaler::get_source_use(uint64_t source_token)
+{
+  ac_rg_builder_stage_use_resource_info use_info = {};
+  use_info.token = source_token;
+  use_info.usage_bits = ac_image_usage_srv_bit;
+  use_info.access_read.stages = ac_pipeline_stage_pixel_shader_bit;
+  use_info.access_read.access = ac_access_shader_read_bit;
+
+  return use_info;
+}
+
+ac_rg_builder_stage_use_resource_info
+Upscaler::get_output_use(uint64_t output_token)
+{
+  ac_rg_builder_stage_use_resource_info use_info = {};
+  use_info.token = output_token;
+  use_info.access_attachment = ac_rg_attachment_access_write_bit;
+  use_info.usage_bits = ac_image_usage_attachment_bit;
+
+  return use_info;
+}
+
+GraphDescription::Resource
+Upscaler::describe(
+  GraphDescription&          graph,
+  GraphDescription::Resource source,
+  uint64_t                   source_token,
+  const ac_image_info&       output,
+  uint64_t                   output_token)
+{
+  GraphDescription::Stage stage =
+    graph.create_stage(begin_stage(source_token, output));
+
+  graph.use_resource(stage, source, get_source_use(source_token));
+
+  // every pixel is written, nothing to clear
+  GraphDescription::Resource image = graph.create_image(output, false);
+
+  return graph.use_resource(stage, image, get_output_use(output_token));
+}
+
+ac_rg_builder_resource
+Upscaler::build(
+  ac_rg_builder          builder,
+  ac_rg_builder_resource source,
+  uint64_t               source_token,
+  const ac_image_info&   output,
+  uint64_t               output_token)
+{
+  ac_rg_builder_stage_info stage_info = begin_stage(source_token, output);
+
+  ac_rg_builder_stage stage = ac_rg_builder_create_stage(builder, &stage_info);
+
+  ac_rg_builder_stage_use_resource_info use_info =
+    get_source_use(source_token);
+  use_info.resource = source;
+
+  ac_rg_builder_stage_use_resource(builder, stage, &use_info);
+
+  // every pixel is written, nothing to clear
+  ac_image_info                      image_info = output;
+  ac_rg_builder_create_resource_info resource_info = {};
+  resource_info.image_info = &image_info;
+  resource_info.do_clear = false;
+
+  use_info = get_output_use(output_token);
+  use_info.resource = ac_rg_builder_create_resource(builder, &resource_info);
+
+  return ac_rg_builder_stage_use_resource(builder, stage, &use_info);
+}
+
+ac_result
+Upscaler::stage_cmd(ac_rg_stage* stage, void* ud)
+{
+  Upscaler* p = static_cast<Upscaler*>(ud);
+
+  ac_cmd cmd = stage->cmd;
+
+  ac_descriptor sampler_descriptor = {};
+  sampler_descriptor.sampler = p->m_sampler;
+
+  ac_descriptor image_descriptor = {};
+  image_descriptor.image = ac_rg_stage_get_image(stage, p->m_source_token);
+
+  ac_descriptor_write writes[2] = {};
+  writes[0].count = 1;
+  writes[0].type = ac_descriptor_type_sampler;
+  writes[0].descriptors = &sampler_descriptor;
+  writes[1].count = 1;
+  writes[1].type = ac_descriptor_type_srv_image;
+  writes[1].descriptors = &image_descriptor;
+
+  ac_update_set(p->m_db, ac_space0, stage->frame, AC_COUNTOF(writes), writes);
+
+  ac_cmd_set_viewport(
+    cmd,
+    0,
+    0,
+    (float)p->m_width,
+    (float)p->m_height,
+    0.0f,
+    1.0f);
+  ac_cmd_set_scissor(cmd, 0, 0, p->m_width, p->m_height);
+
+  ac_cmd_bind_pipeline(cmd, p->m_pipeline);
+  ac_cmd_bind_set(cmd, p->m_db, ac_space0, stage->frame);
+  ac_cmd_draw(cmd, 3, 1, 0, 0);
+
+  return ac_result_success;
+}
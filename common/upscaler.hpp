@@ -0,0 +1,67 @@
+#pragma once
+
+#include <ac/ac.h>
+#include "graph_description.hpp"
+#include "pipeline_cache.hpp"
+
+// bilinear upscale of an image rendered at internal resolution into an
+// output image, drawn as one fullscreen triangle in its own render graph
+// stage
+class Upscaler {
+public:
+  ac_result
+  init(ac_device device);
+
+  void
+  shutdown();
+
+  // the pipeline only depends on the output format
+  ac_result
+  create_pipeline(PipelineCache& cache, ac_format format);
+
+  // adds a stage reading source and writing a new image described by
+  // output, returns the version to export. the stage is recorded with the
+  // size of output
+  GraphDescription::Resource
+  describe(
+    GraphDescription&          graph,
+    GraphDescription::Resource source,
+    uint64_t                   source_token,
+    const ac_image_info&       output,
+    uint64_t                   output_token);
+
+  // same stage added straight to a builder, for graphs built every frame
+  ac_rg_builder_resource
+  build(
+    ac_rg_builder          builder,
+    ac_rg_builder_resource source,
+    uint64_t               source_token,
+    const ac_image_info&   output,
+    uint64_t               output_token);
+
+private:
+  ac_device            m_device = NULL;
+  ac_shader            m_vertex_shader = NULL;
+  ac_shader            m_pixel_shader = NULL;
+  ac_dsl               m_dsl = NULL;
+  ac_descriptor_buffer m_db = NULL;
+  ac_sampler           m_sampler = NULL;
+  // owned by the pipeline cache
+  ac_pipeline          m_pipeline = NULL;
+  uint32_t             m_width = 0;
+  uint32_t             m_height = 0;
+  uint64_t             m_source_token = 0;
+
+  // records the size of output, the stage is recorded with it
+  ac_rg_builder_stage_info
+  begin_stage(uint64_t source_token, const ac_image_info& output);
+
+  static ac_rg_builder_stage_use_resource_info
+  get_source_use(uint64_t source_token);
+
+  static ac_rg_builder_stage_use_resource_info
+  get_output_use(uint64_t output_token);
+
+  static ac_result
+  stage_cmd(ac_rg_stage* stage, void* ud);
+};
@@ -27,9 +27,12 @@ project("ac-examples-shaders")
   ac_compile_shader("../05_pbr/eq_to_cube.acsl", "cs")
   ac_compile_shader("../05_pbr/irradiance.acsl", "cs")
   ac_compile_shader("../05_pbr/specular.acsl", "cs")
-  ac_compile_shader("../05_pbr/main.acsl", "vs fs")
+  ac_compile_shader("../05_pbr/skinning.acsl", "cs")
+  ac_compile_shader("../05_pbr/cull.acsl", "cs")
+  ac_compile_shader("../05_pbr/main.acsl", "vs fs --permutations 2")
   ac_compile_shader("../06_shadow_mapping/shadow_mapping_depth.acsl", "vs")
   ac_compile_shader("../06_shadow_mapping/shadow_mapping.acsl", "vs fs")
+  ac_compile_shader("../common/upscale.acsl", "vs fs")
   -- ac_compile_shader("../08_rayquery/main.acsl", "vs fs --permutations 2")
   -- ac_compile_shader("../09_raytracing/main.acsl", "raygen closest_hit miss")
   -- ac_compile_shader("../10_mesh/main.acsl", "mesh fs")
@@ -51,6 +54,8 @@ project("common")
   })
 
   files({
+    RD .. "common/*.cpp",
+    RD .. "common/*.hpp",
     RD .. "external/tinygltf/*.cc",
     RD .. "external/tinyobjloader/*.cc"
   })
@@ -90,6 +95,7 @@ function setup_example(name)
   externalincludedirs({
     RD .. "../ac/include",
     RD .. "../ac-tools/imgui",
+    RD .. "common",
     RD .. "external",
     RD .. "external/glm"
   })
@@ -127,11 +133,23 @@ project("05-pbr")
   setup_example("05-pbr")
 
   files({
+    RD .. "05_pbr/animation.cpp",
+    RD .. "05_pbr/animation.hpp",
+    RD .. "05_pbr/bvh.cpp",
+    RD .. "05_pbr/bvh.hpp",
+    RD .. "05_pbr/culling.cpp",
+    RD .. "05_pbr/culling.hpp",
+    RD .. "05_pbr/geometry_heap.cpp",
+    RD .. "05_pbr/geometry_heap.hpp",
     RD .. "05_pbr/main.cpp",
     RD .. "05_pbr/model.cpp",
     RD .. "05_pbr/model.hpp",
+    RD .. "05_pbr/occlusion.cpp",
+    RD .. "05_pbr/occlusion.hpp",
     RD .. "05_pbr/pbr_maps.cpp",
-    RD .. "05_pbr/pbr_maps.hpp"
+    RD .. "05_pbr/pbr_maps.hpp",
+    RD .. "05_pbr/render_queue.cpp",
+    RD .. "05_pbr/render_queue.hpp"
   })
 
   copy_file("data/BrainStem.glb")